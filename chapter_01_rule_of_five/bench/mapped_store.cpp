@@ -0,0 +1,132 @@
+/*====# MAPPED STORE BENCHMARK #====*/
+/*
+
+A warm restart with N TestClass objects, two ways:
+
+* rebuild - what we do today: the values are saved to a file with an
+            ofstream, the restart reads them back with an ifstream and
+            constructs every object again (value + a malloc'd int), like
+            TestClass
+* mapped  - MappedTestStore: save is push_back + flush, the restart is
+            open (), the objects are usable right away
+
+For each: save, reload (until the objects can be used), and the first scan
+over all objects after the reload (for mapped, that is where the pages come
+in). The file was just written, so it comes from the page cache, a cold
+start would add the disk to both.
+
+Usage: Chapter_01_bench_mapped_store [object count, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "heap_test_class.h"
+#include "mapped_store.h"
+
+/*==# DEFINES #==*/
+
+#define MAPPED_BENCH_DEFAULT_COUNT 10000000
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static void printTotal (const bench::Result& result) {
+    bench::printResult (result);
+    std::printf ("%-32s %13.1f ms total\n", "", result.nanoseconds / 1e6);
+}
+
+static void runRebuild (const std::string& path, std::size_t count, std::int64_t expected) {
+    bench::printHeader ("REBUILD (IFSTREAM)");
+    printTotal (bench::measure ("save", count, [&] () {
+        std::ofstream out (path, std::ios::binary | std::ios::trunc);
+        for (std::size_t i = 0; i < count; ++i) {
+            const int value = static_cast<int> (i);
+            out.write (reinterpret_cast<const char*> (&value), sizeof (value));
+        }
+        out.close ();
+        const int fd = ::open (path.c_str (), O_RDONLY);
+        ::fsync (fd); // the mapped store waits for the disk too
+        ::close (fd);
+    }));
+
+    std::vector<HeapTestClass> objects;
+    printTotal (bench::measure ("reload", count, [&] () {
+        std::ifstream in (path, std::ios::binary);
+        objects.reserve (count);
+        int value = 0;
+        while (in.read (reinterpret_cast<char*> (&value), sizeof (value))) {
+            objects.emplace_back (value);
+        }
+    }));
+
+    std::int64_t sum = 0;
+    printTotal (bench::measure ("first scan", count, [&] () {
+        for (const HeapTestClass& object : objects) {
+            sum += object.getValue () + object.getDynamicValue ();
+        }
+    }));
+    if (sum != expected || objects.size () != count) {
+        std::printf ("rebuild checksum mismatch!\n");
+    }
+}
+
+static void runMapped (const std::string& path, std::size_t count, std::int64_t expected) {
+    bench::printHeader ("MAPPED STORE");
+    printTotal (bench::measure ("save", count, [&] () {
+        MappedTestStore store = MappedTestStore::create (path);
+        for (std::size_t i = 0; i < count; ++i) {
+            store.push_back (static_cast<int> (i));
+        }
+        store.flush ();
+    }));
+
+    std::optional<MappedTestStore> store;
+    printTotal (bench::measure ("reload", count, [&] () { store.emplace (MappedTestStore::open (path)); }));
+
+    std::int64_t sum = 0;
+    printTotal (bench::measure ("first scan", count, [&] () {
+        for (std::size_t i = 0; i < store->size (); ++i) {
+            const StoredTestClass& object = (*store)[i];
+            sum += object.value + *store->resolve (object.dynamic_offset);
+        }
+    }));
+    if (sum != expected || store->size () != count) {
+        std::printf ("mapped checksum mismatch!\n");
+    }
+    std::printf ("%-32s %13.1f MB file\n", "", static_cast<double> (store->fileBytes ()) / 1e6);
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, MAPPED_BENCH_DEFAULT_COUNT);
+    const std::string directory = std::filesystem::temp_directory_path ().string ();
+    const std::string stream_path = directory + "/chapter_01_rebuild.bin";
+    const std::string mapped_path = directory + "/chapter_01_mapped.store";
+
+    std::printf ("Mapped store benchmark, %zu TestClass objects, files in %s\n", count, directory.c_str ());
+
+    std::int64_t expected = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        expected += 2 * static_cast<std::int64_t> (i) + TESTCLASS_DYNAMICVALUE_ADDITION;
+    }
+
+    runRebuild (stream_path, count, expected);
+    runMapped (mapped_path, count, expected);
+
+    std::filesystem::remove (stream_path);
+    std::filesystem::remove (mapped_path);
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*====# SEQLOCK BENCHMARK #====*/
+/*
+
+One TestClass-like object, 1, 2, 4, ... threads (up to the hardware threads,
+at least 4) hammering it with 99% reads and 1% writes:
+
+* std::mutex        - readers and writers take the same lock
+* std::shared_mutex - readers share the lock, but still write its counter
+* seqlock           - SeqlockTestClass, readers write nothing
+
+Every thread runs the same number of operations, ns/op is wall time over
+all operations of all threads, so a flat line is perfect scaling. Every
+read checks dynamic_value == value + 3, a torn read would show up as a
+mismatch.
+
+Usage: Chapter_01_bench_seqlock [operations per thread, default 2M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "seqlock_test_class.h"
+
+/*==# DEFINES #==*/
+
+#define SEQLOCK_BENCH_DEFAULT_COUNT 2000000
+#define SEQLOCK_BENCH_WRITE_EVERY 100
+
+/*==# CLASSES #==*/
+
+// The same state behind a lock, Shared picks shared locks for the readers.
+template <typename Mutex, bool Shared> class LockedTestClass {
+
+    private:
+    mutable Mutex mutex;
+    int value;
+    int dynamic_value;
+
+    public:
+    explicit LockedTestClass (int new_value = SEQLOCK_TESTCLASS_DEFAULT)
+    : value (new_value), dynamic_value (new_value + TESTCLASS_DYNAMICVALUE_ADDITION) {
+    }
+
+    SeqlockTestClass::Snapshot read () const {
+        if constexpr (Shared) {
+            std::shared_lock<Mutex> lock (mutex);
+            return { value, dynamic_value };
+        } else {
+            std::lock_guard<Mutex> lock (mutex);
+            return { value, dynamic_value };
+        }
+    }
+
+    void write (int new_value) {
+        std::lock_guard<Mutex> lock (mutex);
+        value         = new_value;
+        dynamic_value = new_value + TESTCLASS_DYNAMICVALUE_ADDITION;
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+template <typename Object>
+static void runMix (const char* name, std::size_t threads, std::size_t operations) {
+    Object object;
+    std::atomic<std::size_t> torn{ 0 };
+    bench::printResult (bench::measure (name, threads * operations, [&] () {
+        std::vector<std::thread> workers;
+        for (std::size_t thread = 0; thread < threads; ++thread) {
+            workers.emplace_back ([&, thread] () {
+                std::size_t mismatches = 0;
+                std::int64_t sum       = 0;
+                for (std::size_t i = 0; i < operations; ++i) {
+                    if (i % SEQLOCK_BENCH_WRITE_EVERY == thread % SEQLOCK_BENCH_WRITE_EVERY) {
+                        object.write (static_cast<int> (i));
+                        continue;
+                    }
+                    const SeqlockTestClass::Snapshot snapshot = object.read ();
+                    mismatches += snapshot.dynamic_value != snapshot.value + TESTCLASS_DYNAMICVALUE_ADDITION;
+                    sum += snapshot.value;
+                }
+                bench::doNotOptimize (sum);
+                torn.fetch_add (mismatches, std::memory_order_relaxed);
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join ();
+        }
+    }));
+    if (torn.load ()) {
+        std::printf ("%zu torn reads!\n", torn.load ());
+    }
+}
+
+int main (int argc, char** argv) {
+    const std::size_t operations = bench::countFromArgs (argc, argv, SEQLOCK_BENCH_DEFAULT_COUNT);
+    const std::size_t most = std::max<std::size_t> (4, std::thread::hardware_concurrency ());
+
+    std::printf ("Seqlock benchmark, %zu operations per thread, 1 write per %d, up to %zu threads (%u hardware)\n",
+    operations, SEQLOCK_BENCH_WRITE_EVERY, most, std::thread::hardware_concurrency ());
+
+    for (std::size_t threads = 1; threads <= most; threads *= 2) {
+        const std::string title = std::to_string (threads) + (threads == 1 ? " THREAD" : " THREADS");
+        bench::printHeader (title.c_str ());
+        runMix<LockedTestClass<std::mutex, false>> ("std::mutex", threads, operations);
+        runMix<LockedTestClass<std::shared_mutex, true>> ("std::shared_mutex", threads, operations);
+        runMix<SeqlockTestClass> ("seqlock", threads, operations);
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*====# SHARED MEMORY RING BENCHMARK #====*/
+/*
+
+TestClass records (value, dynamic_value = value + 3) from a parent process
+to a forked child, three transports:
+
+* shm ring    - ShmRing in a memfd segment, the child reads in place
+* pipe        - every record written as 8 bytes with write (), read ()
+* unix socket - the same over a socketpair (AF_UNIX, SOCK_STREAM)
+
+THROUGHPUT sends N records one way, the time runs until the child has read
+and checked all of them. LATENCY sends one record and waits for the child
+to send it back, N / 10 times, ns/op is one round trip.
+
+The child checks every dynamic_value and exits with 1 on a mismatch.
+
+Usage: Chapter_01_bench_shm_ring [record count, default 1M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "shm_ring.h"
+
+/*==# DEFINES #==*/
+
+#define SHM_BENCH_DEFAULT_COUNT 1000000
+#define SHM_BENCH_CAPACITY 4096
+#define SHM_BENCH_LATENCY_DIVISOR 10
+
+/*==# CLASSES #==*/
+
+// What goes through the pipe: the record with dynamic_value copied in.
+struct WireRecord {
+    int value;
+    int dynamic_value;
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// Runs body in a child process, which exits with what body returns.
+template <typename Body> static pid_t spawn (Body body) {
+    std::fflush (stdout);
+    const pid_t pid = ::fork ();
+    if (pid < 0) {
+        std::perror ("fork");
+        std::exit (1);
+    }
+    if (pid == 0) {
+        ::_exit (body ());
+    }
+    return pid;
+}
+
+static bool succeeded (pid_t pid) {
+    int status = 0;
+    ::waitpid (pid, &status, 0);
+    return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+static bool writeAll (int fd, const void* data, std::size_t size) {
+    const char* bytes = static_cast<const char*> (data);
+    while (size > 0) {
+        const ssize_t written = ::write (fd, bytes, size);
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<std::size_t> (written);
+    }
+    return true;
+}
+
+static bool readAll (int fd, void* data, std::size_t size) {
+    char* bytes = static_cast<char*> (data);
+    while (size > 0) {
+        const ssize_t got = ::read (fd, bytes, size);
+        if (got <= 0) {
+            return false;
+        }
+        bytes += got;
+        size -= static_cast<std::size_t> (got);
+    }
+    return true;
+}
+
+// THROUGHPUT //
+
+static void throughputRing (std::size_t count) {
+    ShmSegment segment = ShmSegment::createAnonymous (ShmRing::bytesFor (SHM_BENCH_CAPACITY));
+    ShmRing ring       = ShmRing::create (segment, SHM_BENCH_CAPACITY);
+    bool ok            = false;
+    bench::printResult (bench::measure ("shm ring", count, [&] () {
+        const pid_t child = spawn ([&] () {
+            int mismatches = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                ring.consume ([&] (const ShmTestRecord& record) {
+                    mismatches += *ring.resolve (record.dynamic_offset) != record.value + TESTCLASS_DYNAMICVALUE_ADDITION;
+                });
+            }
+            return mismatches ? 1 : 0;
+        });
+        for (std::size_t i = 0; i < count; ++i) {
+            ring.push (static_cast<int> (i));
+        }
+        ok = succeeded (child);
+    }));
+    if (!ok) {
+        std::printf ("shm ring: child saw bad records!\n");
+    }
+}
+
+// Parent writes to write_fd, the child reads from read_fd.
+static void throughputStream (const char* name, std::size_t count, int write_fd, int read_fd) {
+    bool ok = false;
+    bench::printResult (bench::measure (name, count, [&] () {
+        const pid_t child = spawn ([&] () {
+            int mismatches = 0;
+            WireRecord record;
+            for (std::size_t i = 0; i < count; ++i) {
+                if (!readAll (read_fd, &record, sizeof (record))) {
+                    return 1;
+                }
+                mismatches += record.dynamic_value != record.value + TESTCLASS_DYNAMICVALUE_ADDITION;
+            }
+            return mismatches ? 1 : 0;
+        });
+        for (std::size_t i = 0; i < count; ++i) {
+            const WireRecord record{ static_cast<int> (i), static_cast<int> (i) + TESTCLASS_DYNAMICVALUE_ADDITION };
+            writeAll (write_fd, &record, sizeof (record));
+        }
+        ok = succeeded (child);
+    }));
+    if (!ok) {
+        std::printf ("%s: child saw bad records!\n", name);
+    }
+}
+
+// LATENCY //
+
+static void latencyRing (std::size_t rounds) {
+    ShmSegment to_child_segment  = ShmSegment::createAnonymous (ShmRing::bytesFor (SHM_BENCH_CAPACITY));
+    ShmSegment to_parent_segment = ShmSegment::createAnonymous (ShmRing::bytesFor (SHM_BENCH_CAPACITY));
+    ShmRing to_child             = ShmRing::create (to_child_segment, SHM_BENCH_CAPACITY);
+    ShmRing to_parent            = ShmRing::create (to_parent_segment, SHM_BENCH_CAPACITY);
+    bool ok                      = true;
+    bench::printResult (bench::measure ("shm ring", rounds, [&] () {
+        const pid_t child = spawn ([&] () {
+            for (std::size_t i = 0; i < rounds; ++i) {
+                int value = 0;
+                to_child.consume ([&] (const ShmTestRecord& record) { value = record.value; });
+                to_parent.push (value);
+            }
+            return 0;
+        });
+        for (std::size_t i = 0; i < rounds; ++i) {
+            to_child.push (static_cast<int> (i));
+            to_parent.consume ([&] (const ShmTestRecord& record) {
+                ok &= record.value == static_cast<int> (i) &&
+                *to_parent.resolve (record.dynamic_offset) == record.value + TESTCLASS_DYNAMICVALUE_ADDITION;
+            });
+        }
+        ok &= succeeded (child);
+    }));
+    if (!ok) {
+        std::printf ("shm ring: bad echo!\n");
+    }
+}
+
+// The parent writes to parent_write and reads the echo from parent_read, the child the other way round.
+static void latencyStream (const char* name, std::size_t rounds, int parent_write, int parent_read, int child_write, int child_read) {
+    bool ok = true;
+    bench::printResult (bench::measure (name, rounds, [&] () {
+        const pid_t child = spawn ([&] () {
+            WireRecord record;
+            for (std::size_t i = 0; i < rounds; ++i) {
+                if (!readAll (child_read, &record, sizeof (record)) || !writeAll (child_write, &record, sizeof (record))) {
+                    return 1;
+                }
+            }
+            return 0;
+        });
+        for (std::size_t i = 0; i < rounds; ++i) {
+            WireRecord record{ static_cast<int> (i), static_cast<int> (i) + TESTCLASS_DYNAMICVALUE_ADDITION };
+            writeAll (parent_write, &record, sizeof (record));
+            ok &= readAll (parent_read, &record, sizeof (record)) && record.value == static_cast<int> (i);
+        }
+        ok &= succeeded (child);
+    }));
+    if (!ok) {
+        std::printf ("%s: bad echo!\n", name);
+    }
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count  = bench::countFromArgs (argc, argv, SHM_BENCH_DEFAULT_COUNT);
+    const std::size_t rounds = count / SHM_BENCH_LATENCY_DIVISOR ? count / SHM_BENCH_LATENCY_DIVISOR : 1;
+
+    std::printf ("Shared memory ring benchmark, %zu records one way, %zu round trips, ring of %d\n", count,
+    rounds, SHM_BENCH_CAPACITY);
+
+    int parent_to_child[2], child_to_parent[2], sockets[2];
+    if (::pipe (parent_to_child) != 0 || ::pipe (child_to_parent) != 0) {
+        std::perror ("pipe");
+        return 1;
+    }
+    if (::socketpair (AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        std::perror ("socketpair");
+        return 1;
+    }
+
+    bench::printHeader ("THROUGHPUT");
+    throughputRing (count);
+    throughputStream ("pipe", count, parent_to_child[1], parent_to_child[0]);
+    throughputStream ("unix socket", count, sockets[0], sockets[1]);
+
+    bench::printHeader ("LATENCY (ROUND TRIP)");
+    latencyRing (rounds);
+    latencyStream ("pipe", rounds, parent_to_child[1], child_to_parent[0], child_to_parent[1], parent_to_child[0]);
+    latencyStream ("unix socket", rounds, sockets[0], sockets[0], sockets[1], sockets[1]);
+
+    for (int fd : { parent_to_child[0], parent_to_child[1], child_to_parent[0], child_to_parent[1], sockets[0], sockets[1] }) {
+        ::close (fd);
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*====# TESTCLASS STORAGE BENCHMARK #====*/
+/*
+
+N TestClass objects stored four ways, compared with bench::Runner
+(bench_runner.h): pinned, warmed up, interleaved rounds, medians with
+bootstrap confidence intervals. The differences between these are a few
+percent to a few x, exactly where one printed run cannot tell.
+
+* heap    - TestClass without the logging: value + a malloc'd dynamic_value
+            (the baseline)
+* inline  - value and dynamic_value side by side, no allocation
+* seqlock - SeqlockTestClass, a cache line per object, read () per access
+* mapped  - MappedTestStore records, dynamic_value through its file offset
+
+SCAN sums value + dynamic_value over all objects. "heap, again" is the
+baseline a second time: it must come out "within noise", if it does not,
+the machine is too noisy to trust the others.
+
+COPY copies the whole container (deep copies, where there is a pointer).
+
+Usage: Chapter_01_bench_storage [object count, default 1M] [--rounds N] [--cpu N] [--warmup-ms N]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bench_runner.h"
+#include "bench_util.h"
+#include "heap_test_class.h"
+#include "mapped_store.h"
+#include "seqlock_test_class.h"
+
+/*==# DEFINES #==*/
+
+#define STORAGE_BENCH_DEFAULT_COUNT 1000000
+
+/*==# CLASSES #==*/
+
+struct InlineTestClass {
+    int value;
+    int dynamic_value;
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+int main (int argc, char** argv) {
+    const std::size_t count            = bench::countFromArgs (argc, argv, STORAGE_BENCH_DEFAULT_COUNT);
+    const bench::RunnerOptions options = bench::prepareRunner (argc, argv);
+    const std::string path = std::filesystem::temp_directory_path ().string () + "/chapter_01_storage.store";
+
+    std::printf ("TestClass storage benchmark, %zu objects\n", count);
+
+    std::vector<HeapTestClass> heap;
+    std::vector<InlineTestClass> inlined;
+    std::vector<SeqlockTestClass> seqlocked;
+    heap.reserve (count);
+    inlined.reserve (count);
+    seqlocked.reserve (count);
+    MappedTestStore mapped = MappedTestStore::create (path, count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const int value = static_cast<int> (i);
+        heap.emplace_back (value);
+        inlined.push_back ({ value, value + TESTCLASS_DYNAMICVALUE_ADDITION });
+        seqlocked.emplace_back (value);
+        mapped.push_back (value);
+    }
+
+    std::int64_t sum = 0;
+    bench::Runner scan (options);
+    scan.add ("heap", count, [&] () {
+        sum = 0;
+        for (const HeapTestClass& object : heap) {
+            sum += object.getValue () + object.getDynamicValue ();
+        }
+        bench::doNotOptimize (sum);
+    });
+    scan.add ("heap, again", count, [&] () {
+        sum = 0;
+        for (const HeapTestClass& object : heap) {
+            sum += object.getValue () + object.getDynamicValue ();
+        }
+        bench::doNotOptimize (sum);
+    });
+    scan.add ("inline", count, [&] () {
+        sum = 0;
+        for (const InlineTestClass& object : inlined) {
+            sum += object.value + object.dynamic_value;
+        }
+        bench::doNotOptimize (sum);
+    });
+    scan.add ("seqlock", count, [&] () {
+        sum = 0;
+        for (const SeqlockTestClass& object : seqlocked) {
+            const SeqlockTestClass::Snapshot snapshot = object.read ();
+            sum += snapshot.value + snapshot.dynamic_value;
+        }
+        bench::doNotOptimize (sum);
+    });
+    scan.add ("mapped", count, [&] () {
+        sum = 0;
+        for (std::size_t i = 0; i < mapped.size (); ++i) {
+            const StoredTestClass& object = mapped[i];
+            sum += object.value + *mapped.resolve (object.dynamic_offset);
+        }
+        bench::doNotOptimize (sum);
+    });
+    scan.run ("SCAN");
+
+    bench::Runner copy (options);
+    copy.add ("heap", count, [&] () {
+        std::vector<HeapTestClass> copied (heap);
+        bench::doNotOptimize (copied.data ());
+    });
+    copy.add ("inline", count, [&] () {
+        std::vector<InlineTestClass> copied (inlined);
+        bench::doNotOptimize (copied.data ());
+    });
+    copy.add ("seqlock", count, [&] () {
+        std::vector<SeqlockTestClass> copied (seqlocked);
+        bench::doNotOptimize (copied.data ());
+    });
+    copy.run ("COPY");
+
+    std::filesystem::remove (path);
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*====# HEAP TESTCLASS #====*/
+/*
+
+What every TestClass variant of this chapter agrees on, in one place:
+
+* TESTCLASS_DYNAMICVALUE_ADDITION - dynamic_value is always value + 3, in
+  main's TestClass, the seqlock, the shared memory ring and the mapped
+  store alike, and the benchmarks check exactly that
+* HeapTestClass - TestClass without the logging, a value and a malloc'd
+  dynamic_value, the baseline the storage benchmarks compare against
+
+HeapTestClass copies with a fresh malloc like TestClass and moves the
+pointer, it has no assignment.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cstdlib>
+
+/*==# DEFINES #==*/
+
+#define TESTCLASS_DYNAMICVALUE_ADDITION 3
+
+/*==# CLASSES #==*/
+
+class HeapTestClass {
+
+    private:
+    int value;
+    int* dynamic_value;
+
+    public:
+    explicit HeapTestClass (int new_value)
+    : value (new_value), dynamic_value (static_cast<int*> (std::malloc (sizeof (int)))) {
+        *dynamic_value = new_value + TESTCLASS_DYNAMICVALUE_ADDITION;
+    }
+
+    ~HeapTestClass () {
+        std::free (dynamic_value);
+    }
+
+    HeapTestClass (const HeapTestClass& source)
+    : value (source.value), dynamic_value (static_cast<int*> (std::malloc (sizeof (int)))) {
+        *dynamic_value = source.value + TESTCLASS_DYNAMICVALUE_ADDITION;
+    }
+
+    HeapTestClass (HeapTestClass&& source) noexcept : value (source.value), dynamic_value (source.dynamic_value) {
+        source.dynamic_value = nullptr;
+    }
+
+    HeapTestClass& operator= (const HeapTestClass&) = delete;
+    HeapTestClass& operator= (HeapTestClass&&)      = delete;
+
+    int getValue () const {
+        return value;
+    }
+
+    int getDynamicValue () const {
+        return *dynamic_value;
+    }
+};
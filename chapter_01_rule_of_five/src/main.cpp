@@ -22,14 +22,27 @@ to non-existent data, causing a segmentation fault and a feeling of Impostor Syn
 */
 
 /*==# INCLUDES #==*/
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <utility>
 
+#include "bench_metrics.h"
+#include "heap_test_class.h"
+#include "layout_report.h"
+#include "mapped_store.h"
+#include "sampling_profiler.h"
+#include "seqlock_test_class.h"
+#include "shm_ring.h"
+
 /*==# DEFINES #==*/
 
 #define TESTCLASS_DEFAULT 0
-#define TESTCLASS_DYNAMICVALUE_ADDITION 3
+#define SEQLOCK_SCENARIO_WRITES 100000
+#define PROFILE_DEFAULT_REPEATS 1000000
+#define PROFILE_HOTTEST 8
 #define safe_free(pointer) if (pointer){free(pointer);}
 
 /*==# CLASSES #==*/
@@ -40,6 +53,8 @@ class TestClass {
         int value;
         int *dynamic_value = NULL;
 
+        friend void printLayout();
+
         void log(std::string extra_text) {
             std::cout << "TestClass instance '" << this << "' " << extra_text << "\n";
             std::cout << "value = " << value << " dynamic_value = ";
@@ -126,8 +141,122 @@ class TestClass {
         }
 };
 
-int main()
+/*==# LAYOUT #==*/
+/* Run with --layout to see how TestClass sits in memory. */
+/* The object is never constructed (the constructor talks a lot), we only take addresses. */
+static_assert(sizeof(TestClass) == 16, "TestClass: int + padding + pointer on x86-64");
+
+void printLayout() {
+    alignas(TestClass) static unsigned char storage[sizeof(TestClass)];
+    const TestClass& object = *reinterpret_cast<TestClass*>(storage);
+
+    layout::LayoutReport report = layout::reportFor<TestClass>("TestClass");
+    LAYOUT_MEMBER(report, object, TestClass, value);
+    LAYOUT_MEMBER(report, object, TestClass, dynamic_value);
+    report.print();
+}
+
+/*==# SCENARIOS #==*/
+/* Scenarios 1 to 5 of main, one at a time, for --profile and --bench. */
+static void runScenario(int scenario) {
+    switch (scenario) {
+    case 1: {
+        TestClass instance_A(15);
+        break;
+    }
+    case 2: {
+        TestClass instance_A(15);
+        TestClass instance_B = instance_A;
+        break;
+    }
+    case 3: {
+        TestClass instance_A(15);
+        TestClass instance_C;
+        instance_C = instance_A;
+        break;
+    }
+    case 4: {
+        TestClass instance_A(15);
+        TestClass instance_D = std::move(instance_A);
+        break;
+    }
+    default: {
+        TestClass instance_B(15);
+        TestClass instance_E;
+        instance_E = std::move(instance_B);
+        break;
+    }
+    }
+}
+
+/*==# PROFILE #==*/
+/* Run with --profile <scenario 1-5> [repeats] [output] to see where a scenario spends its time. */
+/* One run is a few microseconds, so the scenario is repeated, with std::cout going nowhere */
+/* (the logging still formats everything, it is part of the cost). */
+int profileScenario(int argc, char** argv) {
+    int scenario = argc > 2 ? std::atoi(argv[2]) : 0;
+    if (scenario < 1 || scenario > 5) {
+        std::cerr << "Usage: Chapter_01 --profile <scenario 1-5> [repeats] [output.folded]" << std::endl;
+        return 1;
+    }
+#ifdef PROFILER_AVAILABLE
+    long long repeats = argc > 3 ? std::atoll(argv[3]) : PROFILE_DEFAULT_REPEATS;
+    std::string path = argc > 4 ? argv[4] : "chapter_01_scenario_" + std::to_string(scenario) + ".folded";
+
+    profile::Profiler profiler;
+    {
+        bench::SilencedStream quiet(std::cout);
+        profiler.run([&]() {
+            for (long long i = 0; i < repeats; i++) {
+                runScenario(scenario);
+            }
+        });
+    }
+
+    profiler.writeFolded(path);
+    std::cout << "Scenario " << scenario << " x " << repeats << ": " << profiler.samples() << " samples ("
+              << profiler.dropped() << " dropped), folded stacks in " << path << std::endl;
+    std::cout << "Flame graph: flamegraph.pl " << path << " > scenario_" << scenario << ".svg" << std::endl << std::endl;
+    std::cout << "Hottest functions (self samples):" << std::endl;
+    for (const auto& [function, samples] : profiler.hottest(PROFILE_HOTTEST)) {
+        std::cout << "  " << samples << "\t" << function << std::endl;
+    }
+    return 0;
+#else
+    std::cerr << "--profile needs x86-64 Linux, the sampling profiler is not built here" << std::endl;
+    return 1;
+#endif
+}
+
+/*==# BENCH #==*/
+/* Run with --bench [--json] [operations] [--runs N] for the time, allocations and counters of every scenario. */
+/* cmake/bench_compare.cmake compares the --json output against a baseline, ./init.sh bench-check runs it. */
+BENCH_COUNT_ALLOCATIONS();
+
+int benchScenarios(int argc, char** argv) {
+    bench::ScenarioBench bench("Chapter_01", argc, argv);
+    bench::SilencedStream quiet(std::cout);
+    bench.add("1. default constructor", []() { runScenario(1); });
+    bench.add("2. copy constructor", []() { runScenario(2); });
+    bench.add("3. copy assignment", []() { runScenario(3); });
+    bench.add("4. move constructor", []() { runScenario(4); });
+    bench.add("5. move assignment", []() { runScenario(5); });
+    return bench.finish();
+}
+
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--layout") {
+        printLayout();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--profile") {
+        return profileScenario(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return benchScenarios(argc, argv);
+    }
+
     /*==# SCENARIO 1 #==*/
     /* Using a default Constructor with the number 15 */
     TestClass instance_A(15);
@@ -151,5 +280,50 @@ int main()
     TestClass instance_E;
     instance_E = std::move(instance_B);
 
+    /*==# SCENARIO 6 #==*/
+    /* A SeqlockTestClass updated by another thread while we keep reading it. */
+    /* Every snapshot must have dynamic_value == value + 3, no matter when the writer was interrupted. */
+    SeqlockTestClass instance_F(15);
+    std::thread writer([&instance_F]() {
+        for (int i = 0; i < SEQLOCK_SCENARIO_WRITES; i++) {
+            instance_F.write(i);
+        }
+    });
+    int torn_reads = 0;
+    while (instance_F.version() < SEQLOCK_SCENARIO_WRITES) {
+        SeqlockTestClass::Snapshot snapshot = instance_F.read();
+        torn_reads += snapshot.dynamic_value != snapshot.value + TESTCLASS_DYNAMICVALUE_ADDITION;
+    }
+    writer.join();
+    std::cout << "SeqlockTestClass: " << instance_F.version() << " writes, torn reads = " << torn_reads << " (expecting 0)" << std::endl << std::endl;
+
+    /*==# SCENARIO 7 #==*/
+    /* A TestClass record through a shared memory ring, as another process would see it. */
+    /* The record holds an offset instead of the int*, resolved against the ring's own mapping. */
+    ShmSegment segment = ShmSegment::createAnonymous(ShmRing::bytesFor(16));
+    ShmRing ring = ShmRing::create(segment, 16);
+    ring.push(15);
+    ring.consume([&ring](const ShmTestRecord &record) {
+        std::cout << "ShmTestRecord: value = " << record.value << " dynamic_value = " << *ring.resolve(record.dynamic_offset)
+                  << " (expecting 15 and 18)" << std::endl << std::endl;
+    });
+
+    /*==# SCENARIO 8 #==*/
+    /* TestClass objects saved in a MappedTestStore, then the file is opened again like after a restart. */
+    /* Opening reads only the header, the objects are used right where they lie in the file. */
+    std::string store_path = (std::filesystem::temp_directory_path() / "chapter_01_scenario.store").string();
+    {
+        MappedTestStore store = MappedTestStore::create(store_path);
+        store.push_back(15);
+        store.push_back(20);
+    }
+    {
+        MappedTestStore store = MappedTestStore::open(store_path);
+        const StoredTestClass &second = store[1];
+        std::cout << "MappedTestStore: " << store.size() << " objects, second value = " << second.value
+                  << " dynamic_value = " << *store.resolve(second.dynamic_offset) << " (expecting 2, 20 and 23)" << std::endl << std::endl;
+    }
+    std::filesystem::remove(store_path);
+
     return 0;
 }
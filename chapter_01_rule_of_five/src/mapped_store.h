@@ -0,0 +1,300 @@
+/*====# MAPPED TESTCLASS STORE #====*/
+/*
+
+Saving millions of TestClass objects is easy, loading them back is what
+hurts: read the file, parse it, construct every object, malloc every
+dynamic_value. A warm restart spends its time rebuilding what it already
+had.
+
+MappedTestStore keeps the objects in a file mapped into memory and never
+rebuilds them. The file is the data structure:
+
+* a header (magic, version, count, where the arrays start)
+* StoredTestClass records: value, and instead of int* dynamic_value the
+  offset of its int from the start of the file
+* the payload ints the offsets point to
+
+Nothing in the file depends on where it is mapped, so opening a store is an
+mmap and a header check, whatever the object count. The pages are read by
+the kernel when they are first touched (from the page cache after a warm
+restart), and changes go to the file by themselves: flush () only waits
+for the disk.
+
+The store grows by doubling: a bigger file, mremap. The mapping may move,
+the offsets stay valid. Pointers into a store are only good until the next
+push_back.
+
+A process dying in the middle of push_back () or grow () leaves a store
+open () accepts, with every object that was complete. The writes are ordered
+for that: the payloads are copied before the records point at them, and the
+header changes last. A power failure is another matter, the kernel writes
+the dirty pages back in any order, only a flush () gives a guarantee.
+
+open () trusts nothing in the header it can check: the arrays must be where
+the capacity puts them, and resolve () refuses offsets outside the payloads.
+
+The file is in the byte order of the machine that wrote it, open () checks
+the header.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "heap_test_class.h"
+
+/*==# DEFINES #==*/
+
+#define MAPPED_STORE_MAGIC 0x53544354u // "TCTS" in a little endian file
+#define MAPPED_STORE_VERSION 1u
+#define MAPPED_STORE_MIN_CAPACITY 64
+
+/*==# CLASSES #==*/
+
+// TestClass as it lies in the file. dynamic_offset is from the start of the file, 0 is NULL.
+struct StoredTestClass {
+    std::int32_t value;
+    std::uint32_t reserved; // always 0, keeps the offset aligned
+    std::uint64_t dynamic_offset;
+};
+
+static_assert (sizeof (StoredTestClass) == 16, "StoredTestClass: the file layout must not change");
+
+class MappedTestStore {
+
+    private:
+    struct Header {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t count;
+        std::uint64_t capacity;
+        std::uint64_t records; // offsets from the start of the file
+        std::uint64_t payloads;
+    };
+
+    int fd            = -1;
+    char* base        = nullptr;
+    std::size_t bytes = 0;
+
+    static void fail (const char* what) {
+        throw std::system_error (errno, std::generic_category (), what);
+    }
+
+    static std::size_t bytesFor (std::uint64_t capacity) {
+        return sizeof (Header) + static_cast<std::size_t> (capacity) * (sizeof (StoredTestClass) + sizeof (std::int32_t));
+    }
+
+    MappedTestStore (int descriptor, std::size_t size) : fd (descriptor), bytes (size) {
+        void* mapping = ::mmap (nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close (fd);
+            fd = -1;
+            fail ("mmap");
+        }
+        base = static_cast<char*> (mapping);
+    }
+
+    Header& header () const {
+        return *reinterpret_cast<Header*> (base);
+    }
+
+    StoredTestClass* records () const {
+        return reinterpret_cast<StoredTestClass*> (base + header ().records);
+    }
+
+    std::int32_t* payloads () const {
+        return reinterpret_cast<std::int32_t*> (base + header ().payloads);
+    }
+
+    // Lays the arrays out for capacity, the header must already be there.
+    void layout (std::uint64_t capacity) {
+        header ().capacity = capacity;
+        header ().records  = sizeof (Header);
+        header ().payloads = payloadsFor (capacity);
+    }
+
+    static std::uint64_t payloadsFor (std::uint64_t capacity) {
+        return sizeof (Header) + capacity * sizeof (StoredTestClass);
+    }
+
+    std::int32_t& payloadAt (std::uint64_t offset) const {
+        return *reinterpret_cast<std::int32_t*> (base + offset);
+    }
+
+    // Doubles the capacity. The payloads move behind the bigger record
+    // array, the records stay where they are. Until the header changes the
+    // old layout is the valid one, the new payloads lie behind the end of
+    // the old file and each record points at one of two equal copies.
+    void grow () {
+        const std::uint64_t count    = header ().count;
+        const std::uint64_t capacity = header ().capacity * 2;
+        const std::size_t size       = bytesFor (capacity);
+        if (::ftruncate (fd, static_cast<off_t> (size)) != 0) {
+            fail ("ftruncate");
+        }
+        void* mapping = ::mremap (base, bytes, size, MREMAP_MAYMOVE);
+        if (mapping == MAP_FAILED) {
+            fail ("mremap");
+        }
+        base  = static_cast<char*> (mapping);
+        bytes = size;
+
+        const std::uint64_t new_payloads = payloadsFor (capacity);
+        for (std::uint64_t i = 0; i < count; ++i) {
+            StoredTestClass& record = records ()[i];
+            if (record.dynamic_offset) {
+                const std::uint64_t offset = new_payloads + i * sizeof (std::int32_t);
+                payloadAt (offset)         = *resolve (record.dynamic_offset);
+                record.dynamic_offset      = offset;
+            }
+        }
+        // open () finishes a grow that died between these two.
+        header ().payloads = new_payloads;
+        header ().capacity = capacity;
+    }
+
+    public:
+    // A new, empty store in path, an existing file is replaced.
+    static MappedTestStore create (const std::string& path, std::uint64_t capacity = MAPPED_STORE_MIN_CAPACITY) {
+        capacity       = capacity < MAPPED_STORE_MIN_CAPACITY ? MAPPED_STORE_MIN_CAPACITY : capacity;
+        int descriptor = ::open (path.c_str (), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (descriptor < 0) {
+            fail ("open");
+        }
+        if (::ftruncate (descriptor, static_cast<off_t> (bytesFor (capacity))) != 0) {
+            ::close (descriptor);
+            fail ("ftruncate");
+        }
+        MappedTestStore store (descriptor, bytesFor (capacity));
+        store.header ().version = MAPPED_STORE_VERSION;
+        store.header ().count   = 0;
+        store.layout (capacity);
+        store.header ().magic = MAPPED_STORE_MAGIC;
+        return store;
+    }
+
+    // The store in path, ready to use. Reads nothing but the header.
+    static MappedTestStore open (const std::string& path) {
+        int descriptor = ::open (path.c_str (), O_RDWR | O_CLOEXEC);
+        if (descriptor < 0) {
+            fail ("open");
+        }
+        struct stat status;
+        if (::fstat (descriptor, &status) != 0) {
+            ::close (descriptor);
+            fail ("fstat");
+        }
+        const std::size_t size = static_cast<std::size_t> (status.st_size);
+        if (size < sizeof (Header)) {
+            ::close (descriptor);
+            throw std::runtime_error ("MappedTestStore: " + path + " is too small");
+        }
+        MappedTestStore store (descriptor, size);
+        Header& header = store.header ();
+        if (header.magic != MAPPED_STORE_MAGIC || header.version != MAPPED_STORE_VERSION ||
+        header.count > header.capacity || header.capacity > size || bytesFor (header.capacity) > size) {
+            throw std::runtime_error ("MappedTestStore: " + path + " is not a store of this version");
+        }
+        if (header.payloads == payloadsFor (header.capacity * 2) && bytesFor (header.capacity * 2) <= size) {
+            header.capacity *= 2; // a grow () that only got to write the payloads
+        }
+        if (header.records != sizeof (Header) || header.payloads != payloadsFor (header.capacity)) {
+            throw std::runtime_error ("MappedTestStore: " + path + " has a corrupt header");
+        }
+        return store;
+    }
+
+    MappedTestStore (MappedTestStore&& source) noexcept
+    : fd (std::exchange (source.fd, -1)), base (std::exchange (source.base, nullptr)),
+      bytes (std::exchange (source.bytes, 0)) {
+    }
+
+    // The old mapping goes away with source.
+    MappedTestStore& operator= (MappedTestStore&& source) noexcept {
+        std::swap (fd, source.fd);
+        std::swap (base, source.base);
+        std::swap (bytes, source.bytes);
+        return *this;
+    }
+
+    MappedTestStore (const MappedTestStore&)            = delete;
+    MappedTestStore& operator= (const MappedTestStore&) = delete;
+
+    ~MappedTestStore () {
+        if (base) {
+            ::munmap (base, bytes);
+        }
+        if (fd >= 0) {
+            ::close (fd);
+        }
+    }
+
+    std::size_t size () const {
+        return static_cast<std::size_t> (header ().count);
+    }
+
+    std::size_t capacity () const {
+        return static_cast<std::size_t> (header ().capacity);
+    }
+
+    std::size_t fileBytes () const {
+        return bytes;
+    }
+
+    const StoredTestClass& operator[] (std::size_t index) const {
+        return records ()[index];
+    }
+
+    // The int an offset points to, nullptr for 0. Behind the records and
+    // inside the file (after a dead grow () a payload may lie behind the ones
+    // of the header), a torn or foreign offset throws.
+    const std::int32_t* resolve (std::uint64_t offset) const {
+        if (!offset) {
+            return nullptr;
+        }
+        if (offset < header ().payloads || offset > bytes - sizeof (std::int32_t) || offset % sizeof (std::int32_t)) {
+            throw std::out_of_range ("MappedTestStore: dynamic_offset outside the payloads");
+        }
+        return &payloadAt (offset);
+    }
+
+    // Like the TestClass constructor: dynamic_value = value + TESTCLASS_DYNAMICVALUE_ADDITION.
+    void push_back (int value) {
+        if (header ().count == header ().capacity) {
+            grow ();
+        }
+        const std::uint64_t index = header ().count;
+        payloads ()[index]        = value + TESTCLASS_DYNAMICVALUE_ADDITION;
+        records ()[index] = StoredTestClass{ value, 0, header ().payloads + index * sizeof (std::int32_t) };
+        header ().count = index + 1; // last, a process dying before this leaves the store as it was
+    }
+
+    // Like the TestClass copy assignment, both fields change.
+    void assign (std::size_t index, int value) {
+        StoredTestClass& record = records ()[index];
+        record.value            = value;
+        if (record.dynamic_offset) {
+            payloadAt (record.dynamic_offset) = value + TESTCLASS_DYNAMICVALUE_ADDITION;
+        }
+    }
+
+    // Waits until everything written so far is on the disk.
+    void flush () {
+        if (::msync (base, bytes, MS_SYNC) != 0) {
+            fail ("msync");
+        }
+    }
+};
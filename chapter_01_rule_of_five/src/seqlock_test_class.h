@@ -0,0 +1,163 @@
+/*====# SEQLOCK TESTCLASS #====*/
+/*
+
+TestClass with its state (value and *dynamic_value) shared between threads
+that mostly read it. A mutex would make every reader write the mutex's
+cache line, so readers of different cores keep stealing that line from
+each other, even though none of them changes anything.
+
+A sequence lock (seqlock) lets readers go without writing anything shared:
+
+* the writer makes the sequence odd, writes the fields, makes it even again
+* a reader reads the sequence, then the fields, then the sequence again;
+  if it was odd or it changed, a writer was in between and it reads again
+
+Writers still exclude each other (a compare exchange on the sequence).
+Readers never block a writer, but a steady stream of writers can make a
+reader retry, a seqlock is for state that is read far more than written.
+
+The fields are read while a writer may be writing them, so every access to
+them goes through std::atomic_ref (relaxed, plain loads and stores on x86).
+dynamic_value is allocated once and only its int changes afterwards, a
+reader never follows a pointer that is being freed.
+
+The rule of five is kept: copies take a consistent snapshot of the source,
+moves steal the allocation and leave an object that is only good to be
+assigned to or destroyed. Moving from an object other threads still read is
+a bug, just like destroying it.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "heap_test_class.h"
+
+/*==# DEFINES #==*/
+
+#define SEQLOCK_TESTCLASS_DEFAULT 0
+
+/*==# CLASSES #==*/
+
+// A whole cache line per object, writers of a neighbour do not disturb its readers.
+class alignas (64) SeqlockTestClass {
+
+    public:
+    struct Snapshot {
+        int value;
+        int dynamic_value;
+    };
+
+    private:
+    std::atomic<std::uint32_t> sequence{ 0 };
+    int value;
+    int* dynamic_value = nullptr;
+
+    static int* allocate () {
+        int* memory = static_cast<int*> (std::malloc (sizeof (int)));
+        if (!memory) {
+            throw std::bad_alloc ();
+        }
+        return memory;
+    }
+
+    // Waits until no other writer is inside, then makes the sequence odd.
+    std::uint32_t beginWrite () {
+        std::uint32_t current = sequence.load (std::memory_order_relaxed);
+        while (true) {
+            if (!(current & 1) &&
+            sequence.compare_exchange_weak (current, current + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                break;
+            }
+            current = sequence.load (std::memory_order_relaxed);
+        }
+        // The odd sequence must be visible before any field changes.
+        std::atomic_thread_fence (std::memory_order_release);
+        return current + 1;
+    }
+
+    void endWrite (std::uint32_t odd) {
+        sequence.store (odd + 1, std::memory_order_release);
+    }
+
+    void store (int new_value) {
+        std::atomic_ref<int> (value).store (new_value, std::memory_order_relaxed);
+        std::atomic_ref<int> (*dynamic_value).store (new_value + TESTCLASS_DYNAMICVALUE_ADDITION, std::memory_order_relaxed);
+    }
+
+    public:
+    explicit SeqlockTestClass (int new_value = SEQLOCK_TESTCLASS_DEFAULT)
+    : value (new_value), dynamic_value (allocate ()) {
+        *dynamic_value = new_value + TESTCLASS_DYNAMICVALUE_ADDITION;
+    }
+
+    ~SeqlockTestClass () {
+        std::free (dynamic_value);
+    }
+
+    SeqlockTestClass (const SeqlockTestClass& source) : dynamic_value (allocate ()) {
+        const Snapshot snapshot = source.read ();
+        value                   = snapshot.value;
+        *dynamic_value          = snapshot.dynamic_value;
+    }
+
+    SeqlockTestClass& operator= (const SeqlockTestClass& source) {
+        if (this != &source) {
+            if (!dynamic_value) {
+                dynamic_value = allocate (); // moved from, nobody else can be looking
+            }
+            write (source.read ().value);
+        }
+        return *this;
+    }
+
+    SeqlockTestClass (SeqlockTestClass&& source) noexcept
+    : value (source.value), dynamic_value (source.dynamic_value) {
+        source.value         = SEQLOCK_TESTCLASS_DEFAULT;
+        source.dynamic_value = nullptr;
+    }
+
+    SeqlockTestClass& operator= (SeqlockTestClass&& source) noexcept {
+        if (this != &source) {
+            std::free (dynamic_value);
+            value                = source.value;
+            dynamic_value        = source.dynamic_value;
+            source.value         = SEQLOCK_TESTCLASS_DEFAULT;
+            source.dynamic_value = nullptr;
+        }
+        return *this;
+    }
+
+    // A consistent copy of both fields. Writes nothing shared, retries while a writer is inside.
+    Snapshot read () const {
+        while (true) {
+            const std::uint32_t before = sequence.load (std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            Snapshot snapshot{ std::atomic_ref<int> (const_cast<int&> (value)).load (std::memory_order_relaxed),
+                dynamic_value ? std::atomic_ref<int> (*dynamic_value).load (std::memory_order_relaxed) : 0 };
+            // The field loads must be done before the sequence is read again.
+            std::atomic_thread_fence (std::memory_order_acquire);
+            if (sequence.load (std::memory_order_relaxed) == before) {
+                return snapshot;
+            }
+        }
+    }
+
+    void write (int new_value) {
+        const std::uint32_t odd = beginWrite ();
+        store (new_value);
+        endWrite (odd);
+    }
+
+    // Number of completed writes, it only grows.
+    std::uint32_t version () const {
+        return sequence.load (std::memory_order_acquire) / 2;
+    }
+};
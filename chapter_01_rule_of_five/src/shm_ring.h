@@ -0,0 +1,399 @@
+/*====# SHARED MEMORY RING #====*/
+/*
+
+Passing TestClass between processes through a pipe means: serialize it,
+copy it into the kernel, copy it out again, deserialize it. And the int*
+dynamic_value can not be sent at all, a pointer means nothing in the other
+process.
+
+Here both processes map the same memory instead (ShmSegment, a memfd or a
+shm_open object) and the records never leave it:
+
+* ShmTestRecord is TestClass with fixed layout: value, and instead of the
+  int* an offset from the start of the segment. Any process resolves the
+  offset against its own mapping, wherever that ended up.
+* ShmRing is a bounded ring of such records, many producers and one
+  consumer (MPSC, Vyukov's bounded queue: every slot has a sequence number
+  that says whose turn it is). Pushing and popping are a few atomic
+  operations on the shared memory, no system call.
+* The consumer reads a record in place and the slot is only handed back to
+  the producers when it is done, nothing gets copied out.
+* A side that has to wait (empty or full ring) spins a little, then sleeps
+  on a futex. The other side only makes the wake up system call when
+  somebody actually sleeps.
+
+The atomics live in shared memory, so they have to be lock free (lock free
+atomics are address free, any mapping works) and the futexes are not
+FUTEX_PRIVATE.
+
+The other process is not trusted more than a file: attach () checks that
+the header describes a ring that fits the segment, and resolve () that an
+offset points into the payloads.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "heap_test_class.h"
+
+/*==# DEFINES #==*/
+
+#define SHM_RING_MAGIC 0x53524e47u // "SRNG"
+#define SHM_RING_VERSION 1u
+#define SHM_RING_SPINS 128
+
+static_assert (std::atomic<std::uint32_t>::is_always_lock_free, "futex words must be lock free");
+static_assert (std::atomic<std::uint64_t>::is_always_lock_free, "ring positions must be lock free");
+
+/*==# CLASSES #==*/
+
+// 1. SEGMENT //
+/*
+
+One mapping of a shared memory object. Owns the mapping and the file
+descriptor, a child made by fork () shares both.
+
+*/
+
+class ShmSegment {
+
+    private:
+    int fd            = -1;
+    void* base        = nullptr;
+    std::size_t bytes = 0;
+    std::string name; // shm_open name to unlink, empty for memfd and openers
+
+    static void fail (const char* what) {
+        throw std::system_error (errno, std::generic_category (), what);
+    }
+
+    ShmSegment (int descriptor, std::size_t size, std::string unlink_name) : fd (descriptor), bytes (size), name (std::move (unlink_name)) {
+        base = ::mmap (nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            const int error = errno;
+            base            = nullptr;
+            ::close (fd);
+            if (!name.empty ()) {
+                ::shm_unlink (name.c_str ()); // createNamed made it, nobody else will
+            }
+            errno = error;
+            fail ("mmap");
+        }
+    }
+
+    public:
+    // Anonymous, shared with the children of this process (or with anyone
+    // we send the descriptor to).
+    static ShmSegment createAnonymous (std::size_t size) {
+        int descriptor = static_cast<int> (::syscall (SYS_memfd_create, "shm_ring", 0));
+        if (descriptor < 0) {
+            fail ("memfd_create");
+        }
+        if (::ftruncate (descriptor, static_cast<off_t> (size)) != 0) {
+            ::close (descriptor);
+            fail ("ftruncate");
+        }
+        return ShmSegment (descriptor, size, "");
+    }
+
+    // /dev/shm/<name>, for unrelated processes. Unlinked by its creator.
+    static ShmSegment createNamed (const std::string& shm_name, std::size_t size) {
+        int descriptor = ::shm_open (shm_name.c_str (), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (descriptor < 0) {
+            fail ("shm_open");
+        }
+        if (::ftruncate (descriptor, static_cast<off_t> (size)) != 0) {
+            ::close (descriptor);
+            ::shm_unlink (shm_name.c_str ());
+            fail ("ftruncate");
+        }
+        return ShmSegment (descriptor, size, shm_name);
+    }
+
+    static ShmSegment openNamed (const std::string& shm_name) {
+        int descriptor = ::shm_open (shm_name.c_str (), O_RDWR, 0);
+        if (descriptor < 0) {
+            fail ("shm_open");
+        }
+        struct stat status;
+        if (::fstat (descriptor, &status) != 0) {
+            ::close (descriptor);
+            fail ("fstat");
+        }
+        return ShmSegment (descriptor, static_cast<std::size_t> (status.st_size), "");
+    }
+
+    ShmSegment (ShmSegment&& source) noexcept
+    : fd (std::exchange (source.fd, -1)), base (std::exchange (source.base, nullptr)),
+      bytes (std::exchange (source.bytes, 0)), name (std::move (source.name)) {
+        source.name.clear ();
+    }
+
+    // The old mapping goes away with source.
+    ShmSegment& operator= (ShmSegment&& source) noexcept {
+        std::swap (fd, source.fd);
+        std::swap (base, source.base);
+        std::swap (bytes, source.bytes);
+        std::swap (name, source.name);
+        return *this;
+    }
+
+    ShmSegment (const ShmSegment&)            = delete;
+    ShmSegment& operator= (const ShmSegment&) = delete;
+
+    ~ShmSegment () {
+        if (base) {
+            ::munmap (base, bytes);
+        }
+        if (fd >= 0) {
+            ::close (fd);
+        }
+        if (!name.empty ()) {
+            ::shm_unlink (name.c_str ());
+        }
+    }
+
+    void* data () const {
+        return base;
+    }
+
+    std::size_t size () const {
+        return bytes;
+    }
+
+    int descriptor () const {
+        return fd;
+    }
+};
+
+// 2. RECORDS //
+
+// TestClass as it lies in the segment. dynamic_offset replaces int* dynamic_value,
+// 0 is NULL (the ring header sits at offset 0, no payload ever does).
+struct ShmTestRecord {
+    int value;
+    std::uint32_t dynamic_offset;
+};
+
+static_assert (sizeof (ShmTestRecord) == 8, "ShmTestRecord: two 32 bit fields, no padding");
+
+// 3. RING //
+
+class ShmRing {
+
+    private:
+    // Waiters announce themselves, so the other side knows whether to wake.
+    struct EventCount {
+        std::atomic<std::uint32_t> epoch;
+        std::atomic<std::uint32_t> waiters;
+    };
+
+    struct Slot {
+        std::atomic<std::uint64_t> sequence;
+        ShmTestRecord record;
+    };
+
+    struct Header {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t capacity; // a power of two
+        std::uint64_t slots;    // offsets from the start of the segment
+        std::uint64_t payloads;
+        alignas (64) std::atomic<std::uint64_t> tail; // next position producers claim
+        alignas (64) std::atomic<std::uint64_t> head; // next position the consumer reads
+        alignas (64) EventCount not_empty;
+        alignas (64) EventCount not_full;
+    };
+
+    char* base;
+    Header* header;
+    Slot* slots;
+    int* payloads;
+    std::uint64_t mask;
+
+    explicit ShmRing (void* segment_base)
+    : base (static_cast<char*> (segment_base)), header (static_cast<Header*> (segment_base)),
+      slots (reinterpret_cast<Slot*> (base + header->slots)),
+      payloads (reinterpret_cast<int*> (base + header->payloads)), mask (header->capacity - 1) {
+    }
+
+    static void futexWait (std::atomic<std::uint32_t>& word, std::uint32_t expected) {
+        ::syscall (SYS_futex, reinterpret_cast<std::uint32_t*> (&word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+    }
+
+    static void futexWakeAll (std::atomic<std::uint32_t>& word) {
+        ::syscall (SYS_futex, reinterpret_cast<std::uint32_t*> (&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    // Wakes all announced waiters, once: the count is cleared here, not by
+    // the sleepers, which may take a while to get a CPU back.
+    static void notify (EventCount& event) {
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        if (event.waiters.load (std::memory_order_relaxed) > 0 && event.waiters.exchange (0, std::memory_order_relaxed) > 0) {
+            event.epoch.fetch_add (1, std::memory_order_seq_cst);
+            futexWakeAll (event.epoch);
+        }
+    }
+
+    // Spins, then sleeps until ready () or a notify.
+    template <typename Ready> static void await (EventCount& event, Ready ready) {
+        for (int spin = 0; spin < SHM_RING_SPINS; ++spin) {
+            if (ready ()) {
+                return;
+            }
+        }
+        while (!ready ()) {
+            const std::uint32_t seen = event.epoch.load (std::memory_order_relaxed);
+            event.waiters.fetch_add (1, std::memory_order_seq_cst);
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            if (!ready ()) {
+                futexWait (event.epoch, seen);
+            }
+        }
+    }
+
+    bool hasRecord () const {
+        const std::uint64_t position = header->head.load (std::memory_order_relaxed);
+        return slots[position & mask].sequence.load (std::memory_order_acquire) == position + 1;
+    }
+
+    bool hasSpace () const {
+        const std::uint64_t position = header->tail.load (std::memory_order_relaxed);
+        return slots[position & mask].sequence.load (std::memory_order_acquire) == position;
+    }
+
+    public:
+    // Segment bytes a ring of capacity records needs.
+    static std::size_t bytesFor (std::size_t capacity) {
+        return sizeof (Header) + capacity * (sizeof (Slot) + sizeof (int));
+    }
+
+    // Lays out a new ring at the start of segment, capacity must be a power of two.
+    static ShmRing create (ShmSegment& segment, std::size_t capacity) {
+        if (capacity == 0 || (capacity & (capacity - 1)) || segment.size () < bytesFor (capacity) ||
+        bytesFor (capacity) > UINT32_MAX) {
+            throw std::invalid_argument ("ShmRing: capacity must be a power of two that fits the segment (and 32 bit offsets)");
+        }
+        Header* header   = ::new (segment.data ()) Header{};
+        header->capacity = capacity;
+        header->slots    = sizeof (Header);
+        header->payloads = sizeof (Header) + capacity * sizeof (Slot);
+        Slot* slots      = reinterpret_cast<Slot*> (static_cast<char*> (segment.data ()) + header->slots);
+        for (std::size_t i = 0; i < capacity; ++i) {
+            ::new (static_cast<void*> (&slots[i])) Slot{};
+            slots[i].sequence.store (i, std::memory_order_relaxed);
+        }
+        header->version = SHM_RING_VERSION;
+        std::atomic_thread_fence (std::memory_order_release);
+        header->magic = SHM_RING_MAGIC;
+        return ShmRing (segment.data ());
+    }
+
+    // A ring some other process created in segment. Its header is not
+    // trusted: the arrays must be where create () puts them for that
+    // capacity, and all of it inside the segment.
+    static ShmRing attach (ShmSegment& segment) {
+        const Header* header = static_cast<const Header*> (segment.data ());
+        if (segment.size () < sizeof (Header) || header->magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION) {
+            throw std::runtime_error ("ShmRing: no ring in this segment");
+        }
+        const std::uint64_t capacity = header->capacity;
+        if (capacity == 0 || (capacity & (capacity - 1)) || capacity > segment.size () ||
+        bytesFor (static_cast<std::size_t> (capacity)) > segment.size () || header->slots != sizeof (Header) ||
+        header->payloads != sizeof (Header) + capacity * sizeof (Slot)) {
+            throw std::runtime_error ("ShmRing: corrupt ring header in this segment");
+        }
+        return ShmRing (segment.data ());
+    }
+
+    std::size_t capacity () const {
+        return static_cast<std::size_t> (header->capacity);
+    }
+
+    // The payload an offset points to, in this process' mapping. nullptr for
+    // 0, an offset outside the payloads (from a broken producer) throws.
+    const int* resolve (std::uint32_t offset) const {
+        if (!offset) {
+            return nullptr;
+        }
+        if (offset < header->payloads || offset >= header->payloads + header->capacity * sizeof (int) ||
+        offset % sizeof (int)) {
+            throw std::out_of_range ("ShmRing: dynamic_offset outside the payloads");
+        }
+        return reinterpret_cast<const int*> (base + offset);
+    }
+
+    // Producer side, any number of producers. False when the ring is full.
+    bool tryPush (int value) {
+        std::uint64_t position = header->tail.load (std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot                     = &slots[position & mask];
+            const std::uint64_t turn = slot->sequence.load (std::memory_order_acquire);
+            const std::int64_t ahead = static_cast<std::int64_t> (turn - position);
+            if (ahead == 0) {
+                if (header->tail.compare_exchange_weak (position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (ahead < 0) {
+                return false; // the consumer has not freed this slot yet
+            } else {
+                position = header->tail.load (std::memory_order_relaxed);
+            }
+        }
+        int* payload  = &payloads[position & mask];
+        *payload      = value + TESTCLASS_DYNAMICVALUE_ADDITION;
+        slot->record  = ShmTestRecord{ value, static_cast<std::uint32_t> (reinterpret_cast<char*> (payload) - base) };
+        slot->sequence.store (position + 1, std::memory_order_release);
+        notify (header->not_empty);
+        return true;
+    }
+
+    // Blocks while the ring is full.
+    void push (int value) {
+        while (!tryPush (value)) {
+            await (header->not_full, [this] () { return hasSpace (); });
+        }
+    }
+
+    // Consumer side, one consumer. Calls visit (const ShmTestRecord&) on the
+    // oldest record in place, then frees its slot. False when empty.
+    template <typename Visit> bool tryConsume (Visit&& visit) {
+        const std::uint64_t position = header->head.load (std::memory_order_relaxed);
+        Slot& slot                   = slots[position & mask];
+        if (slot.sequence.load (std::memory_order_acquire) != position + 1) {
+            return false;
+        }
+        visit (static_cast<const ShmTestRecord&> (slot.record));
+        header->head.store (position + 1, std::memory_order_relaxed);
+        slot.sequence.store (position + header->capacity, std::memory_order_release);
+        notify (header->not_full);
+        return true;
+    }
+
+    // Blocks while the ring is empty.
+    template <typename Visit> void consume (Visit&& visit) {
+        while (!tryConsume (visit)) {
+            await (header->not_empty, [this] () { return hasRecord (); });
+        }
+    }
+};
@@ -26,6 +26,8 @@ namespace_test::hello_world(int num);
 #include <string>
 #include <utility>
 
+#include "bench_metrics.h"
+
 /*==# DEFINES #==*/
 
 #define TESTCLASS_DEFAULT 0
@@ -157,7 +159,49 @@ class TestClass {
     }
 };
 
-int main () {
+/*==# BENCH #==*/
+/* Run with --bench [--json] [operations] [--runs N] for the time, allocations and counters of every scenario. */
+/* cmake/bench_compare.cmake compares the --json output against a baseline, ./init.sh bench-check runs it. */
+BENCH_COUNT_ALLOCATIONS ();
+
+int benchScenarios (int argc, char** argv) {
+    bench::ScenarioBench bench ("Chapter_02", argc, argv);
+    bench::SilencedStream quiet (std::cout);
+    bench.add ("1. default constructor", [] () { TestClass instance_A (15); });
+    bench.add ("2. copy constructor", [] () {
+        TestClass instance_A (15);
+        TestClass instance_B = instance_A;
+    });
+    bench.add ("3. copy assignment", [] () {
+        TestClass instance_A (15);
+        TestClass instance_C;
+        instance_C = instance_A;
+    });
+    bench.add ("4. move constructor", [] () {
+        TestClass instance_A (15);
+        TestClass instance_D = std::move (instance_A);
+    });
+    bench.add ("5. move assignment", [] () {
+        TestClass instance_B (15);
+        TestClass instance_E;
+        instance_E = std::move (instance_B);
+    });
+    bench.add ("6. namespaced call", [] () {
+        int chosen = space_1::the_chosen_one () + space_2::the_chosen_one ();
+        bench::doNotOptimize (chosen);
+    });
+    bench.add ("7. template call", [] () {
+        int larger = getMax<int> (60, 30);
+        bench::doNotOptimize (larger);
+    });
+    return bench.finish ();
+}
+
+int main (int argc, char** argv) {
+    if (argc > 1 && std::string (argv[1]) == "--bench") {
+        return benchScenarios (argc, argv);
+    }
+
     /*==# SCENARIO 1 #==*/
     /* Using a default Constructor with the number 15 */
     TestClass instance_A (15);
@@ -0,0 +1,168 @@
+/*====# ARENA BENCHMARK #====*/
+/*
+
+Builds, walks and tears down a graph of polymorphic nodes shaped like
+scenario 2 (a base with a virtual destructor and a subclass overriding it),
+plus one trivially destructible edge per node.
+
+* new/delete - every node and edge from new, every one of them deleted
+               through the base pointer (virtual destructor)
+* Arena      - everything created in one Arena, destroyed with reset (),
+               which only visits the nodes, never the edges
+
+The graph is rebuilt every round, like one graph per request, so the arena
+gets to reuse its memory the way a server would.
+
+Usage: Chapter_03_bench_arena [node count, default 1M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "bench_util.h"
+
+/*==# DEFINES #==*/
+
+#define ARENA_BENCH_DEFAULT_COUNT 1000000
+#define ARENA_BENCH_ROUNDS 5
+
+/*==# CLASSES #==*/
+
+// Same shape as VirtualDestructorClass and SubClass_VirtualDestructor, minus the printing.
+
+static std::int64_t destroyed_checksum = 0;
+
+class GraphNode {
+    public:
+    GraphNode* next = nullptr;
+    int value       = 0;
+
+    virtual ~GraphNode () {
+        destroyed_checksum += value;
+    }
+};
+
+class GraphSubNode : public GraphNode {
+    public:
+    GraphNode* child = nullptr;
+
+    ~GraphSubNode () override {
+        destroyed_checksum += 1;
+    }
+};
+
+struct GraphEdge {
+    GraphNode* from;
+    GraphNode* to;
+};
+
+static_assert (std::is_trivially_destructible_v<GraphEdge>, "edges must not need a destructor record");
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+template <typename Create>
+static GraphNode* buildGraph (std::size_t count, Create&& create, std::vector<GraphNode*>* nodes, std::vector<GraphEdge*>* edges) {
+    GraphNode* head = nullptr;
+    for (std::size_t i = 0; i < count; ++i) {
+        GraphNode* node;
+        if (i % 2) {
+            GraphSubNode* sub = create.template operator()<GraphSubNode> ();
+            sub->child        = head;
+            node              = sub;
+        } else {
+            node = create.template operator()<GraphNode> ();
+        }
+        node->value    = static_cast<int> (i & 0xff);
+        node->next     = head;
+        GraphEdge* edge = create.template operator()<GraphEdge> ();
+        edge->from     = node;
+        edge->to       = head;
+        head           = node;
+        if (nodes) {
+            nodes->push_back (node);
+            edges->push_back (edge);
+        }
+    }
+    return head;
+}
+
+static std::int64_t walkGraph (GraphNode* head) {
+    std::int64_t sum = 0;
+    for (GraphNode* node = head; node; node = node->next) {
+        sum += node->value;
+    }
+    return sum;
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, ARENA_BENCH_DEFAULT_COUNT);
+    const std::size_t objects = count * 2;
+
+    std::printf ("Arena benchmark, %zu nodes + %zu edges per graph, %d rounds\n", count,
+    count, ARENA_BENCH_ROUNDS);
+    bench::printHeader ("PER OBJECT (NODES + EDGES)");
+
+    {
+        std::vector<GraphNode*> nodes;
+        std::vector<GraphEdge*> edges;
+        nodes.reserve (count);
+        edges.reserve (count);
+        auto create = []<typename T> () { return new T (); };
+
+        for (int round = 0; round < ARENA_BENCH_ROUNDS; ++round) {
+            GraphNode* head = nullptr;
+            bench::Result build = bench::measure ("new/delete  build", objects, [&] () {
+                head = buildGraph (count, create, &nodes, &edges);
+            });
+            bench::Result walk = bench::measure ("new/delete  walk", count, [&] () {
+                bench::doNotOptimize (walkGraph (head));
+            });
+            bench::Result teardown = bench::measure ("new/delete  teardown", objects, [&] () {
+                for (GraphNode* node : nodes) {
+                    delete node;
+                }
+                for (GraphEdge* edge : edges) {
+                    delete edge;
+                }
+                nodes.clear ();
+                edges.clear ();
+            });
+            if (round == ARENA_BENCH_ROUNDS - 1) {
+                bench::printResult (build);
+                bench::printResult (walk);
+                bench::printResult (teardown);
+            }
+        }
+    }
+
+    {
+        Arena arena (1024 * 1024);
+        auto create = [&arena]<typename T> () { return arena.create<T> (); };
+
+        for (int round = 0; round < ARENA_BENCH_ROUNDS; ++round) {
+            GraphNode* head = nullptr;
+            bench::Result build = bench::measure ("Arena       build", objects, [&] () {
+                head = buildGraph (count, create, nullptr, nullptr);
+            });
+            bench::Result walk = bench::measure ("Arena       walk", count, [&] () {
+                bench::doNotOptimize (walkGraph (head));
+            });
+            bench::Result teardown = bench::measure ("Arena       teardown", objects, [&] () {
+                arena.reset ();
+            });
+            if (round == ARENA_BENCH_ROUNDS - 1) {
+                bench::printResult (build);
+                bench::printResult (walk);
+                bench::printResult (teardown);
+            }
+        }
+    }
+
+    std::printf ("\n(destructor checksum %lld)\n", static_cast<long long> (destroyed_checksum));
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*====# ARENA CLONE BENCHMARK #====*/
+/*
+
+Deep copies a polymorphic binary tree (branch and leaf nodes) of N nodes:
+
+* recursive new  - the classic virtual clone (), one new per node,
+                   one recursive call per child
+* arena clone    - cloneGraph into an Arena, worklist and remapping table
+
+The arena clone also handles shared nodes, which the recursive clone
+cannot: the last run adds a shortcut from every branch to a random earlier
+node (a DAG) and clones that, for the arena only.
+
+Usage: Chapter_03_bench_arena_clone [node count, default 1M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "arena.h"
+#include "arena_clone.h"
+#include "bench_util.h"
+
+/*==# DEFINES #==*/
+
+#define CLONE_BENCH_DEFAULT_COUNT 1000000
+#define CLONE_BENCH_SEED 0x5eed
+
+/*==# CLASSES #==*/
+
+class TreeNode {
+    public:
+    ARENA_CLONEABLE_ABSTRACT_ROOT (TreeNode)
+
+    int value = 0;
+
+    virtual ~TreeNode () = default;
+    virtual TreeNode* cloneNew () const = 0;
+    virtual std::int64_t checksum () const = 0;
+};
+
+class LeafNode final : public TreeNode {
+    public:
+    ARENA_CLONEABLE (LeafNode)
+
+    TreeNode* cloneNew () const override {
+        return new LeafNode (*this);
+    }
+
+    std::int64_t checksum () const override {
+        return value;
+    }
+};
+
+class BranchNode final : public TreeNode {
+    public:
+    ARENA_CLONEABLE (BranchNode)
+
+    TreeNode* left     = nullptr;
+    TreeNode* right    = nullptr;
+    TreeNode* shortcut = nullptr;
+
+    void relink (CloneContext& context) override {
+        left     = context.remap (left);
+        right    = context.remap (right);
+        shortcut = context.remap (shortcut);
+    }
+
+    TreeNode* cloneNew () const override {
+        BranchNode* clone = new BranchNode (*this);
+        clone->left       = left ? left->cloneNew () : nullptr;
+        clone->right      = right ? right->cloneNew () : nullptr;
+        return clone;
+    }
+
+    std::int64_t checksum () const override {
+        return value + (left ? left->checksum () : 0) + (right ? right->checksum () : 0);
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// Complete binary tree in an arena, node i has the children 2i+1 and 2i+2.
+static TreeNode* buildTree (Arena& arena, std::size_t count, bool shortcuts) {
+    std::vector<TreeNode*> nodes (count);
+    for (std::size_t i = count; i-- > 0;) {
+        if (2 * i + 1 < count) {
+            BranchNode* branch = arena.create<BranchNode> ();
+            branch->left       = nodes[2 * i + 1];
+            branch->right      = 2 * i + 2 < count ? nodes[2 * i + 2] : nullptr;
+            nodes[i]           = branch;
+        } else {
+            nodes[i] = arena.create<LeafNode> ();
+        }
+        nodes[i]->value = static_cast<int> (i & 0xff);
+    }
+    if (shortcuts) {
+        std::mt19937_64 generator (CLONE_BENCH_SEED);
+        for (std::size_t i = 1; 2 * i + 1 < count; ++i) {
+            static_cast<BranchNode*> (nodes[i])->shortcut = nodes[generator () % i];
+        }
+    }
+    return nodes[0];
+}
+
+static void deleteTree (TreeNode* node) {
+    if (BranchNode* branch = dynamic_cast<BranchNode*> (node)) {
+        deleteTree (branch->left);
+        deleteTree (branch->right);
+    }
+    delete node;
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, CLONE_BENCH_DEFAULT_COUNT);
+
+    std::printf ("Arena clone benchmark, binary tree of %zu nodes\n", count);
+    bench::printHeader ("DEEP COPY PER NODE");
+
+    Arena source_arena (1024 * 1024);
+    TreeNode* tree = buildTree (source_arena, count, false);
+    const std::int64_t expected = tree->checksum ();
+
+    TreeNode* new_copy = nullptr;
+    bench::printResult (bench::measure ("recursive new  clone", count, [&] () {
+        new_copy = tree->cloneNew ();
+    }));
+    bench::printResult (bench::measure ("recursive new  teardown", count, [&] () {
+        deleteTree (new_copy);
+    }));
+
+    Arena destination (1024 * 1024);
+    TreeNode* arena_copy = nullptr;
+    bench::printResult (bench::measure ("arena clone    clone", count, [&] () {
+        arena_copy = cloneGraph (tree, destination, count);
+    }));
+    if (arena_copy->checksum () != expected) {
+        std::printf ("arena clone checksum mismatch!\n");
+        return 1;
+    }
+    bench::printResult (bench::measure ("arena clone    teardown", count, [&] () {
+        destination.reset ();
+    }));
+
+    Arena dag_arena (1024 * 1024);
+    TreeNode* dag = buildTree (dag_arena, count, true);
+    bench::printResult (bench::measure ("arena clone    DAG clone", count, [&] () {
+        bench::doNotOptimize (cloneGraph (dag, destination, count));
+    }));
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*====# BATCH VIRTUAL BENCHMARK #====*/
+/*
+
+What is left of the dispatch cost when one virtual call handles a batch of
+objects instead of one (AbstractInterface::returnNumbers, inheritance.h 1.2)?
+
+The population holds four final BatchedInterface types, sorted by type in
+runs of 1024 objects, so every batch of up to 1024 objects has one type.
+The next batch is always of the next type, the same unpredictable target
+pattern as a shuffled mix when the batch size is 1.
+
+* per object  - objects[i]->returnNumber (), one call per object
+* batch of N  - objects[i]->returnNumbers (N objects), one call per N
+* grouped     - the free returnNumbers, which finds the runs by itself,
+                over the sorted and over a shuffled population (runs of
+                about one object, the price of looking for runs)
+
+Usage: Chapter_03_bench_batch_virtual [object count, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bench_util.h"
+#include "inheritance.h"
+
+/*==# DEFINES #==*/
+
+#define BATCH_BENCH_DEFAULT_COUNT 10000000
+#define BATCH_BENCH_RUN 1024
+#define BATCH_BENCH_SEED 0x5eed
+
+/*==# CLASSES #==*/
+
+// Each carries its number as state, so the loops have to touch the objects.
+template <int Number> class BatchedNumber final : public BatchedInterface<BatchedNumber<Number>> {
+    public:
+    int number = Number;
+
+    char returnChar () override {
+        return 'b';
+    }
+    int returnNumber () override {
+        return number;
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static std::int64_t sumOf (const std::vector<int>& numbers) {
+    std::int64_t sum = 0;
+    for (int number : numbers) {
+        sum += number;
+    }
+    return sum;
+}
+
+__attribute__ ((noinline)) static void perObject (const std::vector<AbstractInterface*>& objects,
+std::vector<int>& out) {
+    for (std::size_t i = 0; i < objects.size (); ++i) {
+        out[i] = objects[i]->returnNumber ();
+    }
+}
+
+__attribute__ ((noinline)) static void perBatch (const std::vector<AbstractInterface*>& objects,
+std::vector<int>& out, std::size_t batch) {
+    std::span<AbstractInterface* const> all (objects);
+    std::span<int> numbers (out);
+    for (std::size_t begin = 0; begin < objects.size (); begin += batch) {
+        std::size_t size = std::min (batch, objects.size () - begin);
+        objects[begin]->returnNumbers (all.subspan (begin, size), numbers.subspan (begin, size));
+    }
+}
+
+int main (int argc, char** argv) {
+    std::size_t count = bench::countFromArgs (argc, argv, BATCH_BENCH_DEFAULT_COUNT);
+    count             = (count + BATCH_BENCH_RUN - 1) / BATCH_BENCH_RUN * BATCH_BENCH_RUN;
+
+    std::printf ("Batch virtual benchmark, %zu objects of 4 types in runs of %d\n", count,
+    BATCH_BENCH_RUN);
+
+    // Objects live in per-type pools, the pointer array goes E F G H E F ...
+    const std::size_t per_type = count / 4 + BATCH_BENCH_RUN;
+    std::vector<BatchedNumber<15>> pool_e (per_type);
+    std::vector<BatchedNumber<16>> pool_f (per_type);
+    std::vector<BatchedNumber<17>> pool_g (per_type);
+    std::vector<BatchedNumber<18>> pool_h (per_type);
+    std::vector<AbstractInterface*> objects;
+    objects.reserve (count);
+    for (std::size_t run = 0; objects.size () < count; ++run) {
+        for (std::size_t i = 0; i < BATCH_BENCH_RUN; ++i) {
+            std::size_t slot = run / 4 * BATCH_BENCH_RUN + i;
+            switch (run % 4) {
+            case 0: objects.push_back (&pool_e[slot]); break;
+            case 1: objects.push_back (&pool_f[slot]); break;
+            case 2: objects.push_back (&pool_g[slot]); break;
+            default: objects.push_back (&pool_h[slot]); break;
+            }
+        }
+    }
+
+    std::vector<int> out (count);
+    perObject (objects, out);
+    const std::int64_t expected = sumOf (out);
+    auto check                  = [&out, expected] () {
+        if (sumOf (out) != expected) {
+            std::printf ("checksum mismatch!\n");
+        }
+    };
+
+    bench::printHeader ("PER OBJECT");
+    bench::printResult (bench::measure ("per object", count, [&] () {
+        perObject (objects, out);
+        bench::clobberMemory ();
+    }));
+    check ();
+
+    bench::printHeader ("BATCHED, ONE TYPE PER BATCH");
+    for (std::size_t batch = 1; batch <= BATCH_BENCH_RUN; batch *= 4) {
+        char label[64];
+        std::snprintf (label, sizeof (label), "batch of %zu", batch);
+        bench::printResult (bench::measure (label, count, [&] () {
+            perBatch (objects, out, batch);
+            bench::clobberMemory ();
+        }));
+        check ();
+    }
+
+    bench::printHeader ("GROUPED BY returnNumbers ()");
+    bench::printResult (bench::measure ("sorted", count, [&] () {
+        returnNumbers (objects, out);
+        bench::clobberMemory ();
+    }));
+    check ();
+
+    std::mt19937_64 generator (BATCH_BENCH_SEED);
+    std::shuffle (objects.begin (), objects.end (), generator);
+    perObject (objects, out);
+    const std::int64_t shuffled_expected = sumOf (out);
+    bench::printResult (bench::measure ("shuffled", count, [&] () {
+        returnNumbers (objects, out);
+        bench::clobberMemory ();
+    }));
+    bench::printResult (bench::measure ("shuffled, per object", count, [&] () {
+        perObject (objects, out);
+        bench::clobberMemory ();
+    }));
+    if (sumOf (out) != shuffled_expected) {
+        std::printf ("checksum mismatch!\n");
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
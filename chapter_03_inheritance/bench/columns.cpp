@@ -0,0 +1,193 @@
+/*====# COLUMN TABLE BENCHMARK #====*/
+/*
+
+Scans one field of N ClassToBeSliced objects, stored as an array of rows
+(std::vector<ClassToBeSliced>, 24 B per row) and as columns
+(ColumnTable<ClassToBeSliced>, 4 B per row and field):
+
+* sum (c), min (d), max (d)
+* filter 100 <= c <= 199, about 10 % of the rows, returns the row indices
+* rows -> columns and columns -> rows conversion, allocation and first
+  touch of the destination included (page faults are most of it)
+
+Column kernels run twice, as plain loops (whatever the compiler makes of
+them at -O2) and as the AVX2 kernels. The row array is freed before the
+columns are built, so 100M rows fit in ~2.4 GB instead of twice that; the
+conversion is timed on at most CONVERT_ROWS of them.
+
+Usage: Chapter_03_bench_columns [row count, default 100M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <vector>
+
+#include "bench_util.h"
+#include "sliced_columns.h"
+
+/*==# DEFINES #==*/
+
+#define COLUMNS_BENCH_DEFAULT_COUNT 100000000
+#define COLUMNS_BENCH_CONVERT_ROWS 10000000
+#define COLUMNS_BENCH_SEED 0x5eed
+#define COLUMNS_BENCH_LOW 100
+#define COLUMNS_BENCH_HIGH 199
+
+/*==# CLASSES #==*/
+
+// xorshift, std::mt19937 would dominate building 100M rows.
+class RowGenerator {
+
+    private:
+    std::uint64_t state = COLUMNS_BENCH_SEED;
+
+    int next () {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<int> (state % 1000);
+    }
+
+    public:
+    ClassToBeSliced row () {
+        ClassToBeSliced object;
+        object.ParentSlicerClass::a = next ();
+        object.ParentSlicerClass::b = next ();
+        object.a                    = next ();
+        object.b                    = next ();
+        object.c                    = next ();
+        object.d                    = next ();
+        return object;
+    }
+};
+
+struct Answers {
+    std::int64_t sum;
+    int min;
+    int max;
+    std::size_t selected;
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static void check (const Answers& expected, std::int64_t sum, int min, int max, std::size_t selected) {
+    if (sum != expected.sum || min != expected.min || max != expected.max || selected != expected.selected) {
+        std::printf ("result mismatch!\n");
+    }
+}
+
+static Answers scanRows (std::size_t count) {
+    std::vector<ClassToBeSliced> rows;
+    rows.reserve (count);
+    RowGenerator generator;
+    for (std::size_t i = 0; i < count; ++i) {
+        rows.push_back (generator.row ());
+    }
+
+    Answers answers{};
+    bench::printHeader ("ARRAY OF ROWS (24 B per row)");
+    bench::printResult (bench::measure ("sum (c)", count, [&] () {
+        std::int64_t sum = 0;
+        for (const ClassToBeSliced& row : rows) {
+            sum += row.c;
+        }
+        answers.sum = sum;
+    }));
+    bench::printResult (bench::measure ("min (d)", count, [&] () {
+        int min = rows[0].d;
+        for (const ClassToBeSliced& row : rows) {
+            min = std::min (min, row.d);
+        }
+        answers.min = min;
+    }));
+    bench::printResult (bench::measure ("max (d)", count, [&] () {
+        int max = rows[0].d;
+        for (const ClassToBeSliced& row : rows) {
+            max = std::max (max, row.d);
+        }
+        answers.max = max;
+    }));
+    std::vector<std::uint32_t> selected;
+    bench::printResult (bench::measure ("filter (c)", count, [&] () {
+        selected.resize (count);
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            selected[found] = static_cast<std::uint32_t> (i);
+            found += rows[i].c >= COLUMNS_BENCH_LOW && rows[i].c <= COLUMNS_BENCH_HIGH;
+        }
+        answers.selected = found;
+    }));
+
+    const std::size_t convert = std::min<std::size_t> (count, COLUMNS_BENCH_CONVERT_ROWS);
+    std::span<const ClassToBeSliced> head (rows.data (), convert);
+    bench::printHeader ("CONVERSION");
+    ColumnTable<ClassToBeSliced> converted;
+    bench::printResult (bench::measure ("rows -> columns", convert, [&] () {
+        converted = ColumnTable<ClassToBeSliced> (head);
+    }));
+    std::vector<ClassToBeSliced> back;
+    bench::printResult (bench::measure ("columns -> rows", convert, [&] () {
+        back = converted.toRows ();
+    }));
+    for (std::size_t i = 0; i < convert; ++i) {
+        if (back[i].ParentSlicerClass::a != rows[i].ParentSlicerClass::a || back[i].d != rows[i].d) {
+            std::printf ("conversion mismatch!\n");
+            break;
+        }
+    }
+    return answers;
+}
+
+static void scanColumns (std::size_t count, const Answers& expected) {
+    ColumnTable<ClassToBeSliced> table;
+    table.reserve (count);
+    RowGenerator generator;
+    for (std::size_t i = 0; i < count; ++i) {
+        table.append (generator.row ());
+    }
+    std::span<const int> c = table.column (SLICED_C);
+    std::span<const int> d = table.column (SLICED_D);
+    std::vector<std::uint32_t> selected;
+
+    bench::printHeader ("COLUMNS, PLAIN LOOPS (4 B per row)");
+    std::int64_t sum = 0;
+    int min = 0, max = 0;
+    std::size_t found = 0;
+    bench::printResult (bench::measure ("sum (c)", count, [&] () { sum = columns::sumScalar (c); }));
+    bench::printResult (bench::measure ("min (d)", count, [&] () { min = columns::minScalar (d); }));
+    bench::printResult (bench::measure ("max (d)", count, [&] () { max = columns::maxScalar (d); }));
+    bench::printResult (bench::measure ("filter (c)", count, [&] () {
+        found = columns::filterBetweenScalar (c, COLUMNS_BENCH_LOW, COLUMNS_BENCH_HIGH, selected);
+    }));
+    check (expected, sum, min, max, found);
+
+#ifdef COLUMN_HAS_AVX2
+    if (!columns::hasAvx2 ()) {
+        std::printf ("no AVX2 on this CPU, skipping the AVX2 kernels\n");
+        return;
+    }
+    bench::printHeader ("COLUMNS, AVX2 KERNELS");
+    bench::printResult (bench::measure ("sum (c)", count, [&] () { sum = columns::sumAvx2 (c); }));
+    bench::printResult (bench::measure ("min (d)", count, [&] () { min = columns::extremeAvx2<false> (d); }));
+    bench::printResult (bench::measure ("max (d)", count, [&] () { max = columns::extremeAvx2<true> (d); }));
+    bench::printResult (bench::measure ("filter (c)", count, [&] () {
+        found = columns::filterBetweenAvx2 (c, COLUMNS_BENCH_LOW, COLUMNS_BENCH_HIGH, selected);
+    }));
+    check (expected, sum, min, max, found);
+#else
+    std::printf ("not an x86-64 build, no AVX2 kernels\n");
+#endif
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, COLUMNS_BENCH_DEFAULT_COUNT);
+
+    std::printf ("Column table benchmark, %zu ClassToBeSliced rows\n", count);
+
+    const Answers expected = scanRows (count);
+    scanColumns (count, expected);
+
+    /*==# THE END #==*/
+    return 0;
+}
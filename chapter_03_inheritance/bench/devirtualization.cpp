@@ -0,0 +1,363 @@
+/*====# DEVIRTUALIZATION BENCHMARK #====*/
+/*
+
+How much does calling AbstractInterface::returnChar and returnNumber through
+the vtable actually cost, and what do the alternatives buy us?
+
+Every strategy calls both functions once per object over the same
+heterogeneous population of four types, once with the objects sorted by type
+and once shuffled. Sorted mixes let the branch predictor learn the target,
+shuffled ones show the real price of an unpredictable indirect branch.
+
+## Strategies ##
+* virtual      - std::vector<AbstractInterface*>, plain vtable dispatch
+* final        - same pointers, but the types are final and we guard on typeid,
+                 so every call after the guard is direct and inlined
+* CRTP         - static interface, one tight loop per type bucket
+                 (the order of the mix does not exist here, by construction)
+* variant      - std::vector<std::variant<...>> and std::visit
+* fn table     - a tag byte indexing a hand-rolled table of function pointers
+* switch       - a tag byte and a switch statement
+
+Usage: Chapter_03_bench_devirtualization [object count, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <typeinfo>
+#include <variant>
+#include <vector>
+
+#include "bench_util.h"
+#include "inheritance.h"
+
+/*==# DEFINES #==*/
+
+#define DEVIRT_DEFAULT_COUNT 10000000
+#define DEVIRT_KIND_COUNT 4
+#define DEVIRT_SEED 0x5eed
+
+/*==# CLASSES #==*/
+
+// 1. VIRTUAL IMPLEMENTERS //
+/* Four final implementers of AbstractInterface. */
+/* Each carries its number as state, so the loops have to touch the objects. */
+
+class FinalE final : public AbstractInterface {
+    public:
+    int number = 15;
+
+    char returnChar () override {
+        return 'e';
+    }
+    int returnNumber () override {
+        return number;
+    }
+};
+
+class FinalF final : public AbstractInterface {
+    public:
+    int number = 16;
+
+    char returnChar () override {
+        return 'f';
+    }
+    int returnNumber () override {
+        return number;
+    }
+};
+
+class FinalG final : public AbstractInterface {
+    public:
+    int number = 17;
+
+    char returnChar () override {
+        return 'g';
+    }
+    int returnNumber () override {
+        return number;
+    }
+};
+
+class FinalH final : public AbstractInterface {
+    public:
+    int number = 18;
+
+    char returnChar () override {
+        return 'h';
+    }
+    int returnNumber () override {
+        return number;
+    }
+};
+
+// 2. STATIC IMPLEMENTERS //
+/* The same four types without a vptr, dispatched through StaticInterface. */
+
+class PlainE final : public StaticInterface<PlainE> {
+    public:
+    int number = 15;
+
+    char returnChar () {
+        return 'e';
+    }
+    int returnNumber () {
+        return number;
+    }
+};
+
+class PlainF final : public StaticInterface<PlainF> {
+    public:
+    int number = 16;
+
+    char returnChar () {
+        return 'f';
+    }
+    int returnNumber () {
+        return number;
+    }
+};
+
+class PlainG final : public StaticInterface<PlainG> {
+    public:
+    int number = 17;
+
+    char returnChar () {
+        return 'g';
+    }
+    int returnNumber () {
+        return number;
+    }
+};
+
+class PlainH final : public StaticInterface<PlainH> {
+    public:
+    int number = 18;
+
+    char returnChar () {
+        return 'h';
+    }
+    int returnNumber () {
+        return number;
+    }
+};
+
+using PlainVariant = std::variant<PlainE, PlainF, PlainG, PlainH>;
+
+// 3. TAGGED OBJECTS //
+/* The object only carries its type tag, dispatch is done by the caller. */
+
+struct TaggedObject {
+    std::uint8_t kind;
+    int number;
+};
+
+struct DispatchEntry {
+    char (*returnChar) (const TaggedObject*);
+    int (*returnNumber) (const TaggedObject*);
+};
+
+template <typename Plain> char tableReturnChar (const TaggedObject* object) {
+    Plain plain;
+    plain.number = object->number;
+    return plain.returnChar ();
+}
+
+template <typename Plain> int tableReturnNumber (const TaggedObject* object) {
+    Plain plain;
+    plain.number = object->number;
+    return plain.returnNumber ();
+}
+
+static const DispatchEntry dispatch_table[DEVIRT_KIND_COUNT] = {
+    { tableReturnChar<PlainE>, tableReturnNumber<PlainE> },
+    { tableReturnChar<PlainF>, tableReturnNumber<PlainF> },
+    { tableReturnChar<PlainG>, tableReturnNumber<PlainG> },
+    { tableReturnChar<PlainH>, tableReturnNumber<PlainH> },
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static std::vector<std::uint8_t> makeKinds (std::size_t count, bool shuffled) {
+    std::vector<std::uint8_t> kinds (count);
+    for (std::size_t i = 0; i < count; ++i) {
+        kinds[i] = static_cast<std::uint8_t> (i % DEVIRT_KIND_COUNT);
+    }
+    if (shuffled) {
+        std::mt19937_64 generator (DEVIRT_SEED);
+        std::shuffle (kinds.begin (), kinds.end (), generator);
+    } else {
+        std::sort (kinds.begin (), kinds.end ());
+    }
+    return kinds;
+}
+
+static std::int64_t callVirtual (const std::vector<AbstractInterface*>& objects) {
+    std::int64_t sum = 0;
+    for (AbstractInterface* object : objects) {
+        sum += object->returnNumber ();
+        sum += object->returnChar ();
+    }
+    return sum;
+}
+
+template <typename Final> static bool callIfType (AbstractInterface* object, std::int64_t& sum) {
+    if (typeid (*object) != typeid (Final)) {
+        return false;
+    }
+    Final* exact = static_cast<Final*> (object);
+    sum += exact->returnNumber ();
+    sum += exact->returnChar ();
+    return true;
+}
+
+static std::int64_t callFinal (const std::vector<AbstractInterface*>& objects) {
+    std::int64_t sum = 0;
+    for (AbstractInterface* object : objects) {
+        callIfType<FinalE> (object, sum) || callIfType<FinalF> (object, sum) ||
+        callIfType<FinalG> (object, sum) || callIfType<FinalH> (object, sum);
+    }
+    return sum;
+}
+
+template <typename Plain> static std::int64_t callBucket (std::vector<Plain>& bucket) {
+    std::int64_t sum = 0;
+    for (Plain& object : bucket) {
+        sum += object.returnNumber ();
+        sum += object.returnChar ();
+    }
+    return sum;
+}
+
+static std::int64_t callVariant (std::vector<PlainVariant>& objects) {
+    std::int64_t sum = 0;
+    for (PlainVariant& object : objects) {
+        sum += std::visit (
+        [] (auto& plain) -> std::int64_t {
+            return plain.returnNumber () + plain.returnChar ();
+        },
+        object);
+    }
+    return sum;
+}
+
+static std::int64_t callTable (const std::vector<TaggedObject>& objects) {
+    std::int64_t sum = 0;
+    for (const TaggedObject& object : objects) {
+        const DispatchEntry& entry = dispatch_table[object.kind];
+        sum += entry.returnNumber (&object);
+        sum += entry.returnChar (&object);
+    }
+    return sum;
+}
+
+static std::int64_t callSwitch (const std::vector<TaggedObject>& objects) {
+    std::int64_t sum = 0;
+    for (const TaggedObject& object : objects) {
+        switch (object.kind) {
+        case 0: sum += object.number + PlainE ().returnChar (); break;
+        case 1: sum += object.number + PlainF ().returnChar (); break;
+        case 2: sum += object.number + PlainG ().returnChar (); break;
+        default: sum += object.number + PlainH ().returnChar (); break;
+        }
+    }
+    return sum;
+}
+
+static void runMix (std::size_t count, bool shuffled) {
+    const std::vector<std::uint8_t> kinds = makeKinds (count, shuffled);
+    const std::size_t calls               = count * 2;
+
+    bench::printHeader (shuffled ? "SHUFFLED MIX" : "SORTED MIX");
+
+    {
+        // Objects live in per-type pools, the pointer array follows the mix.
+        std::vector<FinalE> pool_e (count / DEVIRT_KIND_COUNT + 1);
+        std::vector<FinalF> pool_f (count / DEVIRT_KIND_COUNT + 1);
+        std::vector<FinalG> pool_g (count / DEVIRT_KIND_COUNT + 1);
+        std::vector<FinalH> pool_h (count / DEVIRT_KIND_COUNT + 1);
+        std::size_t used[DEVIRT_KIND_COUNT] = {};
+        std::vector<AbstractInterface*> objects;
+        objects.reserve (count);
+        for (std::uint8_t kind : kinds) {
+            std::size_t slot = used[kind]++;
+            switch (kind) {
+            case 0: objects.push_back (&pool_e[slot]); break;
+            case 1: objects.push_back (&pool_f[slot]); break;
+            case 2: objects.push_back (&pool_g[slot]); break;
+            default: objects.push_back (&pool_h[slot]); break;
+            }
+        }
+
+        bench::printResult (bench::measure ("virtual", calls, [&] () {
+            bench::doNotOptimize (callVirtual (objects));
+        }));
+        bench::printResult (bench::measure ("final + typeid guard", calls, [&] () {
+            bench::doNotOptimize (callFinal (objects));
+        }));
+    }
+
+    {
+        std::size_t per_kind[DEVIRT_KIND_COUNT] = {};
+        for (std::uint8_t kind : kinds) {
+            ++per_kind[kind];
+        }
+        std::vector<PlainE> bucket_e (per_kind[0]);
+        std::vector<PlainF> bucket_f (per_kind[1]);
+        std::vector<PlainG> bucket_g (per_kind[2]);
+        std::vector<PlainH> bucket_h (per_kind[3]);
+
+        bench::printResult (bench::measure ("CRTP (type buckets)", calls, [&] () {
+            bench::doNotOptimize (callBucket (bucket_e) + callBucket (bucket_f) +
+            callBucket (bucket_g) + callBucket (bucket_h));
+        }));
+    }
+
+    {
+        std::vector<PlainVariant> objects;
+        objects.reserve (count);
+        for (std::uint8_t kind : kinds) {
+            switch (kind) {
+            case 0: objects.emplace_back (PlainE ()); break;
+            case 1: objects.emplace_back (PlainF ()); break;
+            case 2: objects.emplace_back (PlainG ()); break;
+            default: objects.emplace_back (PlainH ()); break;
+            }
+        }
+
+        bench::printResult (bench::measure ("std::variant + std::visit", calls, [&] () {
+            bench::doNotOptimize (callVariant (objects));
+        }));
+    }
+
+    {
+        std::vector<TaggedObject> objects;
+        objects.reserve (count);
+        for (std::uint8_t kind : kinds) {
+            objects.push_back (TaggedObject{ kind, 15 + kind });
+        }
+
+        bench::printResult (bench::measure ("function pointer table", calls, [&] () {
+            bench::doNotOptimize (callTable (objects));
+        }));
+        bench::printResult (bench::measure ("switch on tag", calls, [&] () {
+            bench::doNotOptimize (callSwitch (objects));
+        }));
+    }
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, DEVIRT_DEFAULT_COUNT);
+
+    std::printf ("Devirtualization benchmark, %zu objects of %d types, 2 calls each\n",
+    count, DEVIRT_KIND_COUNT);
+
+    runMix (count, false);
+    runMix (count, true);
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*====# DIAMOND LAYOUT BENCHMARK #====*/
+/*
+
+Loads the member of A through D and through its B part, for the three
+layouts of the diamond from scenario 4:
+
+* virtual     - B : virtual A, C : virtual A, D : B, C (the chapter's layout)
+                one A, but every access loads the vbase offset from the vtable
+* duplicated  - B : A, C : A, D : B, C
+                no indirection, but every D carries two A's
+* composition - D has an A and the B role reaches it at a fixed offset
+                (ComposedD in inheritance.h)
+
+The A of the chapter is empty, there would be nothing to load, so the three
+hierarchies are rebuilt here the same way with an int in A. Every layout is
+reached through pointers to D and to the B part (the way functions written
+against B see the object), whose origin the compiler has forgotten, so it
+cannot skip the lookup. The accessor is inlined into the loop, nothing but
+the lookup and the load is measured.
+
+Usage: Chapter_03_bench_diamond [object count, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <vector>
+
+#include "bench_util.h"
+
+/*==# DEFINES #==*/
+
+#define DIAMOND_BENCH_DEFAULT_COUNT 10000000
+
+/*==# CLASSES #==*/
+
+struct BenchA {
+    int value = 1;
+};
+
+// 1. VIRTUAL INHERITANCE //
+struct VirtualB : virtual BenchA {
+    int b = 2;
+};
+struct VirtualC : virtual BenchA {
+    int c = 3;
+};
+struct VirtualD : VirtualB, VirtualC {};
+
+// 2. DUPLICATED BASES //
+struct DuplicatedB : BenchA {
+    int b = 2;
+};
+struct DuplicatedC : BenchA {
+    int c = 3;
+};
+struct DuplicatedD : DuplicatedB, DuplicatedC {};
+
+// 3. COMPOSITION //
+template <typename Owner> struct ComposedBRole {
+    BenchA& base () {
+        return static_cast<Owner*> (this)->a;
+    }
+};
+struct ComposedBenchD : ComposedBRole<ComposedBenchD> {
+    BenchA a;
+    int b = 2;
+    int c = 3;
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+template <typename Pointer, typename Locate>
+static std::int64_t sweep (const std::vector<Pointer>& objects, Locate locate) {
+    std::int64_t sum = 0;
+    for (Pointer object : objects) {
+        sum += locate (*object).value;
+    }
+    return sum;
+}
+
+// objects, seen as pointers of type Pointer, each one located through locate.
+template <typename D, typename Pointer, typename Locate>
+static void run (const char* name, std::vector<D>& objects, Locate locate) {
+    std::vector<Pointer> pointers;
+    pointers.reserve (objects.size ());
+    for (D& object : objects) {
+        pointers.push_back (&object);
+    }
+    bench::doNotOptimize (pointers.data ()); // forget where they came from
+    bench::doNotOptimize (sweep (pointers, locate)); // warm up the pages
+    char label[64];
+    std::snprintf (label, sizeof (label), "%s [%zu B]", name, sizeof (D));
+    bench::printResult (bench::measure (label, objects.size (), [&] () {
+        bench::doNotOptimize (sweep (pointers, locate));
+    }));
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, DIAMOND_BENCH_DEFAULT_COUNT);
+
+    std::printf ("Diamond layout benchmark, %zu objects, loads of A::value\n", count);
+    bench::printHeader ("A MEMBER ACCESS");
+
+    {
+        std::vector<VirtualD> objects (count);
+        run<VirtualD, VirtualD*> ("virtual      via D*", objects, [] (VirtualD& d) -> BenchA& { return d; });
+        run<VirtualD, VirtualB*> ("virtual      via B*", objects, [] (VirtualB& b) -> BenchA& { return b; });
+    }
+    {
+        std::vector<DuplicatedD> objects (count);
+        run<DuplicatedD, DuplicatedD*> ("duplicated   via D*", objects,
+        [] (DuplicatedD& d) -> BenchA& { return static_cast<DuplicatedB&> (d); });
+        run<DuplicatedD, DuplicatedB*> ("duplicated   via B*", objects, [] (DuplicatedB& b) -> BenchA& { return b; });
+    }
+    {
+        std::vector<ComposedBenchD> objects (count);
+        run<ComposedBenchD, ComposedBenchD*> ("composition  via D*", objects,
+        [] (ComposedBenchD& d) -> BenchA& { return d.a; });
+        run<ComposedBenchD, ComposedBRole<ComposedBenchD>*> ("composition  via BRole*", objects,
+        [] (ComposedBRole<ComposedBenchD>& role) -> BenchA& { return role.base (); });
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*====# DISPATCH COUNTERS BENCHMARK #====*/
+/*
+
+isFiveStar () through PolymorphicClass* over a vector of pointers, a Google
+Benchmark with the hardware counters of sandbox_bench, per object. Two
+things make the same loop slow, and the counters tell which one it is:
+
+* typeOrder   - the objects lie in memory in the order we call them, only
+                the type order changes: sorted (all PolymorphicClass, then
+                all OverridingClass) or shuffled. Shuffled costs branch
+                misses, the indirect call target is a coin flip.
+* memoryOrder - the types are shuffled either way, the pointers are walked
+                in allocation order or in a shuffled one. Shuffled costs
+                L1D, LLC and dTLB misses, every object is somewhere else.
+
+Small counts fit the L1D, large ones do not fit the LLC.
+
+Usage: Chapter_03_gbench_dispatch_counters [Google Benchmark flags]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "inheritance.h"
+#include "sandbox_bench.h"
+
+/*==# DEFINES #==*/
+
+#define DISPATCH_COUNTERS_SEED 0x5eed
+#define DISPATCH_COUNTERS_SMALL (1 << 10)
+#define DISPATCH_COUNTERS_LARGE (1 << 21)
+
+enum Order { ORDER_SORTED = 0, ORDER_SHUFFLED };
+
+/*==# CLASSES #==*/
+
+// Objects allocated one after another, types as asked, pointers in allocation order.
+struct Objects {
+    std::vector<std::unique_ptr<PolymorphicClass>> owners;
+    std::vector<PolymorphicClass*> pointers;
+
+    Objects (std::size_t count, Order types) {
+        std::vector<bool> overriding (count);
+        for (std::size_t i = 0; i < count; ++i) {
+            overriding[i] = i >= count / 2;
+        }
+        std::mt19937_64 generator (DISPATCH_COUNTERS_SEED);
+        if (types == ORDER_SHUFFLED) {
+            std::shuffle (overriding.begin (), overriding.end (), generator);
+        }
+        owners.reserve (count);
+        pointers.reserve (count);
+        for (bool is_overriding : overriding) {
+            if (is_overriding) {
+                owners.push_back (std::make_unique<OverridingClass> ());
+            } else {
+                owners.push_back (std::make_unique<PolymorphicClass> ());
+            }
+            pointers.push_back (owners.back ().get ());
+        }
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static void countFiveStars (benchmark::State& state, const std::vector<PolymorphicClass*>& pointers) {
+    bench::StateCounters counters (state, pointers.size ());
+    for (auto _ : state) {
+        std::int64_t five_stars = 0;
+        for (PolymorphicClass* object : pointers) {
+            five_stars += object->isFiveStar ();
+        }
+        benchmark::DoNotOptimize (five_stars);
+    }
+    state.SetItemsProcessed (state.iterations () * static_cast<std::int64_t> (pointers.size ()));
+}
+
+static void typeOrder (benchmark::State& state) {
+    const Objects objects (static_cast<std::size_t> (state.range (0)), static_cast<Order> (state.range (1)));
+    countFiveStars (state, objects.pointers);
+}
+
+static void memoryOrder (benchmark::State& state) {
+    Objects objects (static_cast<std::size_t> (state.range (0)), ORDER_SHUFFLED);
+    if (state.range (1) == ORDER_SHUFFLED) {
+        std::mt19937_64 generator (DISPATCH_COUNTERS_SEED + 1);
+        std::shuffle (objects.pointers.begin (), objects.pointers.end (), generator);
+    }
+    countFiveStars (state, objects.pointers);
+}
+
+BENCHMARK (typeOrder)
+->ArgNames ({ "objects", "shuffled" })
+->ArgsProduct ({ { DISPATCH_COUNTERS_SMALL, DISPATCH_COUNTERS_LARGE }, { ORDER_SORTED, ORDER_SHUFFLED } });
+BENCHMARK (memoryOrder)
+->ArgNames ({ "objects", "shuffled" })
+->ArgsProduct ({ { DISPATCH_COUNTERS_SMALL, DISPATCH_COUNTERS_LARGE }, { ORDER_SORTED, ORDER_SHUFFLED } });
+
+SANDBOX_BENCHMARK_MAIN ();
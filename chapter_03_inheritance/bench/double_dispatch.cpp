@@ -0,0 +1,220 @@
+/*====# DOUBLE DISPATCH BENCHMARK #====*/
+/*
+
+Resolves pairs of objects out of a hierarchy of four final shapes to the
+handler for their two dynamic types, all 16 pairs have their own handler:
+
+* table         - DoubleDispatcher, two id calls and one indexed load
+* visitor       - left.meet (right) calls right.meetWith (left as Circle&),
+                  two indirect calls
+* dynamic_cast  - a chain of casts for the left object, then for the right
+                  one (4 + 4 tries in the worst case)
+
+Every strategy ends in the same inlined handler, so what differs is only the
+dispatch. Run once over random pairs (no target can be predicted) and once
+over the same pair every time.
+
+Usage: Chapter_03_bench_double_dispatch [pair count, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bench_util.h"
+#include "double_dispatch.h"
+
+/*==# DEFINES #==*/
+
+#define DISPATCH_BENCH_DEFAULT_COUNT 10000000
+#define DISPATCH_BENCH_OBJECTS 4096
+#define DISPATCH_BENCH_SEED 0x5eed
+
+/*==# CLASSES #==*/
+
+class Circle;
+class Square;
+class Triangle;
+class Hexagon;
+
+class Shape {
+    public:
+    DISPATCH_ROOT (Shape)
+
+    int size = 0;
+
+    virtual ~Shape () = default;
+
+    // Visitor pattern
+    virtual int meet (Shape& other)          = 0;
+    virtual int meetWith (Circle& left)      = 0;
+    virtual int meetWith (Square& left)      = 0;
+    virtual int meetWith (Triangle& left)    = 0;
+    virtual int meetWith (Hexagon& left)     = 0;
+};
+
+// The one handler per pair, shared by every strategy.
+template <typename Left, typename Right> inline int collide (Left& left, Right& right) {
+    return left.size * 4 - right.size + Left::KIND * 4 + Right::KIND;
+}
+
+template <typename Self, int Kind> class ShapeKind : public Shape {
+    public:
+    DISPATCH_TYPE (Self, Shape)
+
+    static constexpr int KIND = Kind;
+
+    int meet (Shape& other) override {
+        return other.meetWith (static_cast<Self&> (*this));
+    }
+    int meetWith (Circle& left) override {
+        return collide (left, static_cast<Self&> (*this));
+    }
+    int meetWith (Square& left) override {
+        return collide (left, static_cast<Self&> (*this));
+    }
+    int meetWith (Triangle& left) override {
+        return collide (left, static_cast<Self&> (*this));
+    }
+    int meetWith (Hexagon& left) override {
+        return collide (left, static_cast<Self&> (*this));
+    }
+};
+
+class Circle final : public ShapeKind<Circle, 0> {};
+class Square final : public ShapeKind<Square, 1> {};
+class Triangle final : public ShapeKind<Triangle, 2> {};
+class Hexagon final : public ShapeKind<Hexagon, 3> {};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// 1. TABLE //
+
+template <typename Left, typename Right>
+static void addPair (DoubleDispatcher<Shape, int>& dispatcher) {
+    dispatcher.add<Left, Right> ([] (Left& left, Right& right) { return collide (left, right); }, false);
+}
+
+template <typename Left> static void addRow (DoubleDispatcher<Shape, int>& dispatcher) {
+    addPair<Left, Circle> (dispatcher);
+    addPair<Left, Square> (dispatcher);
+    addPair<Left, Triangle> (dispatcher);
+    addPair<Left, Hexagon> (dispatcher);
+}
+
+// 2. DYNAMIC_CAST CHAIN //
+
+template <typename Left> static int castRight (Left& left, Shape& right) {
+    if (Circle* circle = dynamic_cast<Circle*> (&right)) {
+        return collide (left, *circle);
+    }
+    if (Square* square = dynamic_cast<Square*> (&right)) {
+        return collide (left, *square);
+    }
+    if (Triangle* triangle = dynamic_cast<Triangle*> (&right)) {
+        return collide (left, *triangle);
+    }
+    return collide (left, dynamic_cast<Hexagon&> (right));
+}
+
+static int castChain (Shape& left, Shape& right) {
+    if (Circle* circle = dynamic_cast<Circle*> (&left)) {
+        return castRight (*circle, right);
+    }
+    if (Square* square = dynamic_cast<Square*> (&left)) {
+        return castRight (*square, right);
+    }
+    if (Triangle* triangle = dynamic_cast<Triangle*> (&left)) {
+        return castRight (*triangle, right);
+    }
+    return castRight (dynamic_cast<Hexagon&> (left), right);
+}
+
+// 3. DRIVER //
+
+struct Pair {
+    std::uint32_t left;
+    std::uint32_t right;
+};
+
+template <typename Dispatch>
+static std::int64_t dispatchAll (const std::vector<Shape*>& objects, const std::vector<Pair>& pairs,
+Dispatch dispatch) {
+    std::int64_t sum = 0;
+    for (const Pair& pair : pairs) {
+        sum += dispatch (*objects[pair.left], *objects[pair.right]);
+    }
+    return sum;
+}
+
+static void runPairs (const char* title, const std::vector<Shape*>& objects,
+const std::vector<Pair>& pairs, DoubleDispatcher<Shape, int>& table) {
+    bench::printHeader (title);
+
+    std::int64_t expected = dispatchAll (objects, pairs, castChain);
+    auto check            = [expected] (std::int64_t sum) {
+        if (sum != expected) {
+            std::printf ("checksum mismatch!\n");
+        }
+    };
+
+    bench::printResult (bench::measure ("table", pairs.size (), [&] () {
+        check (dispatchAll (objects, pairs, [&table] (Shape& left, Shape& right) {
+            return table (left, right);
+        }));
+    }));
+    bench::printResult (bench::measure ("visitor", pairs.size (), [&] () {
+        check (dispatchAll (objects, pairs, [] (Shape& left, Shape& right) {
+            return left.meet (right);
+        }));
+    }));
+    bench::printResult (bench::measure ("dynamic_cast chain", pairs.size (), [&] () {
+        check (dispatchAll (objects, pairs, castChain));
+    }));
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, DISPATCH_BENCH_DEFAULT_COUNT);
+
+    std::printf ("Double dispatch benchmark, %zu pairs out of %d objects of 4 types\n", count,
+    DISPATCH_BENCH_OBJECTS);
+
+    std::mt19937_64 generator (DISPATCH_BENCH_SEED);
+    std::vector<std::unique_ptr<Shape>> owned;
+    std::vector<Shape*> objects;
+    for (std::size_t i = 0; i < DISPATCH_BENCH_OBJECTS; ++i) {
+        switch (generator () % 4) {
+        case 0: owned.push_back (std::make_unique<Circle> ()); break;
+        case 1: owned.push_back (std::make_unique<Square> ()); break;
+        case 2: owned.push_back (std::make_unique<Triangle> ()); break;
+        default: owned.push_back (std::make_unique<Hexagon> ()); break;
+        }
+        owned.back ()->size = static_cast<int> (i % 100);
+        objects.push_back (owned.back ().get ());
+    }
+
+    DoubleDispatcher<Shape, int> table ([] (Shape&, Shape&) { return 0; });
+    addRow<Circle> (table);
+    addRow<Square> (table);
+    addRow<Triangle> (table);
+    addRow<Hexagon> (table);
+
+    std::vector<Pair> pairs (count);
+    for (Pair& pair : pairs) {
+        pair.left  = static_cast<std::uint32_t> (generator () % DISPATCH_BENCH_OBJECTS);
+        pair.right = static_cast<std::uint32_t> (generator () % DISPATCH_BENCH_OBJECTS);
+    }
+    runPairs ("RANDOM PAIRS", objects, pairs, table);
+
+    // The first two objects over and over, every branch predicts.
+    for (Pair& pair : pairs) {
+        pair = Pair{ 0, 1 };
+    }
+    runPairs ("ONE PAIR", objects, pairs, table);
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,254 @@
+/*====# FLAT FORMAT BENCHMARK #====*/
+/*
+
+N objects of the chapter (ConcreteClass, PolymorphicClass, OverridingClass,
+ParentSlicerClass, ClassToBeSliced in a random mix, the slicer fields
+random) written and read back two ways:
+
+* iostream - the naive text serializer: "tag field field ...\n" with an
+             ostringstream, read with an istringstream into new objects
+             (unique_ptr for the polymorphic ones, so they keep their type)
+* flat     - FlatBuilder / FlatReader (flat_format.h)
+
+"read + use" counts the five star objects and sums ClassToBeSliced::c, from
+the decoded objects for iostream, straight from the buffer for flat: once
+through visit () (a real object of the exact type on the stack) and once
+through FlatView field access.
+
+Usage: Chapter_03_bench_flat_format [object count, default 5M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "bench_util.h"
+#include "flat_format.h"
+#include "sliced_columns.h"
+
+/*==# DEFINES #==*/
+
+#define FLAT_BENCH_DEFAULT_COUNT 5000000
+#define FLAT_BENCH_SEED 0x5eed
+
+/*==# CLASSES #==*/
+
+// The objects to write, by type, and the order to write them in.
+struct Population {
+    std::vector<ConcreteClass> concretes;
+    std::vector<PolymorphicClass> polymorphics;
+    std::vector<OverridingClass> overridings;
+    std::vector<ParentSlicerClass> parents;
+    std::vector<ClassToBeSliced> sliced;
+    std::vector<std::pair<flat::Tag, std::uint32_t>> order;
+};
+
+// What the iostream reader builds.
+struct Decoded {
+    std::vector<ConcreteClass> concretes;
+    std::vector<std::unique_ptr<PolymorphicClass>> polymorphics;
+    std::vector<ParentSlicerClass> parents;
+    std::vector<ClassToBeSliced> sliced;
+};
+
+struct Answer {
+    std::size_t five_stars = 0;
+    std::int64_t sum_c     = 0;
+
+    bool operator== (const Answer&) const = default;
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static Population makePopulation (std::size_t count) {
+    Population population;
+    std::mt19937 generator (FLAT_BENCH_SEED);
+    std::uniform_int_distribution<int> type (flat::TAG_CONCRETE, flat::TAG_CLASS_TO_BE_SLICED);
+    std::uniform_int_distribution<int> value (-1000, 1000);
+    for (std::size_t i = 0; i < count; ++i) {
+        const flat::Tag tag = static_cast<flat::Tag> (type (generator));
+        std::uint32_t index = 0;
+        switch (tag) {
+        case flat::TAG_CONCRETE:
+            index = static_cast<std::uint32_t> (population.concretes.size ());
+            population.concretes.emplace_back ();
+            break;
+        case flat::TAG_POLYMORPHIC:
+            index = static_cast<std::uint32_t> (population.polymorphics.size ());
+            population.polymorphics.emplace_back ();
+            break;
+        case flat::TAG_OVERRIDING:
+            index = static_cast<std::uint32_t> (population.overridings.size ());
+            population.overridings.emplace_back ();
+            break;
+        case flat::TAG_PARENT_SLICER: {
+            index = static_cast<std::uint32_t> (population.parents.size ());
+            ParentSlicerClass& parent = population.parents.emplace_back ();
+            for (int ParentSlicerClass::*field : ColumnLayout<ParentSlicerClass>::fields) {
+                parent.*field = value (generator);
+            }
+            break;
+        }
+        default: {
+            index = static_cast<std::uint32_t> (population.sliced.size ());
+            ClassToBeSliced& sliced = population.sliced.emplace_back ();
+            for (int ClassToBeSliced::*field : ColumnLayout<ClassToBeSliced>::fields) {
+                sliced.*field = value (generator);
+            }
+            break;
+        }
+        }
+        population.order.emplace_back (tag, index);
+    }
+    return population;
+}
+
+// The right add () per object, the polymorphic ones through their base.
+template <typename Write> static void forEachObject (const Population& population, Write&& write) {
+    for (const auto& [tag, index] : population.order) {
+        switch (tag) {
+        case flat::TAG_CONCRETE: write (flat::TAG_CONCRETE, population.concretes[index]); break;
+        case flat::TAG_POLYMORPHIC:
+            write (flat::TAG_POLYMORPHIC, static_cast<const PolymorphicClass&> (population.polymorphics[index]));
+            break;
+        case flat::TAG_OVERRIDING:
+            write (flat::TAG_OVERRIDING, static_cast<const PolymorphicClass&> (population.overridings[index]));
+            break;
+        case flat::TAG_PARENT_SLICER: write (flat::TAG_PARENT_SLICER, population.parents[index]); break;
+        default: write (flat::TAG_CLASS_TO_BE_SLICED, population.sliced[index]); break;
+        }
+    }
+}
+
+// IOSTREAM //
+
+static std::string encodeStream (const Population& population) {
+    std::ostringstream out;
+    forEachObject (population, [&] (flat::Tag tag, const auto& object) {
+        using T = std::decay_t<decltype (object)>;
+        out << static_cast<int> (tag);
+        if constexpr (flat::fieldCount<T> () > 0) {
+            for (std::size_t field = 0; field < flat::fieldCount<T> (); ++field) {
+                out << ' ' << object.*ColumnLayout<T>::fields[field];
+            }
+        }
+        out << '\n';
+    });
+    return out.str ();
+}
+
+template <typename T> static void readFields (std::istream& in, T& object) {
+    for (std::size_t field = 0; field < flat::fieldCount<T> (); ++field) {
+        in >> object.*ColumnLayout<T>::fields[field];
+    }
+}
+
+static Decoded decodeStream (const std::string& text) {
+    Decoded decoded;
+    std::istringstream in (text);
+    int tag = 0;
+    while (in >> tag) {
+        switch (tag) {
+        case flat::TAG_CONCRETE: decoded.concretes.emplace_back (); break;
+        case flat::TAG_POLYMORPHIC: decoded.polymorphics.push_back (std::make_unique<PolymorphicClass> ()); break;
+        case flat::TAG_OVERRIDING: decoded.polymorphics.push_back (std::make_unique<OverridingClass> ()); break;
+        case flat::TAG_PARENT_SLICER: readFields (in, decoded.parents.emplace_back ()); break;
+        default: readFields (in, decoded.sliced.emplace_back ()); break;
+        }
+    }
+    return decoded;
+}
+
+static Answer useDecoded (Decoded& decoded) {
+    Answer answer;
+    for (std::unique_ptr<PolymorphicClass>& object : decoded.polymorphics) {
+        answer.five_stars += object->isFiveStar ();
+    }
+    for (const ClassToBeSliced& object : decoded.sliced) {
+        answer.sum_c += object.c;
+    }
+    return answer;
+}
+
+// FLAT //
+
+static Answer useVisit (const FlatReader& reader) {
+    Answer answer;
+    for (std::size_t i = 0; i < reader.size (); ++i) {
+        reader.visit (i, [&] (auto& object) {
+            using T = std::decay_t<decltype (object)>;
+            if constexpr (std::is_base_of_v<PolymorphicClass, T>) {
+                answer.five_stars += object.isFiveStar ();
+            } else if constexpr (std::is_same_v<T, ClassToBeSliced>) {
+                answer.sum_c += object.c;
+            }
+        });
+    }
+    return answer;
+}
+
+static Answer useViews (const FlatReader& reader) {
+    Answer answer;
+    for (std::size_t i = 0; i < reader.size (); ++i) {
+        const flat::Tag tag = reader.tag (i);
+        if (tag == flat::TAG_POLYMORPHIC) { // no fields, the view only gives the exact type
+            answer.five_stars += reader.get<PolymorphicClass> (i).materialize ().isFiveStar ();
+        } else if (tag == flat::TAG_OVERRIDING) {
+            answer.five_stars += reader.get<OverridingClass> (i).materialize ().isFiveStar ();
+        } else if (tag == flat::TAG_CLASS_TO_BE_SLICED) {
+            answer.sum_c += reader.get<ClassToBeSliced> (i).field (SLICED_C);
+        }
+    }
+    return answer;
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, FLAT_BENCH_DEFAULT_COUNT);
+
+    std::printf ("Flat format benchmark, %zu objects of 5 types\n", count);
+    const Population population = makePopulation (count);
+
+    std::string text;
+    std::vector<std::byte> buffer;
+    FlatBuilder builder;
+
+    bench::printHeader ("ENCODE");
+    bench::printResult (bench::measure ("iostream", count, [&] () { text = encodeStream (population); }));
+    bench::printResult (bench::measure ("flat", count, [&] () {
+        builder.clear ();
+        forEachObject (population, [&] (flat::Tag, const auto& object) { builder.add (object); });
+        buffer = builder.finish ();
+    }));
+    std::printf ("%-32s %13.1f B/object iostream, %.1f B/object flat\n", "",
+    static_cast<double> (text.size ()) / static_cast<double> (count),
+    static_cast<double> (buffer.size ()) / static_cast<double> (count));
+
+    bench::printHeader ("READ + USE");
+    Answer expected, answer;
+    bench::printResult (bench::measure ("iostream decode + use", count, [&] () {
+        Decoded decoded = decodeStream (text);
+        expected        = useDecoded (decoded);
+    }));
+    bool verified = false;
+    bench::printResult (bench::measure ("flat open + verify", count, [&] () {
+        verified = FlatReader (buffer).verify ();
+    }));
+    const FlatReader reader (buffer);
+    bench::printResult (bench::measure ("flat visit", count, [&] () { answer = useVisit (reader); }));
+    if (!verified || !(answer == expected)) {
+        std::printf ("visit mismatch!\n");
+    }
+    bench::printResult (bench::measure ("flat views", count, [&] () { answer = useViews (reader); }));
+    if (!(answer == expected)) {
+        std::printf ("views mismatch!\n");
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*====# INTRUSIVE CONTAINER BENCHMARK #====*/
+/*
+
+N polymorphic objects (a virtual destructor, an int key) live in one
+std::vector. They are put into:
+
+* std::list<Item*>            vs IntrusiveList (safe unlink hooks)
+* std::multiset<Item*, ByKey> vs IntrusiveSet  (safe unlink hooks)
+
+and we time insert all, erase every other one, scan all and, for the sets,
+find every key. std::list and std::multiset erase through the iterator
+insert returned (kept next to the objects), so neither side searches.
+
+Usage: Chapter_03_bench_intrusive [object count, default 1M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <list>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "bench_util.h"
+#include "intrusive.h"
+
+/*==# DEFINES #==*/
+
+#define INTRUSIVE_BENCH_DEFAULT_COUNT 1000000
+#define INTRUSIVE_BENCH_SEED 0x5eed
+
+/*==# CLASSES #==*/
+
+class Item : public ListHook<HOOK_SAFE_UNLINK>, public TreeHook<HOOK_SAFE_UNLINK> {
+    public:
+    int key = 0;
+
+    virtual ~Item () = default;
+};
+
+struct KeyOfItem {
+    int operator() (const Item& item) const {
+        return item.key;
+    }
+};
+
+struct ByKey {
+    bool operator() (const Item* left, const Item* right) const {
+        return left->key < right->key;
+    }
+};
+
+using ItemList = IntrusiveList<Item, ListHook<HOOK_SAFE_UNLINK>>;
+using ItemSet  = IntrusiveSet<Item, KeyOfItem, TreeHook<HOOK_SAFE_UNLINK>>;
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static void runLists (std::vector<Item>& items) {
+    const std::size_t count = items.size ();
+    bench::printHeader ("LIST");
+
+    std::int64_t std_sum = 0, intrusive_sum = 0;
+    {
+        std::list<Item*> list;
+        std::vector<std::list<Item*>::iterator> positions (count);
+        bench::printResult (bench::measure ("std::list      insert", count, [&] () {
+            for (std::size_t i = 0; i < count; ++i) {
+                positions[i] = list.insert (list.end (), &items[i]);
+            }
+        }));
+        bench::printResult (bench::measure ("std::list      erase half", count / 2, [&] () {
+            for (std::size_t i = 0; i < count; i += 2) {
+                list.erase (positions[i]);
+            }
+        }));
+        bench::printResult (bench::measure ("std::list      scan", list.size (), [&] () {
+            for (Item* item : list) {
+                std_sum += item->key;
+            }
+        }));
+    }
+    {
+        ItemList list;
+        bench::printResult (bench::measure ("IntrusiveList  insert", count, [&] () {
+            for (Item& item : items) {
+                list.push_back (item);
+            }
+        }));
+        bench::printResult (bench::measure ("IntrusiveList  erase half", count / 2, [&] () {
+            for (std::size_t i = 0; i < count; i += 2) {
+                list.erase (items[i]);
+            }
+        }));
+        bench::printResult (bench::measure ("IntrusiveList  scan", count - count / 2, [&] () {
+            for (Item& item : list) {
+                intrusive_sum += item.key;
+            }
+        }));
+        list.clear ();
+    }
+    if (std_sum != intrusive_sum) {
+        std::printf ("list checksum mismatch!\n");
+    }
+}
+
+static void runSets (std::vector<Item>& items) {
+    const std::size_t count = items.size ();
+    bench::printHeader ("ORDERED SET");
+
+    std::int64_t std_sum = 0, intrusive_sum = 0;
+    std::size_t std_found = 0, intrusive_found = 0;
+    {
+        std::multiset<Item*, ByKey> set;
+        std::vector<std::multiset<Item*, ByKey>::iterator> positions (count);
+        bench::printResult (bench::measure ("std::multiset  insert", count, [&] () {
+            for (std::size_t i = 0; i < count; ++i) {
+                positions[i] = set.insert (&items[i]);
+            }
+        }));
+        Item probe;
+        bench::printResult (bench::measure ("std::multiset  find", count, [&] () {
+            for (const Item& item : items) {
+                probe.key = item.key;
+                std_found += set.find (&probe) != set.end ();
+            }
+        }));
+        bench::printResult (bench::measure ("std::multiset  erase half", count / 2, [&] () {
+            for (std::size_t i = 0; i < count; i += 2) {
+                set.erase (positions[i]);
+            }
+        }));
+        bench::printResult (bench::measure ("std::multiset  scan", set.size (), [&] () {
+            for (Item* item : set) {
+                std_sum += item->key;
+            }
+        }));
+    }
+    {
+        ItemSet set;
+        bench::printResult (bench::measure ("IntrusiveSet   insert", count, [&] () {
+            for (Item& item : items) {
+                set.insert (item);
+            }
+        }));
+        bench::printResult (bench::measure ("IntrusiveSet   find", count, [&] () {
+            for (const Item& item : items) {
+                intrusive_found += set.find (item.key) != set.end ();
+            }
+        }));
+        bench::printResult (bench::measure ("IntrusiveSet   erase half", count / 2, [&] () {
+            for (std::size_t i = 0; i < count; i += 2) {
+                set.erase (items[i]);
+            }
+        }));
+        bench::printResult (bench::measure ("IntrusiveSet   scan", count - count / 2, [&] () {
+            for (Item& item : set) {
+                intrusive_sum += item.key;
+            }
+        }));
+        set.clear ();
+    }
+    if (std_sum != intrusive_sum || std_found != intrusive_found) {
+        std::printf ("set checksum mismatch!\n");
+    }
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, INTRUSIVE_BENCH_DEFAULT_COUNT);
+
+    std::printf ("Intrusive container benchmark, %zu objects\n", count);
+
+    std::vector<Item> items (count);
+    std::mt19937_64 generator (INTRUSIVE_BENCH_SEED);
+    for (Item& item : items) {
+        item.key = static_cast<int> (generator () % (count * 4));
+    }
+
+    runLists (items);
+    runSets (items);
+
+    /*==# THE END #==*/
+    return 0;
+}
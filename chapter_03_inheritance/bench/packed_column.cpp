@@ -0,0 +1,106 @@
+/*====# PACKED COLUMN BENCHMARK #====*/
+/*
+
+Frame of reference + bit packing (packed_column.h) on the columns of
+ClassToBeSliced. Every column holds its default value (4, 10, 8, 20, 15,
+21) plus 0..NOISE-1, the "small ranges" the data really has.
+
+* compression ratio of all six columns
+* sum and max over the c column: plain column (AVX2 kernels of
+  column_table.h), packed with AVX2 unpack, packed with scalar unpack
+* decoding the packed column back into a plain one
+
+GB/s counts the uncompressed bytes (4 per value), so the numbers compare
+directly: the packed scan wins when decoding is cheaper than reading the
+bytes it saves.
+
+Usage: Chapter_03_bench_packed_column [row count, default 100M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <vector>
+
+#include "bench_util.h"
+#include "packed_column.h"
+#include "sliced_columns.h"
+
+/*==# DEFINES #==*/
+
+#define PACKED_BENCH_DEFAULT_COUNT 100000000
+#define PACKED_BENCH_NOISE 16
+#define PACKED_BENCH_SEED 0x5eed
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static std::vector<int> makeColumn (std::size_t field, std::size_t count) {
+    const ClassToBeSliced defaults;
+    const int base      = defaults.*ColumnLayout<ClassToBeSliced>::fields[field];
+    std::uint64_t state = PACKED_BENCH_SEED + field;
+    std::vector<int> column (count);
+    for (int& value : column) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        value = base + static_cast<int> (state % PACKED_BENCH_NOISE);
+    }
+    return column;
+}
+
+static void printRate (const bench::Result& result) {
+    bench::printResult (result);
+    std::printf ("%-32s %13.2f GB/s\n", "", result.nsPerOp () > 0 ? sizeof (int) / result.nsPerOp () : 0.0);
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, PACKED_BENCH_DEFAULT_COUNT);
+
+    std::printf ("Packed column benchmark, %zu ClassToBeSliced rows, values default + 0..%d\n",
+    count, PACKED_BENCH_NOISE - 1);
+
+    std::printf ("\n## COMPRESSION ##\n");
+    for (std::size_t field = 0; field < ColumnTable<ClassToBeSliced>::COLUMN_COUNT; ++field) {
+        PackedColumn packed (makeColumn (field, count));
+        std::printf ("%-24s %10.1f MB -> %8.1f MB, ratio %5.2f\n", ColumnTable<ClassToBeSliced>::name (field),
+        static_cast<double> (count * sizeof (int)) / 1e6,
+        static_cast<double> (packed.packedBytes ()) / 1e6, packed.compressionRatio ());
+    }
+
+    const std::vector<int> column = makeColumn (SLICED_C, count);
+    const PackedColumn packed (column);
+    const std::int64_t expected_sum = columns::sumScalar (column);
+    const int expected_max          = columns::maxScalar (column);
+    std::int64_t sum = 0;
+    int max          = 0;
+    auto check       = [&] () {
+        if (sum != expected_sum || max != expected_max) {
+            std::printf ("result mismatch!\n");
+        }
+    };
+
+    bench::printHeader ("SUM AND MAX OF c");
+    printRate (bench::measure ("plain column  sum", count, [&] () { sum = columns::sum (column); }));
+    printRate (bench::measure ("plain column  max", count, [&] () { max = columns::max (column); }));
+    check ();
+    printRate (bench::measure ("packed        sum", count, [&] () { sum = packed.sum (); }));
+    printRate (bench::measure ("packed        max", count, [&] () { max = packed.max (); }));
+    check ();
+    printRate (bench::measure ("packed scalar sum", count, [&] () { sum = packed.sumScalar (); }));
+    printRate (bench::measure ("packed scalar max", count, [&] () { max = packed.maxScalar (); }));
+    check ();
+    if (packed.min () != columns::minScalar (column)) {
+        std::printf ("min mismatch!\n");
+    }
+
+    bench::printHeader ("DECODE");
+    std::vector<int> decoded (count);
+    packed.decode (decoded); // first touch
+    printRate (bench::measure ("packed -> plain", count, [&] () { packed.decode (decoded); }));
+    if (decoded != column) {
+        std::printf ("decode mismatch!\n");
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
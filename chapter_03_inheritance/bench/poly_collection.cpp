@@ -0,0 +1,111 @@
+/*====# POLYMORPHIC COLLECTION BENCHMARK #====*/
+/*
+
+Counts the five star objects in a 50/50 shuffled mix of PolymorphicClass and
+OverridingClass, stored three ways:
+
+* pointer vector  - std::vector<PolymorphicClass*>, every object from new
+* buckets, Base&  - PolyCollection visited through the base class,
+                    still a virtual call, but the target only changes once
+* buckets, exact  - PolyCollection with both types restituted, the calls are
+                    resolved at compile time and each bucket is one tight loop.
+                    isFiveStar returns a constant, so every object goes
+                    through doNotOptimize: without it the loop folds away and
+                    the time measures nothing.
+
+Usage: Chapter_03_bench_poly_collection [object count, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "bench_util.h"
+#include "inheritance.h"
+#include "poly_collection.h"
+
+/*==# DEFINES #==*/
+
+#define POLY_DEFAULT_COUNT 10000000
+#define POLY_SEED 0x5eed
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static std::vector<bool> makeMix (std::size_t count) {
+    std::vector<bool> overriding (count);
+    for (std::size_t i = 0; i < count; ++i) {
+        overriding[i] = (i % 2) == 1;
+    }
+    std::mt19937_64 generator (POLY_SEED);
+    std::shuffle (overriding.begin (), overriding.end (), generator);
+    return overriding;
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, POLY_DEFAULT_COUNT);
+    const std::vector<bool> mix = makeMix (count);
+
+    std::printf ("Polymorphic collection benchmark, %zu objects, shuffled 50/50 mix\n", count);
+    bench::printHeader ("isFiveStar OVER ALL OBJECTS");
+
+    {
+        std::vector<std::unique_ptr<PolymorphicClass>> owners;
+        std::vector<PolymorphicClass*> objects;
+        owners.reserve (count);
+        objects.reserve (count);
+        for (bool overriding : mix) {
+            if (overriding) {
+                owners.push_back (std::make_unique<OverridingClass> ());
+            } else {
+                owners.push_back (std::make_unique<PolymorphicClass> ());
+            }
+            objects.push_back (owners.back ().get ());
+        }
+
+        bench::printResult (bench::measure ("pointer vector", count, [&] () {
+            std::int64_t five_stars = 0;
+            for (PolymorphicClass* object : objects) {
+                five_stars += object->isFiveStar ();
+            }
+            bench::doNotOptimize (five_stars);
+        }));
+    }
+
+    {
+        PolyCollection<PolymorphicClass> collection;
+        for (bool overriding : mix) {
+            if (overriding) {
+                collection.emplace<OverridingClass> ();
+            } else {
+                collection.emplace<PolymorphicClass> ();
+            }
+        }
+
+        bench::printResult (bench::measure ("buckets, Base&", count, [&] () {
+            std::int64_t five_stars = 0;
+            collection.forEach ([&five_stars] (PolymorphicClass& object) {
+                five_stars += object.isFiveStar ();
+            });
+            bench::doNotOptimize (five_stars);
+        }));
+
+        bench::printResult (bench::measure ("buckets, exact types", count, [&] () {
+            std::int64_t five_stars = 0;
+            collection.forEach<PolymorphicClass, OverridingClass> ([&five_stars] (auto& object) {
+                // Both types are restituted, so the qualified call is exact.
+                using Exact = std::remove_reference_t<decltype (object)>;
+                bench::doNotOptimize (object);
+                five_stars += object.Exact::isFiveStar ();
+            });
+            bench::doNotOptimize (five_stars);
+        }));
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
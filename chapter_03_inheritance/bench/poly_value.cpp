@@ -0,0 +1,147 @@
+/*====# POLYMORPHIC VALUE BENCHMARK #====*/
+/*
+
+std::vector<PolyValue<AbstractInterface>> against
+std::vector<std::unique_ptr<AbstractInterface>> for a shuffled mix of two
+implementers, once with small implementers (stored inline by PolyValue) and
+once with large ones (heap fallback, so only the dispatch differs).
+
+For every layout we time building the vector, calling returnNumber and
+returnChar on every element, deep copying the vector (PolyValue only, a
+unique_ptr cannot be copied without a clone function) and destroying it.
+
+Usage: Chapter_03_bench_poly_value [object count, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bench_util.h"
+#include "inheritance.h"
+#include "poly_value.h"
+
+/*==# DEFINES #==*/
+
+#define POLYVALUE_BENCH_DEFAULT_COUNT 10000000
+#define POLYVALUE_BENCH_SEED 0x5eed
+#define POLYVALUE_BENCH_LARGE_PAYLOAD 16
+
+/*==# CLASSES #==*/
+
+class SmallConcreteClass final : public AbstractInterface {
+    public:
+    int number = 16;
+
+    char returnChar () override {
+        return 'f';
+    }
+    int returnNumber () override {
+        return number;
+    }
+};
+
+class LargeConcreteClass final : public AbstractInterface {
+    public:
+    int payload[POLYVALUE_BENCH_LARGE_PAYLOAD] = { 17 };
+
+    char returnChar () override {
+        return 'g';
+    }
+    int returnNumber () override {
+        return payload[0];
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+static std::vector<bool> makeMix (std::size_t count) {
+    std::vector<bool> second (count);
+    for (std::size_t i = 0; i < count; ++i) {
+        second[i] = (i % 2) == 1;
+    }
+    std::mt19937_64 generator (POLYVALUE_BENCH_SEED);
+    std::shuffle (second.begin (), second.end (), generator);
+    return second;
+}
+
+template <typename First, typename Second>
+static void runUniquePtr (const char* label, const std::vector<bool>& mix) {
+    const std::size_t count = mix.size ();
+    std::vector<std::unique_ptr<AbstractInterface>> objects;
+
+    bench::printResult (bench::measure (std::string ("unique_ptr  build   ") + label, count, [&] () {
+        objects.reserve (count);
+        for (bool second : mix) {
+            if (second) {
+                objects.push_back (std::make_unique<Second> ());
+            } else {
+                objects.push_back (std::make_unique<First> ());
+            }
+        }
+    }));
+    bench::printResult (bench::measure (std::string ("unique_ptr  call    ") + label, count * 2, [&] () {
+        std::int64_t sum = 0;
+        for (auto& object : objects) {
+            sum += object->returnNumber () + object->returnChar ();
+        }
+        bench::doNotOptimize (sum);
+    }));
+    bench::printResult (bench::measure (std::string ("unique_ptr  destroy ") + label, count, [&] () {
+        objects = std::vector<std::unique_ptr<AbstractInterface>> ();
+    }));
+}
+
+template <typename First, typename Second>
+static void runPolyValue (const char* label, const std::vector<bool>& mix) {
+    const std::size_t count = mix.size ();
+    std::vector<PolyValue<AbstractInterface>> objects;
+
+    bench::printResult (bench::measure (std::string ("PolyValue   build   ") + label, count, [&] () {
+        objects.reserve (count);
+        for (bool second : mix) {
+            if (second) {
+                objects.emplace_back (Second ());
+            } else {
+                objects.emplace_back (First ());
+            }
+        }
+    }));
+    bench::printResult (bench::measure (std::string ("PolyValue   call    ") + label, count * 2, [&] () {
+        std::int64_t sum = 0;
+        for (auto& object : objects) {
+            sum += object.returnNumber () + object.returnChar ();
+        }
+        bench::doNotOptimize (sum);
+    }));
+    bench::printResult (bench::measure (std::string ("PolyValue   copy    ") + label, count, [&] () {
+        std::vector<PolyValue<AbstractInterface>> copy (objects);
+        bench::doNotOptimize (copy.data ());
+    }));
+    bench::printResult (bench::measure (std::string ("PolyValue   destroy ") + label, count, [&] () {
+        objects = std::vector<PolyValue<AbstractInterface>> ();
+    }));
+}
+
+int main (int argc, char** argv) {
+    const std::size_t count = bench::countFromArgs (argc, argv, POLYVALUE_BENCH_DEFAULT_COUNT);
+    const std::vector<bool> mix = makeMix (count);
+
+    std::printf ("PolyValue benchmark, %zu objects, shuffled 50/50 mix\n", count);
+    std::printf ("sizeof (PolyValue<AbstractInterface>) = %zu\n", sizeof (PolyValue<AbstractInterface>));
+
+    bench::printHeader ("SMALL IMPLEMENTERS (INLINE)");
+    runUniquePtr<ConcreteClass, SmallConcreteClass> ("small", mix);
+    runPolyValue<ConcreteClass, SmallConcreteClass> ("small", mix);
+
+    bench::printHeader ("LARGE IMPLEMENTERS (HEAP FALLBACK)");
+    runUniquePtr<ConcreteClass, LargeConcreteClass> ("large", mix);
+    runPolyValue<ConcreteClass, LargeConcreteClass> ("large", mix);
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*====# POOLED NEW BENCHMARK #====*/
+/*
+
+Multithreaded allocation churn on PolymorphicClass and OverridingClass, as
+the chapter builds them with CHAPTER_03_POOLED_NEW (this benchmark is always
+compiled with INHERITANCE_POOLED_NEW). Every thread keeps a window of live
+objects and keeps replacing random ones: delete the old object through the
+base pointer (virtual destructor, sized delete), new a base or a subclass in
+its place.
+
+The same loop runs twice on the same classes: `::new` / `::delete` use the
+global operator new, `new` / `delete` the class's POOLED_NEW_OPERATORS.
+
+ns/op is wall time divided by all new+delete pairs of all threads, so with
+perfect scaling it drops linearly with the thread count.
+
+Usage: Chapter_03_bench_pooled_new [replacements per thread, default 10M]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "inheritance.h"
+#include "pooled_new.h"
+
+/*==# DEFINES #==*/
+
+#define POOLED_BENCH_DEFAULT_COUNT 10000000
+#define POOLED_BENCH_WINDOW 4096
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// ::new and ::delete skip the class operators, the same objects from the global heap.
+template <bool Pooled> static PolymorphicClass* create (bool overriding) {
+    if constexpr (Pooled) {
+        return overriding ? new OverridingClass () : new PolymorphicClass ();
+    } else {
+        return overriding ? ::new OverridingClass () : ::new PolymorphicClass ();
+    }
+}
+
+template <bool Pooled> static void destroy (PolymorphicClass* object) {
+    if constexpr (Pooled) {
+        delete object;
+    } else {
+        ::delete object;
+    }
+}
+
+template <bool Pooled> static void churn (std::size_t replacements, std::uint64_t seed) {
+    std::vector<PolymorphicClass*> window (POOLED_BENCH_WINDOW);
+    for (PolymorphicClass*& slot : window) {
+        slot = create<Pooled> (false);
+    }
+    std::uint64_t state = seed;
+    for (std::size_t i = 0; i < replacements; ++i) {
+        // xorshift, cheap enough not to show up in the numbers
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        PolymorphicClass*& slot = window[state % POOLED_BENCH_WINDOW];
+        destroy<Pooled> (slot);
+        slot = create<Pooled> (state & 0x100);
+    }
+    for (PolymorphicClass* slot : window) {
+        destroy<Pooled> (slot);
+    }
+}
+
+template <bool Pooled>
+static void runThreads (const char* label, unsigned threads, std::size_t replacements) {
+    char name[64];
+    std::snprintf (name, sizeof (name), "%s, %u thread%s", label, threads, threads == 1 ? "" : "s");
+
+    bench::printResult (bench::measure (name, replacements * threads, [&] () {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back (churn<Pooled>, replacements, 0x9e3779b97f4a7c15ull + t);
+        }
+        for (std::thread& worker : workers) {
+            worker.join ();
+        }
+    }));
+}
+
+int main (int argc, char** argv) {
+    const std::size_t replacements = bench::countFromArgs (argc, argv, POOLED_BENCH_DEFAULT_COUNT);
+    const unsigned hardware = std::thread::hardware_concurrency ();
+
+    std::vector<unsigned> thread_counts;
+    for (unsigned threads = 1; threads < hardware; threads *= 2) {
+        thread_counts.push_back (threads);
+    }
+    thread_counts.push_back (hardware ? hardware : 1);
+
+    std::printf ("Pooled new benchmark, %zu replacements per thread, window of %d objects\n",
+    replacements, POOLED_BENCH_WINDOW);
+    std::printf ("sizeof (PolymorphicClass) = %zu, sizeof (OverridingClass) = %zu\n",
+    sizeof (PolymorphicClass), sizeof (OverridingClass));
+    bench::printHeader ("NEW + DELETE CHURN");
+
+    for (unsigned threads : thread_counts) {
+        runThreads<false> ("global new", threads, replacements);
+        runThreads<true> ("pooled new", threads, replacements);
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*====# WORK STEALING BENCHMARK #====*/
+/*
+
+WorkStealingPool (work_stealing.h) on 1, 2, 4, ... up to the hardware
+threads (at least 2), against the plain serial loop:
+
+* fib       - recursive fib (n) forking FibTask objects, a Task subclass,
+              below FIB_BENCH_CUTOFF the recursion runs serially
+* for       - parallelFor summing a vector of ints, callables boxed into
+              FunctionTask, chunks of PARALLEL_FOR_BENCH_GRAIN
+* mixed     - both at once: fib on one side of a join, the sum on the other,
+              so the deques hold tasks of different classes
+
+Speedup is serial time / pool time. On a machine with one hardware thread
+there is nothing to scale to, the numbers then show the scheduling overhead.
+
+Usage: Chapter_03_bench_work_stealing [fib n, default 32]
+
+*/
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "work_stealing.h"
+
+/*==# DEFINES #==*/
+
+#define FIB_BENCH_DEFAULT_N 32
+#define FIB_BENCH_CUTOFF 20
+#define PARALLEL_FOR_BENCH_COUNT (1u << 26)
+#define PARALLEL_FOR_BENCH_GRAIN (1u << 14)
+
+/*==# CLASSES #==*/
+
+static std::uint64_t fibSerial (unsigned n) {
+    return n < 2 ? n : fibSerial (n - 1) + fibSerial (n - 2);
+}
+
+class FibTask final : public Task {
+    private:
+    unsigned n;
+    std::uint64_t* result;
+
+    public:
+    FibTask (unsigned number, std::uint64_t* out) : n (number), result (out) {
+    }
+
+    void execute () override {
+        if (n < FIB_BENCH_CUTOFF) {
+            *result = fibSerial (n);
+            return;
+        }
+        std::uint64_t left = 0, right = 0;
+        WorkStealingPool::join (FibTask (n - 1, &left), FibTask (n - 2, &right));
+        *result = left + right;
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// Calls of the naive recursion, the unit of work of fib.
+static std::uint64_t fibCalls (unsigned n) {
+    std::uint64_t previous = 1, current = 1;
+    for (unsigned i = 1; i <= n; ++i) {
+        std::uint64_t next = previous + current + 1;
+        previous           = current;
+        current            = next;
+    }
+    return current;
+}
+
+static std::int64_t sumParallel (const std::vector<int>& values) {
+    std::vector<std::int64_t> partial ((values.size () + PARALLEL_FOR_BENCH_GRAIN - 1) / PARALLEL_FOR_BENCH_GRAIN);
+    WorkStealingPool::parallelFor (0, values.size (), PARALLEL_FOR_BENCH_GRAIN, [&] (std::size_t begin, std::size_t end) {
+        partial[begin / PARALLEL_FOR_BENCH_GRAIN] =
+        std::accumulate (values.begin () + static_cast<std::ptrdiff_t> (begin),
+        values.begin () + static_cast<std::ptrdiff_t> (end), std::int64_t{ 0 });
+    });
+    return std::accumulate (partial.begin (), partial.end (), std::int64_t{ 0 });
+}
+
+static void printSpeedup (const bench::Result& result, double serial) {
+    bench::printResult (result);
+    std::printf ("%-32s %13.2fx\n", "", result.nanoseconds > 0 ? serial / result.nanoseconds : 0.0);
+}
+
+int main (int argc, char** argv) {
+    const unsigned n       = static_cast<unsigned> (bench::countFromArgs (argc, argv, FIB_BENCH_DEFAULT_N));
+    const std::size_t most = std::max (2u, std::thread::hardware_concurrency ());
+    const std::uint64_t calls = fibCalls (n);
+
+    std::printf ("Work stealing benchmark, fib (%u), sum of %u ints, up to %zu threads (%u hardware)\n", n,
+    PARALLEL_FOR_BENCH_COUNT, most, std::thread::hardware_concurrency ());
+
+    std::vector<int> values (PARALLEL_FOR_BENCH_COUNT);
+    std::iota (values.begin (), values.end (), 0);
+    const std::uint64_t expected_fib = fibSerial (n);
+    const std::int64_t expected_sum  = std::accumulate (values.begin (), values.end (), std::int64_t{ 0 });
+
+    std::uint64_t fib = 0;
+    std::int64_t sum  = 0;
+    bench::printHeader ("SERIAL");
+    const bench::Result serial_fib = bench::measure ("fib serial", calls, [&] () { fib = fibSerial (n); });
+    const bench::Result serial_sum = bench::measure ("sum serial", values.size (), [&] () {
+        sum = std::accumulate (values.begin (), values.end (), std::int64_t{ 0 });
+    });
+    bench::printResult (serial_fib);
+    bench::printResult (serial_sum);
+    bench::doNotOptimize (fib);
+    bench::doNotOptimize (sum);
+
+    for (std::size_t threads = 1; threads <= most; threads *= 2) {
+        WorkStealingPool pool (threads);
+        const std::string title = std::to_string (threads) + (threads == 1 ? " THREAD" : " THREADS");
+        bench::printHeader (title.c_str ());
+
+        printSpeedup (bench::measure ("fib pool", calls, [&] () {
+            pool.run (FibTask (n, &fib));
+        }), serial_fib.nanoseconds);
+        if (fib != expected_fib) {
+            std::printf ("fib mismatch!\n");
+        }
+
+        printSpeedup (bench::measure ("sum parallelFor", values.size (), [&] () {
+            pool.run ([&] () { sum = sumParallel (values); });
+        }), serial_sum.nanoseconds);
+        if (sum != expected_sum) {
+            std::printf ("sum mismatch!\n");
+        }
+
+        printSpeedup (bench::measure ("mixed fib + sum", calls + values.size (), [&] () {
+            pool.run ([&] () {
+                WorkStealingPool::join (FibTask (n, &fib), [&] () { sum = sumParallel (values); });
+            });
+        }), serial_fib.nanoseconds + serial_sum.nanoseconds);
+        if (fib != expected_fib || sum != expected_sum) {
+            std::printf ("mixed mismatch!\n");
+        }
+        std::printf ("%-32s %14llu tasks, %llu stolen\n", "", static_cast<unsigned long long> (pool.executedTasks ()),
+        static_cast<unsigned long long> (pool.stolenTasks ()));
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
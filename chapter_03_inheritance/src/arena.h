@@ -0,0 +1,187 @@
+/*====# ARENA #====*/
+/*
+
+Scenario 2 creates every object with new and destroys it with delete.
+That is fine for two objects, but a request that builds a graph of a
+million VirtualDestructorClass objects pays for a million malloc calls,
+a million free calls and objects scattered all over the heap.
+
+The Arena allocates objects one after another in big chunks (bump pointer)
+and throws them all away at once:
+
+* create<T> () constructs a T in the arena, there is no per-object free
+* objects with a non trivial destructor get a small record in front of them,
+  linked into a list, so teardown knows what to destroy
+* trivially destructible objects get no record and cost nothing to destroy
+* reset () / the destructor run the list once (newest object first, like a
+  stack unwinding), reset keeps the chunks for the next round, the destructor
+  hands them back
+
+The destructor records call the destructor of the EXACT type that was
+created, qualified (p->T::~T ()), so even a virtual destructor is called
+directly, not through the vtable.
+
+Never delete an object that lives in an arena.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*==# DEFINES #==*/
+
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+/*==# CLASSES #==*/
+
+class Arena {
+
+    private:
+    struct Chunk {
+        Chunk* previous;
+        std::size_t size;
+    };
+
+    struct DestructorRecord {
+        DestructorRecord* next;
+        void (*destroy) (void* object);
+        void* object;
+    };
+
+    Chunk* chunk                 = nullptr;
+    Chunk* spare                 = nullptr;
+    char* cursor                 = nullptr;
+    char* limit                  = nullptr;
+    DestructorRecord* destructors = nullptr;
+    std::size_t chunk_size;
+    std::size_t bytes_used = 0;
+
+    static char* alignUp (char* pointer, std::size_t alignment) {
+        std::uintptr_t value = reinterpret_cast<std::uintptr_t> (pointer);
+        value = (value + alignment - 1) & ~(static_cast<std::uintptr_t> (alignment) - 1);
+        return reinterpret_cast<char*> (value);
+    }
+
+    void grow (std::size_t size, std::size_t alignment) {
+        std::size_t needed = sizeof (Chunk) + size + alignment;
+        std::size_t bytes  = needed > chunk_size ? needed : chunk_size;
+        Chunk* fresh       = nullptr;
+        if (spare && spare->size >= bytes) {
+            // Reuse a chunk from before the last reset, its pages are already mapped.
+            fresh = spare;
+            spare = spare->previous;
+        } else {
+            fresh = static_cast<Chunk*> (std::malloc (bytes));
+            if (!fresh) {
+                throw std::bad_alloc ();
+            }
+            fresh->size = bytes;
+        }
+        fresh->previous = chunk;
+        chunk           = fresh;
+        cursor          = reinterpret_cast<char*> (fresh + 1);
+        limit           = reinterpret_cast<char*> (fresh) + fresh->size;
+    }
+
+    void destroyAll () noexcept {
+        while (destructors) {
+            DestructorRecord* record = destructors;
+            destructors              = record->next;
+            record->destroy (record->object);
+        }
+    }
+
+    static void releaseChunks (Chunk*& list) noexcept {
+        while (list) {
+            Chunk* previous = list->previous;
+            std::free (list);
+            list = previous;
+        }
+    }
+
+    public:
+    explicit Arena (std::size_t new_chunk_size = ARENA_DEFAULT_CHUNK_SIZE)
+    : chunk_size (new_chunk_size) {
+    }
+
+    ~Arena () {
+        destroyAll ();
+        releaseChunks (chunk);
+        releaseChunks (spare);
+    }
+
+    Arena (const Arena&)            = delete;
+    Arena& operator= (const Arena&) = delete;
+
+    /*==# RAW ALLOCATION #==*/
+    void* allocate (std::size_t size, std::size_t alignment = alignof (std::max_align_t)) {
+        char* start = cursor ? alignUp (cursor, alignment) : nullptr;
+        if (!start || start > limit || size > static_cast<std::size_t> (limit - start)) {
+            grow (size, alignment);
+            start = alignUp (cursor, alignment);
+        }
+        cursor = start + size;
+        bytes_used += size;
+        return start;
+    }
+
+    /*==# OBJECT CREATION #==*/
+    /* The destructor record is only paid for by types that need one. */
+    template <typename T, typename... Args> T* create (Args&&... args) {
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            return ::new (allocate (sizeof (T), alignof (T))) T (std::forward<Args> (args)...);
+        } else {
+            DestructorRecord* record = static_cast<DestructorRecord*> (
+            allocate (sizeof (DestructorRecord), alignof (DestructorRecord)));
+            T* object = ::new (allocate (sizeof (T), alignof (T))) T (std::forward<Args> (args)...);
+            // Only link the record once the constructor did not throw.
+            record->next    = destructors;
+            record->destroy = [] (void* pointer) { static_cast<T*> (pointer)->T::~T (); };
+            record->object  = object;
+            destructors     = record;
+            return object;
+        }
+    }
+
+    /*==# TEARDOWN #==*/
+    /* Destroys every object in one pass, keeps the chunks for reuse. */
+    void reset () noexcept {
+        destroyAll ();
+        while (chunk) {
+            Chunk* previous = chunk->previous;
+            chunk->previous = spare;
+            spare           = chunk;
+            chunk           = previous;
+        }
+        cursor     = nullptr;
+        limit      = nullptr;
+        bytes_used = 0;
+    }
+
+    // Gives the chunks kept by reset back to the system.
+    void releaseSpare () noexcept {
+        releaseChunks (spare);
+    }
+
+    std::size_t bytesUsed () const noexcept {
+        return bytes_used;
+    }
+
+    bool owns (const void* pointer) const noexcept {
+        for (Chunk* current = chunk; current; current = current->previous) {
+            const char* begin = reinterpret_cast<const char*> (current + 1);
+            const char* end   = reinterpret_cast<const char*> (current) + current->size;
+            if (pointer >= begin && pointer < end) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,179 @@
+/*====# ARENA CLONE #====*/
+/*
+
+`ParentSlicerClass slicer = sliced;` copies only the part of the object the
+static type knows about. The classic fix is a virtual clone () that returns
+`new Derived (*this)`, which keeps the dynamic type but pays one new per
+object and, for a graph, one recursive call per edge (and it happily copies
+a shared node twice, or loops forever on a cycle).
+
+The arena clone protocol copies whole object graphs into an Arena:
+
+* cloneInto (CloneContext&) copies the object as its dynamic type into the
+  arena of the context (ARENA_CLONEABLE writes it for you)
+* relink (CloneContext&) replaces the pointers of the fresh copy, which still
+  point into the source graph, with context.remap (pointer)
+* remap clones every object only once, so shared nodes stay shared and
+  cycles stay cycles, and it works from a worklist, not by recursion, so a
+  million node long list does not blow the stack
+
+The source to clone mapping is a small open addressing table keyed by address.
+Pass the expected object count to skip its rehashing.
+
+Only polymorphic classes can take part. ParentSlicerClass has no vtable,
+so through a ParentSlicerClass& there is no way to learn what it really is.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <typeinfo>
+#include <vector>
+
+#include "arena.h"
+
+/*==# DEFINES #==*/
+
+// For the root of a hierarchy.
+#define ARENA_CLONEABLE_ROOT(Type)                             \
+    virtual Type* cloneInto (CloneContext& context) const {     \
+        return context.copy (*this);                           \
+    }                                                          \
+    virtual void relink (CloneContext& context) {              \
+        (void)context;                                         \
+    }
+
+// For the root of a hierarchy that is abstract itself.
+#define ARENA_CLONEABLE_ABSTRACT_ROOT(Type)                    \
+    virtual Type* cloneInto (CloneContext& context) const = 0; \
+    virtual void relink (CloneContext& context) {              \
+        (void)context;                                         \
+    }
+
+// For every class below the root. Forgetting it slices the clone (asserted).
+#define ARENA_CLONEABLE(Type)                                   \
+    Type* cloneInto (CloneContext& context) const override {    \
+        return context.copy (*this);                           \
+    }
+
+#define CLONE_CONTEXT_MIN_CAPACITY 64
+
+/*==# CLASSES #==*/
+
+class CloneContext {
+
+    private:
+    // Objects copied but not relinked yet, with their relink function.
+    struct Pending {
+        void* object;
+        void (*relink) (void* object, CloneContext& context);
+    };
+
+    struct Slot {
+        const void* source;
+        void* clone;
+    };
+
+    Arena& arena;
+    std::vector<Slot> slots;
+    std::size_t used = 0;
+    std::vector<Pending> pending;
+
+    // No mixing on purpose: graphs usually live in an arena, so neighbouring
+    // objects land in neighbouring slots and the table is walked, not jumped.
+    static std::size_t hash (const void* pointer) {
+        return static_cast<std::size_t> (reinterpret_cast<std::uintptr_t> (pointer) >> 4);
+    }
+
+    Slot& slotFor (const void* source) {
+        const std::size_t mask = slots.size () - 1;
+        std::size_t index      = hash (source) & mask;
+        while (slots[index].source && slots[index].source != source) {
+            index = (index + 1) & mask;
+        }
+        return slots[index];
+    }
+
+    void grow () {
+        std::vector<Slot> old (slots.size () * 2, Slot{ nullptr, nullptr });
+        old.swap (slots);
+        for (const Slot& slot : old) {
+            if (slot.source) {
+                slotFor (slot.source) = slot;
+            }
+        }
+    }
+
+    void drain () {
+        while (!pending.empty ()) {
+            Pending next = pending.back ();
+            pending.pop_back ();
+            next.relink (next.object, *this);
+        }
+    }
+
+    public:
+    explicit CloneContext (Arena& destination, std::size_t expected_objects = 0)
+    : arena (destination) {
+        std::size_t capacity = CLONE_CONTEXT_MIN_CAPACITY;
+        while (capacity < expected_objects * 2) {
+            capacity *= 2;
+        }
+        slots.assign (capacity, Slot{ nullptr, nullptr });
+    }
+
+    CloneContext (const CloneContext&)            = delete;
+    CloneContext& operator= (const CloneContext&) = delete;
+
+    /*==# USED BY cloneInto #==*/
+    /* Copy constructs the exact type T in the arena, relinking comes later. */
+    template <typename T> T* copy (const T& source) {
+        T* clone = arena.create<T> (source);
+        pending.push_back (Pending{ clone,
+        [] (void* object, CloneContext& context) { static_cast<T*> (object)->T::relink (context); } });
+        return clone;
+    }
+
+    /*==# USED BY relink #==*/
+    /* The clone of source, made on first sight. */
+    template <typename T> T* remap (T* source) {
+        if (!source) {
+            return nullptr;
+        }
+        Slot& slot = slotFor (source);
+        if (slot.source) {
+            return static_cast<T*> (slot.clone);
+        }
+        T* clone = source->cloneInto (*this);
+        assert (typeid (*clone) == typeid (*source) && "a class is missing ARENA_CLONEABLE");
+        slot.source = source;
+        slot.clone  = clone;
+        if (++used * 2 > slots.size ()) {
+            grow ();
+        }
+        return clone;
+    }
+
+    /*==# ENTRY POINT #==*/
+    /* Clones everything reachable from root and returns the clone of root. */
+    template <typename T> T* clone (T* root) {
+        T* result = remap (root);
+        drain ();
+        return result;
+    }
+
+    std::size_t clonedObjects () const {
+        return used;
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+template <typename T> T* cloneGraph (T* root, Arena& destination, std::size_t expected_objects = 0) {
+    CloneContext context (destination, expected_objects);
+    return context.clone (root);
+}
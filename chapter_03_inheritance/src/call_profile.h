@@ -0,0 +1,255 @@
+/*====# VIRTUAL CALL PROFILE #====*/
+/*
+
+Before devirtualizing a call we want to know that it is worth it: which
+call sites only ever see ONE dynamic type (monomorphic, a guarded direct call
+or a final class makes them free) and which see two (bimorphic, one compare
+is still cheaper than the indirect branch).
+
+Build with -DCHAPTER_03_PROFILE_CALLS=ON and every instrumented virtual
+function records (call site, dynamic type). The call site is the return
+address of the call, so every place in the program that makes the call is
+told apart without touching the callers.
+
+* every thread counts into its own table, nothing is shared on the hot path
+* tables of finished threads are folded into a global one
+* CALL_PROFILE_REPORT () prints all sites with their types and flags them
+  as monomorphic, bimorphic, polymorphic (3-4) or megamorphic (5+)
+
+What the site really is: the return address seen by the CALLEE. So
+* only calls that actually go out of line to the instrumented function are
+  attributed right. The instrumented functions are marked
+  CALL_PROFILE_NOINLINE, which keeps them out of line in a profiling build
+  (and only there), so the site is the call instruction itself.
+* a site is (return address, function name): two functions that still end
+  up behind the same address are reported apart, not as one site with the
+  types of both
+* direct calls are counted too, a qualified T::returnNumber () (as
+  BatchedInterface makes) shows up as a monomorphic site although it never
+  was a virtual call
+* destructors are not instrumented: inside a destructor typeid (*this) is
+  always the class being destroyed, and the caller is the compiler's
+  deleting destructor, not the delete expression, so every one would read
+  MONOMORPHIC and say nothing
+
+Without the option the macros expand to nothing.
+
+*/
+
+#pragma once
+
+#ifdef INHERITANCE_PROFILE_CALLS
+
+/*==# INCLUDES #==*/
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+/*==# DEFINES #==*/
+
+#define CALL_PROFILE_TABLE_SIZE 4096
+
+#define CALL_PROFILE() \
+    call_profile::record (__builtin_return_address (0), typeid (*this), __func__)
+#define CALL_PROFILE_REPORT() call_profile::report (stdout)
+#define CALL_PROFILE_NOINLINE __attribute__ ((noinline))
+
+namespace call_profile {
+
+/*==# CLASSES #==*/
+
+struct Counter {
+    std::atomic<const void*> site{ nullptr };
+    const std::type_info* type = nullptr;
+    const char* function       = nullptr;
+    std::atomic<std::uint64_t> count{ 0 };
+};
+
+// Written by its own thread only, read by the report.
+class ThreadTable {
+
+    private:
+    Counter counters[CALL_PROFILE_TABLE_SIZE];
+    std::atomic<std::uint64_t> dropped{ 0 };
+
+    public:
+    ThreadTable ();
+    ~ThreadTable ();
+
+    ThreadTable (const ThreadTable&)            = delete;
+    ThreadTable& operator= (const ThreadTable&) = delete;
+
+    void add (const void* site, const std::type_info& type, const char* function) {
+        std::uintptr_t hash = reinterpret_cast<std::uintptr_t> (site) ^
+        (reinterpret_cast<std::uintptr_t> (&type) >> 4) ^ (reinterpret_cast<std::uintptr_t> (function) >> 2);
+        hash *= 0x9e3779b97f4a7c15ull;
+        for (std::size_t probe = 0; probe < CALL_PROFILE_TABLE_SIZE; ++probe) {
+            Counter& counter = counters[(hash + probe) % CALL_PROFILE_TABLE_SIZE];
+            const void* current = counter.site.load (std::memory_order_relaxed);
+            if (current == site && counter.type == &type && counter.function == function) {
+                // Single writer, a plain increment without a locked instruction.
+                counter.count.store (counter.count.load (std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+                return;
+            }
+            if (!current) {
+                counter.type     = &type;
+                counter.function = function;
+                counter.count.store (1, std::memory_order_relaxed);
+                counter.site.store (site, std::memory_order_release);
+                return;
+            }
+        }
+        dropped.store (dropped.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    template <typename Visit> void forEach (Visit&& visit) const {
+        for (const Counter& counter : counters) {
+            if (const void* site = counter.site.load (std::memory_order_acquire)) {
+                visit (site, *counter.type, counter.function,
+                counter.count.load (std::memory_order_relaxed));
+            }
+        }
+    }
+
+    std::uint64_t droppedCalls () const {
+        return dropped.load (std::memory_order_relaxed);
+    }
+};
+
+// All live tables plus the counts of threads that already ended.
+struct Registry {
+    using Key = std::tuple<const void*, const std::type_info*, const char*>; // site, type, function
+
+    std::mutex mutex;
+    std::vector<ThreadTable*> live;
+    std::map<Key, std::uint64_t> retired;
+    std::uint64_t dropped = 0;
+
+    static Registry& instance () {
+        static Registry* registry = new Registry (); // outlives every thread_local
+        return *registry;
+    }
+};
+
+inline ThreadTable::ThreadTable () {
+    Registry& registry = Registry::instance ();
+    std::lock_guard<std::mutex> lock (registry.mutex);
+    registry.live.push_back (this);
+}
+
+inline ThreadTable::~ThreadTable () {
+    Registry& registry = Registry::instance ();
+    std::lock_guard<std::mutex> lock (registry.mutex);
+    forEach ([&registry] (const void* site, const std::type_info& type, const char* function,
+             std::uint64_t count) {
+        registry.retired[Registry::Key (site, &type, function)] += count;
+    });
+    registry.dropped += droppedCalls ();
+    for (std::size_t i = 0; i < registry.live.size (); ++i) {
+        if (registry.live[i] == this) {
+            registry.live.erase (registry.live.begin () + static_cast<std::ptrdiff_t> (i));
+            break;
+        }
+    }
+}
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+inline void record (const void* site, const std::type_info& type, const char* function) {
+    thread_local ThreadTable table;
+    table.add (site, type, function);
+}
+
+inline std::string demangle (const char* name) {
+    int status  = 0;
+    char* plain = abi::__cxa_demangle (name, nullptr, nullptr, &status);
+    std::string result (status == 0 && plain ? plain : name);
+    std::free (plain);
+    return result;
+}
+
+// function+offset when the symbol is exported (the targets link with -rdynamic).
+inline std::string describeSite (const void* site) {
+    Dl_info info;
+    char buffer[64];
+    if (dladdr (site, &info) && info.dli_sname) {
+        std::snprintf (buffer, sizeof (buffer), "+0x%zx",
+        static_cast<std::size_t> (static_cast<const char*> (site) -
+        static_cast<const char*> (info.dli_saddr)));
+        return demangle (info.dli_sname) + buffer;
+    }
+    std::snprintf (buffer, sizeof (buffer), "%p", site);
+    return buffer;
+}
+
+inline const char* classify (std::size_t types) {
+    switch (types) {
+    case 1: return "MONOMORPHIC";
+    case 2: return "BIMORPHIC";
+    case 3:
+    case 4: return "polymorphic";
+    default: return "megamorphic";
+    }
+}
+
+inline void report (std::FILE* out) {
+    Registry& registry = Registry::instance ();
+    std::lock_guard<std::mutex> lock (registry.mutex);
+
+    // (site, function) -> type -> count. By name: every override has its own __func__.
+    using Site = std::pair<const void*, std::string>;
+    std::map<Site, std::map<std::string, std::uint64_t>> sites;
+    auto merge = [&sites] (const void* site, const std::type_info& type, const char* function,
+                 std::uint64_t count) {
+        sites[Site (site, function)][demangle (type.name ())] += count;
+    };
+
+    std::uint64_t dropped = registry.dropped;
+    for (const ThreadTable* table : registry.live) {
+        table->forEach (merge);
+        dropped += table->droppedCalls ();
+    }
+    for (const auto& [key, count] : registry.retired) {
+        merge (std::get<0> (key), *std::get<1> (key), std::get<2> (key), count);
+    }
+
+    std::fprintf (out, "\n## VIRTUAL CALL PROFILE ##\n");
+    for (const auto& [site, types] : sites) {
+        std::uint64_t total = 0;
+        for (const auto& type : types) {
+            total += type.second;
+        }
+        std::fprintf (out, "%-12s %s () called from %s, %llu calls\n", classify (types.size ()),
+        site.second.c_str (), describeSite (site.first).c_str (), static_cast<unsigned long long> (total));
+        for (const auto& [type, count] : types) {
+            std::fprintf (out, "    %-40s %llu\n", type.c_str (), static_cast<unsigned long long> (count));
+        }
+    }
+    if (dropped) {
+        std::fprintf (out, "(%llu calls not recorded, the per thread table was full)\n",
+        static_cast<unsigned long long> (dropped));
+    }
+}
+
+} // namespace call_profile
+
+#else
+
+#define CALL_PROFILE()
+#define CALL_PROFILE_REPORT()
+#define CALL_PROFILE_NOINLINE
+
+#endif
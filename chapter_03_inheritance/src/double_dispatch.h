@@ -0,0 +1,215 @@
+/*====# DOUBLE DISPATCH #====*/
+/*
+
+What happens when a PolymorphicClass meets an OverridingClass? The answer
+depends on the dynamic type of BOTH objects, and C++ only dispatches on one.
+The usual ways out:
+
+* visitor  - left.meet (right) is virtual, it calls right.meetWith (*this),
+             which is virtual again: two indirect calls, and every class
+             has to know every other class
+* casts    - a chain of dynamic_cast, one string or hierarchy walk per try
+
+DoubleDispatcher does it with a table instead:
+
+* every class gets a dense type id (0, 1, 2 ...) the first time it is asked
+  for, DISPATCH_ROOT / DISPATCH_TYPE write the virtual that returns it
+* handlers are registered per pair of types, the table is ids x ids
+* a call is two id lookups and ONE indexed load of the function pointer
+
+Asking the object for its id is a virtual call again, and for random pairs
+an unpredictable one. So the dispatcher remembers the ids per vptr in a small
+direct mapped cache: all objects of one dynamic type share the vptr (for the
+Itanium ABI the first word of the object), so after the first call of a type
+its id costs a load and a compare that always hits. Only the call of the
+handler is left as an indirect branch, the visitor has two.
+
+A pair without a handler falls back to the closest registered pair of
+parents (left first) and the result is written into the table, so the walk
+happens once per pair. No handler at all means the fallback handler.
+
+The handler gets the objects cast back to the registered types, the cast is
+a static_cast, so no virtual inheritance below the root.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*==# DEFINES #==*/
+
+// For the root of a hierarchy.
+#define DISPATCH_ROOT(Type)                         \
+    using DispatchRoot   = Type;                    \
+    using DispatchParent = void;                    \
+    virtual std::size_t dispatchId () const {       \
+        return DispatchRegistry<Type>::id<Type> (); \
+    }
+
+// For every class below the root, Parent is its direct base.
+#define DISPATCH_TYPE(Type, Parent)                         \
+    using DispatchParent = Parent;                          \
+    std::size_t dispatchId () const override {              \
+        return DispatchRegistry<DispatchRoot>::id<Type> (); \
+    }
+
+#define DISPATCH_NO_TYPE static_cast<std::size_t> (-1)
+#define DISPATCH_VPTR_CACHE 64
+
+/*==# CLASSES #==*/
+
+// 1. TYPE IDS //
+/* Dense ids per hierarchy, handed out in the order the types are first seen. */
+
+template <typename Root> class DispatchRegistry {
+
+    private:
+    static std::vector<std::size_t>& parents () {
+        static std::vector<std::size_t> parent_ids;
+        return parent_ids;
+    }
+
+    public:
+    template <typename T> static std::size_t id () {
+        static_assert (std::is_base_of_v<Root, T>, "T must belong to the Root hierarchy");
+        static const std::size_t value = [] () {
+            std::size_t parent = DISPATCH_NO_TYPE;
+            if constexpr (!std::is_void_v<typename T::DispatchParent>) {
+                parent = id<typename T::DispatchParent> ();
+            }
+            parents ().push_back (parent);
+            return parents ().size () - 1;
+        }();
+        return value;
+    }
+
+    static std::size_t parentOf (std::size_t type) {
+        return type < parents ().size () ? parents ()[type] : DISPATCH_NO_TYPE;
+    }
+
+    static std::size_t count () {
+        return parents ().size ();
+    }
+};
+
+// 2. DISPATCHER //
+
+template <typename Root, typename Result, typename... Args> class DoubleDispatcher {
+
+    public:
+    using Handler = Result (*) (Root& left, Root& right, Args... args);
+
+    private:
+    using Registry = DispatchRegistry<Root>;
+
+    static_assert (std::is_polymorphic_v<Root>, "the vptr identifies the dynamic type");
+
+    struct CachedId {
+        const void* vptr = nullptr;
+        std::size_t id   = DISPATCH_NO_TYPE;
+    };
+
+    CachedId id_cache[DISPATCH_VPTR_CACHE];
+    Handler fallback;
+    std::size_t stride = 0;
+    std::vector<Handler> table;        // resolved, what calls read
+    std::vector<Handler> registered;   // only what add () was given
+
+    // Calls a captureless lambda with the objects cast to its parameter types.
+    template <typename Left, typename Right, typename Function>
+    static Result thunk (Root& left, Root& right, Args... args) {
+        return Function{}(static_cast<Left&> (left), static_cast<Right&> (right), args...);
+    }
+
+    template <typename Left, typename Right, typename Function>
+    static Result swappedThunk (Root& left, Root& right, Args... args) {
+        return Function{}(static_cast<Left&> (right), static_cast<Right&> (left), args...);
+    }
+
+    void grow (std::size_t types) {
+        if (types <= stride) {
+            return;
+        }
+        std::vector<Handler> bigger (types * types, nullptr);
+        for (std::size_t left = 0; left < stride; ++left) {
+            for (std::size_t right = 0; right < stride; ++right) {
+                bigger[left * types + right] = registered[left * stride + right];
+            }
+        }
+        registered = std::move (bigger);
+        table.assign (types * types, nullptr);
+        stride = types;
+    }
+
+    Handler lookup (std::size_t left, std::size_t right) const {
+        return left < stride && right < stride ? registered[left * stride + right] : nullptr;
+    }
+
+    // Closest registered pair: walk the left parents for every right parent.
+    Handler resolve (std::size_t left, std::size_t right) {
+        grow (Registry::count ());
+        for (std::size_t r = right; r != DISPATCH_NO_TYPE; r = Registry::parentOf (r)) {
+            for (std::size_t l = left; l != DISPATCH_NO_TYPE; l = Registry::parentOf (l)) {
+                if (Handler handler = lookup (l, r)) {
+                    return table[left * stride + right] = handler;
+                }
+            }
+        }
+        return table[left * stride + right] = fallback;
+    }
+
+    std::size_t idOf (Root& object) {
+        const void* vptr;
+        std::memcpy (&vptr, static_cast<const void*> (&object), sizeof (vptr));
+        CachedId& cached =
+        id_cache[(reinterpret_cast<std::uintptr_t> (vptr) >> 4) % DISPATCH_VPTR_CACHE];
+        if (cached.vptr != vptr) {
+            cached.vptr = vptr;
+            cached.id   = object.dispatchId ();
+        }
+        return cached.id;
+    }
+
+    void set (std::size_t left, std::size_t right, Handler handler) {
+        grow (Registry::count ());
+        registered[left * stride + right] = handler;
+        table.assign (table.size (), nullptr); // parents may resolve differently now
+    }
+
+    public:
+    explicit DoubleDispatcher (Handler fallback_handler) : fallback (fallback_handler) {
+    }
+
+    // Registers function (Left&, Right&, Args...) for the pair, and for the
+    // swapped pair too unless symmetric is false. function must not capture.
+    template <typename Left, typename Right, typename Function>
+    DoubleDispatcher& add (Function function, bool symmetric = true) {
+        static_assert (std::is_empty_v<Function>, "handlers must be captureless lambdas or function objects");
+        (void)function;
+        const std::size_t left  = Registry::template id<Left> ();
+        const std::size_t right = Registry::template id<Right> ();
+        set (left, right, &thunk<Left, Right, Function>);
+        if (symmetric && left != right) {
+            set (right, left, &swappedThunk<Left, Right, Function>);
+        }
+        return *this;
+    }
+
+    Result operator() (Root& left, Root& right, Args... args) {
+        const std::size_t left_id  = idOf (left);
+        const std::size_t right_id = idOf (right);
+        if (left_id < stride && right_id < stride) {
+            if (Handler handler = table[left_id * stride + right_id]) {
+                return handler (left, right, args...);
+            }
+        }
+        return resolve (left_id, right_id) (left, right, args...);
+    }
+};
@@ -0,0 +1,320 @@
+/*====# FLAT FORMAT #====*/
+/*
+
+A binary format for the objects of this chapter in the spirit of
+FlatBuffers: the reader does not parse the buffer into objects, it reads
+the fields right where they lie.
+
+    u32 magic, u32 count
+    u32 offset[count]                 where every object starts
+    per object, 4 byte aligned:
+        u16 tag, u16 field count      the type and how many fields follow
+        i32 field[field count]
+
+* The tag is the exact dynamic type. An OverridingClass written through a
+  PolymorphicClass& comes back as an OverridingClass, a ClassToBeSliced
+  keeps its own a and b next to the parent's: nothing is sliced off.
+* The fields are the ones ColumnLayout lists (sliced_columns.h), in that
+  order, so the parent's fields come first and a ClassToBeSliced can be
+  read as a ParentSlicerClass in place.
+* A reader takes the default value of the class for a field the buffer
+  does not have (written by an older version) and ignores extra ones
+  (written by a newer one).
+
+FlatReader hands out FlatView<T> (typed field access, no allocation) and
+visit (), which puts a real object of the exact type on the stack and
+calls a function with it.
+
+Values are stored in the byte order of the machine, little endian here.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "inheritance.h"
+#include "sliced_columns.h"
+
+/*==# DEFINES #==*/
+
+#define FLAT_MAGIC 0x31544c46u // "FLT1"
+
+static_assert (std::endian::native == std::endian::little, "the flat format is written little endian");
+
+namespace flat {
+
+enum Tag : std::uint16_t {
+    TAG_NONE = 0,
+    TAG_CONCRETE,
+    TAG_POLYMORPHIC,
+    TAG_OVERRIDING,
+    TAG_PARENT_SLICER,
+    TAG_CLASS_TO_BE_SLICED,
+    TAG_COUNT
+};
+
+// The parent of every tag, for "is a" questions.
+inline constexpr Tag parents[TAG_COUNT] = { TAG_NONE, TAG_NONE, TAG_NONE, TAG_POLYMORPHIC, TAG_NONE,
+    TAG_PARENT_SLICER };
+
+template <typename T> struct TypeOf;
+template <> struct TypeOf<ConcreteClass> {
+    static constexpr Tag tag = TAG_CONCRETE;
+};
+template <> struct TypeOf<PolymorphicClass> {
+    static constexpr Tag tag = TAG_POLYMORPHIC;
+};
+template <> struct TypeOf<OverridingClass> {
+    static constexpr Tag tag = TAG_OVERRIDING;
+};
+template <> struct TypeOf<ParentSlicerClass> {
+    static constexpr Tag tag = TAG_PARENT_SLICER;
+};
+template <> struct TypeOf<ClassToBeSliced> {
+    static constexpr Tag tag = TAG_CLASS_TO_BE_SLICED;
+};
+
+// Classes with a ColumnLayout store its fields, the others none.
+template <typename T> constexpr std::size_t fieldCount () {
+    if constexpr (requires { ColumnLayout<T>::COUNT; }) {
+        return ColumnLayout<T>::COUNT;
+    } else {
+        return 0;
+    }
+}
+
+constexpr bool isA (Tag tag, Tag ancestor) {
+    for (; tag != TAG_NONE && tag < TAG_COUNT; tag = parents[tag]) {
+        if (tag == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T> T load (const std::byte* from) {
+    T value;
+    std::memcpy (&value, from, sizeof (T));
+    return value;
+}
+
+} // namespace flat
+
+/*==# CLASSES #==*/
+
+// 1. WRITING //
+
+class FlatBuilder {
+
+    private:
+    std::vector<std::uint32_t> offsets; // from the start of the object area
+    std::vector<std::byte> objects;
+
+    template <typename T> void append (const T& value) {
+        const std::size_t at = objects.size ();
+        objects.resize (at + sizeof (T));
+        std::memcpy (objects.data () + at, &value, sizeof (T));
+    }
+
+    template <typename T> void addExact (const T& object) {
+        constexpr std::size_t count = flat::fieldCount<T> ();
+        offsets.push_back (static_cast<std::uint32_t> (objects.size ()));
+        append (static_cast<std::uint16_t> (flat::TypeOf<T>::tag));
+        append (static_cast<std::uint16_t> (count));
+        if constexpr (count > 0) {
+            for (std::size_t field = 0; field < count; ++field) {
+                append (static_cast<std::int32_t> (object.*ColumnLayout<T>::fields[field]));
+            }
+        }
+    }
+
+    public:
+    void reserve (std::size_t count, std::size_t bytes) {
+        offsets.reserve (count);
+        objects.reserve (bytes);
+    }
+
+    void add (const ConcreteClass& object) {
+        addExact (object);
+    }
+
+    // Written as its dynamic type, a subclass without a tag throws rather than being sliced.
+    void add (const PolymorphicClass& object) {
+        if (typeid (object) == typeid (OverridingClass)) {
+            addExact (static_cast<const OverridingClass&> (object));
+        } else if (typeid (object) == typeid (PolymorphicClass)) {
+            addExact (object);
+        } else {
+            throw std::runtime_error (std::string ("FlatBuilder: no tag for ") + typeid (object).name ());
+        }
+    }
+
+    // Not polymorphic, written as the static type.
+    void add (const ParentSlicerClass& object) {
+        addExact (object);
+    }
+
+    void add (const ClassToBeSliced& object) {
+        addExact (object);
+    }
+
+    std::size_t size () const {
+        return offsets.size ();
+    }
+
+    void clear () {
+        offsets.clear ();
+        objects.clear ();
+    }
+
+    // The finished buffer. The builder can be cleared and reused afterwards.
+    std::vector<std::byte> finish () const {
+        const std::size_t table = 2 * sizeof (std::uint32_t) + offsets.size () * sizeof (std::uint32_t);
+        std::vector<std::byte> buffer (table + objects.size ());
+        const std::uint32_t header[2] = { FLAT_MAGIC, static_cast<std::uint32_t> (offsets.size ()) };
+        std::memcpy (buffer.data (), header, sizeof (header));
+        for (std::size_t i = 0; i < offsets.size (); ++i) {
+            const std::uint32_t offset = static_cast<std::uint32_t> (table + offsets[i]);
+            std::memcpy (buffer.data () + sizeof (header) + i * sizeof (offset), &offset, sizeof (offset));
+        }
+        std::memcpy (buffer.data () + table, objects.data (), objects.size ());
+        return buffer;
+    }
+};
+
+// 2. READING //
+
+// The fields of one object of type T (or of a type derived from it) in a buffer.
+template <typename T> class FlatView {
+
+    private:
+    const std::byte* object;
+
+    public:
+    explicit FlatView (const std::byte* start) : object (start) {
+    }
+
+    flat::Tag tag () const {
+        return static_cast<flat::Tag> (flat::load<std::uint16_t> (object));
+    }
+
+    // Field index of ColumnLayout<T>, the default of T when the buffer has less.
+    int field (std::size_t index) const {
+        const std::size_t stored = flat::load<std::uint16_t> (object + sizeof (std::uint16_t));
+        if (index < stored) {
+            return flat::load<std::int32_t> (object + 2 * sizeof (std::uint16_t) + index * sizeof (std::int32_t));
+        }
+        static const T defaults{};
+        return defaults.*ColumnLayout<T>::fields[index];
+    }
+
+    // A T on the stack with the stored fields.
+    T materialize () const {
+        T result{};
+        if constexpr (flat::fieldCount<T> () > 0) {
+            for (std::size_t index = 0; index < flat::fieldCount<T> (); ++index) {
+                result.*ColumnLayout<T>::fields[index] = field (index);
+            }
+        }
+        return result;
+    }
+};
+
+class FlatReader {
+
+    private:
+    std::span<const std::byte> buffer;
+    std::uint32_t count;
+
+    const std::byte* objectAt (std::size_t index) const {
+        return buffer.data () + flat::load<std::uint32_t> (buffer.data () + (2 + index) * sizeof (std::uint32_t));
+    }
+
+    public:
+    // Checks the header, the objects are not looked at (see verify ()).
+    explicit FlatReader (std::span<const std::byte> bytes) : buffer (bytes), count (0) {
+        if (buffer.size () < 2 * sizeof (std::uint32_t) || flat::load<std::uint32_t> (buffer.data ()) != FLAT_MAGIC) {
+            throw std::runtime_error ("FlatReader: not a flat buffer");
+        }
+        count = flat::load<std::uint32_t> (buffer.data () + sizeof (std::uint32_t));
+        if ((buffer.size () - 2 * sizeof (std::uint32_t)) / sizeof (std::uint32_t) < count) {
+            throw std::runtime_error ("FlatReader: offset table out of bounds");
+        }
+    }
+
+    // Every offset, tag and field count inside the buffer, for buffers from
+    // somebody we do not trust. One pass over the offset table.
+    bool verify () const {
+        for (std::size_t index = 0; index < count; ++index) {
+            const std::size_t offset = flat::load<std::uint32_t> (buffer.data () + (2 + index) * sizeof (std::uint32_t));
+            if (offset % alignof (std::int32_t) || offset + 2 * sizeof (std::uint16_t) > buffer.size ()) {
+                return false;
+            }
+            const std::uint16_t tag    = flat::load<std::uint16_t> (buffer.data () + offset);
+            const std::uint16_t fields = flat::load<std::uint16_t> (buffer.data () + offset + sizeof (std::uint16_t));
+            if (tag == flat::TAG_NONE || tag >= flat::TAG_COUNT ||
+            offset + 2 * sizeof (std::uint16_t) + fields * sizeof (std::int32_t) > buffer.size ()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::size_t size () const {
+        return count;
+    }
+
+    flat::Tag tag (std::size_t index) const {
+        return static_cast<flat::Tag> (flat::load<std::uint16_t> (objectAt (index)));
+    }
+
+    // Object index is a T or derives from it.
+    template <typename T> bool is (std::size_t index) const {
+        return flat::isA (tag (index), flat::TypeOf<T>::tag);
+    }
+
+    // Object index seen as a T, it must be one (see is ()).
+    template <typename T> FlatView<T> get (std::size_t index) const {
+        return FlatView<T> (objectAt (index));
+    }
+
+    // Calls function (T&) with the object at index as its exact type T,
+    // throws for a tag that names no type.
+    template <typename Function> decltype (auto) visit (std::size_t index, Function&& function) const {
+        const std::byte* object = objectAt (index);
+        switch (tag (index)) {
+        case flat::TAG_CONCRETE: {
+            ConcreteClass concrete = FlatView<ConcreteClass> (object).materialize ();
+            return function (concrete);
+        }
+        case flat::TAG_POLYMORPHIC: {
+            PolymorphicClass polymorphic = FlatView<PolymorphicClass> (object).materialize ();
+            return function (polymorphic);
+        }
+        case flat::TAG_OVERRIDING: {
+            OverridingClass overriding = FlatView<OverridingClass> (object).materialize ();
+            return function (overriding);
+        }
+        case flat::TAG_PARENT_SLICER: {
+            ParentSlicerClass parent = FlatView<ParentSlicerClass> (object).materialize ();
+            return function (parent);
+        }
+        case flat::TAG_CLASS_TO_BE_SLICED: {
+            ClassToBeSliced sliced = FlatView<ClassToBeSliced> (object).materialize ();
+            return function (sliced);
+        }
+        default:
+            throw std::runtime_error ("FlatReader: unknown tag, the buffer was not verified");
+        }
+    }
+};
@@ -0,0 +1,395 @@
+/*====# INHERITANCE HIERARCHY #====*/
+/*
+
+The classes examined in this chapter. They live in their own header so that
+the benchmarks and helpers next to main.cpp can use the very same hierarchy.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <type_traits>
+
+#include "arena_clone.h"
+#include "call_profile.h"
+#include "double_dispatch.h"
+#include "intrusive.h"
+
+#ifdef INHERITANCE_POOLED_NEW
+#include "pooled_new.h"
+#endif
+
+/*==# DEFINES #==*/
+
+// Build with -DCHAPTER_03_POOLED_NEW=ON to route new/delete of the
+// VirtualDestructorClass and PolymorphicClass hierarchies to the size class pools.
+#ifdef INHERITANCE_POOLED_NEW
+#define INHERITANCE_ALLOCATION POOLED_NEW_OPERATORS
+#else
+#define INHERITANCE_ALLOCATION
+#endif
+
+/*==# CLASSES #==*/
+
+// 1. INTERFACE //
+/*
+
+C++ by itself has no real concept of interfaces so
+we can only achieve that using a purely abstract class.
+
+ConcreteClass implements the abstract class AbstractInterface
+and creates the fucntions.
+
+*/
+
+class AbstractInterface {
+
+    public:
+    virtual ~AbstractInterface () = default;
+
+    virtual char returnChar ()  = 0;
+    virtual int returnNumber () = 0;
+
+    // Batch version, see 1.2. Every object must have the dynamic type of *this.
+    virtual void returnNumbers (std::span<AbstractInterface* const> objects, std::span<int> out) {
+        for (std::size_t i = 0; i < objects.size (); ++i) {
+            out[i] = objects[i]->returnNumber ();
+        }
+    }
+};
+
+// 1.2 BATCH VIRTUALS //
+/*
+
+One virtual call per object pays the dispatch once per object. When we have
+many objects of the same type, one virtual call can do them all: the
+implementation knows the exact type, so inside the loop returnNumber is a
+direct, inlined call and the loop has no branches left for the compiler to
+trip over (with wide enough vectors it is a gather and a store).
+
+BatchedInterface<Self> writes that override for Self. The free function
+returnNumbers takes a mixed span, cuts it into runs of one dynamic type
+(objects of one type share the vptr) and makes one virtual call per run, so
+sorting or bucketing the objects by type (PolyCollection) is what makes the
+batches long.
+
+The call inside the loop is qualified, non-virtual, so Self must be final: an
+override in a subclass of Self would silently be skipped. out must hold at
+least one int per object.
+
+*/
+
+template <typename Self> class BatchedInterface : public AbstractInterface {
+
+    public:
+    void returnNumbers (std::span<AbstractInterface* const> objects, std::span<int> out) override {
+        static_assert (std::is_final_v<Self>, "BatchedInterface calls Self::returnNumber directly, Self must be final");
+        assert (out.size () >= objects.size () && "returnNumbers: out is shorter than objects");
+        for (std::size_t i = 0; i < objects.size (); ++i) {
+            out[i] = static_cast<Self*> (objects[i])->Self::returnNumber ();
+        }
+    }
+};
+
+inline const void* vptrOf (const AbstractInterface* object) {
+    const void* vptr;
+    std::memcpy (&vptr, static_cast<const void*> (object), sizeof (vptr));
+    return vptr;
+}
+
+inline void returnNumbers (std::span<AbstractInterface* const> objects, std::span<int> out) {
+    assert (out.size () >= objects.size () && "returnNumbers: out is shorter than objects");
+    std::size_t begin = 0;
+    while (begin < objects.size ()) {
+        const void* vptr = vptrOf (objects[begin]);
+        std::size_t end  = begin + 1;
+        while (end < objects.size () && vptrOf (objects[end]) == vptr) {
+            ++end;
+        }
+        objects[begin]->returnNumbers (objects.subspan (begin, end - begin), out.subspan (begin, end - begin));
+        begin = end;
+    }
+}
+
+class ConcreteClass final : public BatchedInterface<ConcreteClass> {
+
+    public:
+    CALL_PROFILE_NOINLINE char returnChar () {
+        CALL_PROFILE ();
+        return 'e';
+    }
+
+    CALL_PROFILE_NOINLINE int returnNumber () {
+        CALL_PROFILE ();
+        return 15;
+    }
+};
+
+// 1.1 STATIC INTERFACE (CRTP) //
+/*
+
+The Curiously Recurring Template Pattern gives us the same interface without
+the vtable. The base class knows the derived type at compile time, so a call to
+returnChar is a plain, inlinable call and the object carries no vptr.
+
+The price is that there is no common base type anymore, StaticInterface<X>
+and StaticInterface<Y> are unrelated. When we need plugins or mixed
+collections, AbstractInterface is still there.
+
+The static_asserts make forgetting a function a compile error instead of
+an infinite recursion (the base would end up calling itself).
+
+*/
+
+template <typename Derived> class StaticInterface {
+
+    public:
+    char returnChar () {
+        return self ().returnChar ();
+    }
+
+    int returnNumber () {
+        return self ().returnNumber ();
+    }
+
+    protected:
+    // Only a derived class may construct or destroy us, no deleting through the base.
+    StaticInterface () {
+        static_assert (std::is_base_of_v<StaticInterface, Derived>,
+        "StaticInterface<Derived> must be a base of Derived");
+        static_assert (!std::is_same_v<decltype (&Derived::returnChar), char (StaticInterface::*) ()>,
+        "Derived must implement char returnChar ()");
+        static_assert (!std::is_same_v<decltype (&Derived::returnNumber), int (StaticInterface::*) ()>,
+        "Derived must implement int returnNumber ()");
+    }
+    ~StaticInterface () = default;
+
+    private:
+    Derived& self () {
+        return static_cast<Derived&> (*this);
+    }
+};
+
+class StaticConcreteClass final : public StaticInterface<StaticConcreteClass> {
+
+    public:
+    char returnChar () {
+        return 'e';
+    }
+
+    int returnNumber () {
+        return 15;
+    }
+};
+
+static_assert (!std::is_polymorphic_v<StaticConcreteClass>, "StaticConcreteClass must not carry a vptr");
+
+// 2. VIRTUAL DESTRUCTOR //
+/*
+
+A virtual destructor is a very helpful method of properly destroying the object.
+Making the base class destructor virtual guarantees that the object of derived class
+is destructed properly (both base class and derived class destructors are called)
+
+*/
+
+class VirtualDestructorClass {
+    public:
+    INHERITANCE_ALLOCATION
+
+    virtual ~VirtualDestructorClass () {
+        std::cout << "VirtualDestructorClass destructor! I am the big boy." << std::endl;
+    }
+};
+
+class SubClass_VirtualDestructor : public VirtualDestructorClass {
+    public:
+    ~SubClass_VirtualDestructor () {
+        std::cout
+        << "SubClass_VirtualDestructor destructor! I wish I was the big boy."
+        << std::endl;
+    }
+};
+
+// 2.1 INTRUSIVE HOOKS //
+/*
+
+Keeping track of live objects without a node allocation per object: the
+object carries its own list links (intrusive.h). With HOOK_AUTO_UNLINK the
+destructor takes the object out of the list, a deleted object can never be
+left dangling in it.
+
+*/
+
+class TrackedDestructorClass : public SubClass_VirtualDestructor, public ListHook<HOOK_AUTO_UNLINK> {};
+
+// 3. POLYMORPHISM AND OVERRIDING //
+/*
+
+Very simply put, overriding is just a form of polymorphism. All overriding really does is
+well... override an existing function from the parent class and replace it.
+
+The override keyword does just that, but allows us to override virtual functions.
+It also serves as a simple check if you are... in fact... overriding something.
+
+Pretty cool, right?
+
+*/
+
+class PolymorphicClass {
+    public:
+    INHERITANCE_ALLOCATION
+    ARENA_CLONEABLE_ROOT (PolymorphicClass)
+    DISPATCH_ROOT (PolymorphicClass)
+
+    virtual ~PolymorphicClass () {
+    }
+
+    CALL_PROFILE_NOINLINE virtual bool isFiveStar () {
+        CALL_PROFILE ();
+        return true;
+    }
+    void sayLine () {
+        std::cout << "I am the peak of function evolution." << std::endl;
+    }
+};
+
+class OverridingClass : public PolymorphicClass {
+    public:
+    ARENA_CLONEABLE (OverridingClass)
+    DISPATCH_TYPE (OverridingClass, PolymorphicClass)
+
+    CALL_PROFILE_NOINLINE virtual bool isFiveStar () override {
+        CALL_PROFILE ();
+        return false;
+    }
+
+    void sayLine () {
+        std::cout << "I'm not just like the rest of you. I'm stronger. I'm "
+                     "smarter. I'm better. I AM BETTER."
+                  << std::endl;
+    }
+};
+
+// 4. DIAMOND INHERITANCE PROBLEM (a.k.a why I love C more) //
+/*
+
+OOP and inheritance can be helpful, sure. But then comes the scary topic of one class
+inheriting from multiple classes, which inherit from one base class (diamond shape yeah)
+
+
+*/
+
+class A {
+    public:
+    void whoisthatClass () {
+        std::cout << "It's A!" << std::endl;
+    }
+};
+
+class B : virtual public A {
+    public:
+    void whoisthatClass () {
+        std::cout << "It's B!" << std::endl;
+    }
+};
+
+class C : virtual public A {
+    public:
+    void whoisthatClass () {
+        std::cout << "It's C!" << std::endl;
+    }
+};
+
+// WHAT FUNCTION WILL IT BE? B OR C?
+/*
+
+Your interface or compiler will quickly warn you that it's impossible to tell.
+My VScode warned me with "Member 'whoisthatClass' found in multiple base classes
+of different typesclang(ambiguous_member_multiple_subobject_types)"
+
+There are two ways to fix this.
+
+1. Calling a function from the specific derived class ( B::whoisthatClass())
+2. Virtual inheritance    class B : virtual A
+
+In this chapter, I used the first one for the sake of convenience.
+
+*/
+
+class D : public B, public C {};
+
+// 4.1 COMPOSITION INSTEAD OF THE DIAMOND //
+/*
+
+Virtual inheritance keeps one A in D, but it is not free. B and C do not know
+where their A is (it depends on the most derived class), so every D carries
+pointers to virtual base tables and every access to A through a B, C or D
+reference first looks the offset up in one of them.
+
+ComposedD keeps the single A without any of that. D simply HAS an A, and the
+B and C behaviour comes from role classes that reach the A of their owner
+through a static_cast (CRTP), so the offset is known at compile time.
+Nothing is virtual, ComposedD is as big as its members.
+
+The catch: a ComposedD is not an A, B or C, you can not pass it where
+those are expected. When you need that, stay with D.
+
+*/
+
+template <typename Owner> class BRole {
+    public:
+    void whoisthatClass () {
+        std::cout << "It's B!" << std::endl;
+    }
+
+    A& base () {
+        return static_cast<Owner*> (this)->a;
+    }
+};
+
+template <typename Owner> class CRole {
+    public:
+    void whoisthatClass () {
+        std::cout << "It's C!" << std::endl;
+    }
+
+    A& base () {
+        return static_cast<Owner*> (this)->a;
+    }
+};
+
+class ComposedD : public BRole<ComposedD>, public CRole<ComposedD> {
+    public:
+    A a;
+};
+
+// 5. OBJECT SLICING //
+/*
+
+No, we are not calling the enemy fed Yasuo to destroy our object.
+Object slicing is an unfortunate side effect of upcasting a child class
+to the parent class. This destroys the values of the child class (SLICES them off)
+
+*/
+
+// NOTE: Parent Slicer sounds like a cool horror movie name.
+
+class ParentSlicerClass {
+    public:
+    int a = 4;
+    int b = 10;
+};
+
+class ClassToBeSliced : public ParentSlicerClass {
+    public:
+    int a = 8;
+    int b = 20;
+    int c = 15;
+    int d = 21;
+};
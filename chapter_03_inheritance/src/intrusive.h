@@ -0,0 +1,697 @@
+/*====# INTRUSIVE CONTAINERS #====*/
+/*
+
+std::list<VirtualDestructorClass*> allocates a node for every element, the
+node points to the object, the object lives somewhere else. Two allocations
+and two cache misses per element, and erasing an object needs its iterator.
+
+An intrusive container keeps the links IN the object. The class inherits a
+hook (ListHook, TreeHook) and the container only wires the hooks together:
+
+* insert and erase never allocate, the object is the node
+* erasing needs only the object, no iterator and no search
+* the container never owns anything, the objects are destroyed by whoever
+  created them (an Arena, a PolyCollection, the stack)
+
+Because the container does not own the objects, the hook mode decides what
+happens when the two disagree:
+
+* HOOK_NORMAL       - nothing is checked, erase leaves stale pointers behind,
+                      destroying a linked object corrupts the container
+* HOOK_SAFE_UNLINK  - erase resets the hook, linking a linked object,
+                      erasing an unlinked one or destroying a linked object
+                      is an assert (without asserts erase skips the object)
+* HOOK_AUTO_UNLINK  - like safe, and the destructor of the hook unlinks the
+                      object from whatever container it is in
+
+Since objects can leave on their own, size () counts the elements (O(n)),
+empty () is O(1). Pass a Tag to have one object in several containers.
+
+IntrusiveSet is a red-black tree (the algorithm std::set uses, with a
+header node holding root, leftmost and rightmost), ordered by KeyOf and
+allowing equal keys like std::multiset.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+/*==# DEFINES #==*/
+
+enum HookMode { HOOK_NORMAL = 0, HOOK_SAFE_UNLINK, HOOK_AUTO_UNLINK };
+
+/*==# CLASSES #==*/
+
+// 1. LIST //
+
+struct ListLinks {
+    ListLinks* prev = nullptr;
+    ListLinks* next = nullptr;
+};
+
+template <HookMode Mode = HOOK_SAFE_UNLINK, typename Tag = void> class ListHook : public ListLinks {
+
+    public:
+    static constexpr HookMode MODE = Mode;
+
+    ListHook () = default;
+
+    // A copy of an object is not in the containers of the original.
+    ListHook (const ListHook&) : ListLinks () {
+    }
+    ListHook& operator= (const ListHook&) {
+        return *this;
+    }
+
+    ~ListHook () {
+        if constexpr (Mode == HOOK_AUTO_UNLINK) {
+            unlink ();
+        } else if constexpr (Mode == HOOK_SAFE_UNLINK) {
+            assert (!isLinked () && "destroying an object that is still in an IntrusiveList");
+        }
+    }
+
+    // Only meaningful in the safe and auto modes.
+    bool isLinked () const {
+        return next != nullptr;
+    }
+
+    void unlink () {
+        if (Mode != HOOK_NORMAL && !isLinked ()) {
+            return;
+        }
+        prev->next = next;
+        next->prev = prev;
+        if constexpr (Mode != HOOK_NORMAL) {
+            prev = next = nullptr;
+        }
+    }
+};
+
+template <typename T, typename Hook = ListHook<>> class IntrusiveList {
+
+    private:
+    static_assert (std::is_base_of_v<Hook, T>, "T must inherit the Hook");
+
+    ListLinks head; // sentinel, the list is a ring through it
+
+    static T& object (ListLinks* links) {
+        return static_cast<T&> (static_cast<Hook&> (*links));
+    }
+
+    static void linkBefore (ListLinks* position, Hook& hook) {
+        assert ((Hook::MODE == HOOK_NORMAL || !hook.isLinked ()) && "object already in a list");
+        hook.prev            = position->prev;
+        hook.next            = position;
+        position->prev->next = &hook;
+        position->prev       = &hook;
+    }
+
+    public:
+    class iterator {
+        private:
+        ListLinks* links;
+
+        public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = T*;
+        using reference         = T&;
+
+        iterator () : links (nullptr) {
+        }
+        explicit iterator (ListLinks* position) : links (position) {
+        }
+
+        T& operator* () const {
+            return object (links);
+        }
+        T* operator-> () const {
+            return &object (links);
+        }
+        iterator& operator++ () {
+            links = links->next;
+            return *this;
+        }
+        iterator operator++ (int) {
+            iterator old = *this;
+            links        = links->next;
+            return old;
+        }
+        iterator& operator-- () {
+            links = links->prev;
+            return *this;
+        }
+        bool operator== (const iterator& other) const {
+            return links == other.links;
+        }
+
+        friend class IntrusiveList;
+    };
+
+    IntrusiveList () {
+        head.prev = head.next = &head;
+    }
+
+    ~IntrusiveList () {
+        clear ();
+    }
+
+    IntrusiveList (const IntrusiveList&)            = delete;
+    IntrusiveList& operator= (const IntrusiveList&) = delete;
+
+    void push_back (T& value) {
+        linkBefore (&head, value);
+    }
+
+    void push_front (T& value) {
+        linkBefore (head.next, value);
+    }
+
+    iterator insert (iterator position, T& value) {
+        linkBefore (position.links, value);
+        return iterator (static_cast<Hook*> (&value));
+    }
+
+    // O(1), the object knows its neighbours.
+    void erase (T& value) {
+        Hook& hook = value;
+        assert ((Hook::MODE == HOOK_NORMAL || hook.isLinked ()) && "erasing an object that is in no list");
+        hook.unlink ();
+    }
+
+    iterator erase (iterator position) {
+        iterator next (position.links->next);
+        erase (*position);
+        return next;
+    }
+
+    void pop_front () {
+        erase (front ());
+    }
+
+    void pop_back () {
+        erase (back ());
+    }
+
+    T& front () {
+        return object (head.next);
+    }
+
+    T& back () {
+        return object (head.prev);
+    }
+
+    bool empty () const {
+        return head.next == &head;
+    }
+
+    std::size_t size () const {
+        std::size_t count = 0;
+        for (const ListLinks* links = head.next; links != &head; links = links->next) {
+            ++count;
+        }
+        return count;
+    }
+
+    // Unlinks everything, the objects stay alive.
+    void clear () {
+        if constexpr (Hook::MODE != HOOK_NORMAL) {
+            while (!empty ()) {
+                pop_front ();
+            }
+        }
+        head.prev = head.next = &head;
+    }
+
+    iterator begin () {
+        return iterator (head.next);
+    }
+
+    iterator end () {
+        return iterator (&head);
+    }
+};
+
+// 2. RED-BLACK TREE //
+
+struct TreeLinks {
+    TreeLinks* parent = nullptr;
+    TreeLinks* left   = nullptr;
+    TreeLinks* right  = nullptr;
+    bool red          = false;
+    bool header       = false;
+};
+
+namespace intrusive {
+
+inline TreeLinks* minimum (TreeLinks* node) {
+    while (node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+inline TreeLinks* maximum (TreeLinks* node) {
+    while (node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+// In order successor, the successor of the rightmost node is the header.
+inline TreeLinks* next (TreeLinks* node) {
+    if (node->right) {
+        return minimum (node->right);
+    }
+    TreeLinks* parent = node->parent;
+    while (node == parent->right) {
+        node   = parent;
+        parent = parent->parent;
+    }
+    return node->right != parent ? parent : node;
+}
+
+inline void rotateLeft (TreeLinks* x, TreeLinks*& root) {
+    TreeLinks* y = x->right;
+    x->right     = y->left;
+    if (y->left) {
+        y->left->parent = x;
+    }
+    y->parent = x->parent;
+    if (x == root) {
+        root = y;
+    } else if (x == x->parent->left) {
+        x->parent->left = y;
+    } else {
+        x->parent->right = y;
+    }
+    y->left   = x;
+    x->parent = y;
+}
+
+inline void rotateRight (TreeLinks* x, TreeLinks*& root) {
+    TreeLinks* y = x->left;
+    x->left      = y->right;
+    if (y->right) {
+        y->right->parent = x;
+    }
+    y->parent = x->parent;
+    if (x == root) {
+        root = y;
+    } else if (x == x->parent->right) {
+        x->parent->right = y;
+    } else {
+        x->parent->left = y;
+    }
+    y->right  = x;
+    x->parent = y;
+}
+
+// Links x as the left or right child of parent and restores the colours.
+inline void insertAndRebalance (bool insert_left, TreeLinks* x, TreeLinks* parent, TreeLinks& header) {
+    TreeLinks*& root = header.parent;
+    x->parent        = parent;
+    x->left = x->right = nullptr;
+    x->red             = true;
+
+    if (insert_left) {
+        parent->left = x;
+        if (parent == &header) {
+            header.parent = x;
+            header.right  = x;
+        } else if (parent == header.left) {
+            header.left = x;
+        }
+    } else {
+        parent->right = x;
+        if (parent == header.right) {
+            header.right = x;
+        }
+    }
+
+    while (x != root && x->parent->red) {
+        TreeLinks* grandparent = x->parent->parent;
+        if (x->parent == grandparent->left) {
+            TreeLinks* uncle = grandparent->right;
+            if (uncle && uncle->red) {
+                x->parent->red   = false;
+                uncle->red       = false;
+                grandparent->red = true;
+                x                = grandparent;
+            } else {
+                if (x == x->parent->right) {
+                    x = x->parent;
+                    rotateLeft (x, root);
+                }
+                x->parent->red   = false;
+                grandparent->red = true;
+                rotateRight (grandparent, root);
+            }
+        } else {
+            TreeLinks* uncle = grandparent->left;
+            if (uncle && uncle->red) {
+                x->parent->red   = false;
+                uncle->red       = false;
+                grandparent->red = true;
+                x                = grandparent;
+            } else {
+                if (x == x->parent->left) {
+                    x = x->parent;
+                    rotateRight (x, root);
+                }
+                x->parent->red   = false;
+                grandparent->red = true;
+                rotateLeft (grandparent, root);
+            }
+        }
+    }
+    root->red = false;
+}
+
+inline bool isBlack (const TreeLinks* node) {
+    return !node || !node->red;
+}
+
+// Takes z out of the tree and restores the colours.
+inline void eraseAndRebalance (TreeLinks* z, TreeLinks& header) {
+    TreeLinks*& root      = header.parent;
+    TreeLinks*& leftmost  = header.left;
+    TreeLinks*& rightmost = header.right;
+    TreeLinks* y          = z;
+    TreeLinks* x          = nullptr;
+    TreeLinks* x_parent   = nullptr;
+
+    if (!y->left) {
+        x = y->right;
+    } else if (!y->right) {
+        x = y->left;
+    } else {
+        y = minimum (y->right); // z has two children, y is its successor
+        x = y->right;
+    }
+
+    if (y != z) {
+        // y takes the place of z.
+        z->left->parent = y;
+        y->left         = z->left;
+        if (y != z->right) {
+            x_parent = y->parent;
+            if (x) {
+                x->parent = y->parent;
+            }
+            y->parent->left  = x;
+            y->right         = z->right;
+            z->right->parent = y;
+        } else {
+            x_parent = y;
+        }
+        if (root == z) {
+            root = y;
+        } else if (z->parent->left == z) {
+            z->parent->left = y;
+        } else {
+            z->parent->right = y;
+        }
+        y->parent = z->parent;
+        std::swap (y->red, z->red);
+        y = z; // y is the removed position now
+    } else {
+        x_parent = y->parent;
+        if (x) {
+            x->parent = y->parent;
+        }
+        if (root == z) {
+            root = x;
+        } else if (z->parent->left == z) {
+            z->parent->left = x;
+        } else {
+            z->parent->right = x;
+        }
+        if (leftmost == z) {
+            leftmost = z->right ? minimum (x) : z->parent;
+        }
+        if (rightmost == z) {
+            rightmost = z->left ? maximum (x) : z->parent;
+        }
+    }
+
+    if (!y->red) {
+        while (x != root && isBlack (x)) {
+            if (x == x_parent->left) {
+                TreeLinks* sibling = x_parent->right;
+                if (sibling->red) {
+                    sibling->red  = false;
+                    x_parent->red = true;
+                    rotateLeft (x_parent, root);
+                    sibling = x_parent->right;
+                }
+                if (isBlack (sibling->left) && isBlack (sibling->right)) {
+                    sibling->red = true;
+                    x            = x_parent;
+                    x_parent     = x_parent->parent;
+                } else {
+                    if (isBlack (sibling->right)) {
+                        sibling->left->red = false;
+                        sibling->red       = true;
+                        rotateRight (sibling, root);
+                        sibling = x_parent->right;
+                    }
+                    sibling->red  = x_parent->red;
+                    x_parent->red = false;
+                    if (sibling->right) {
+                        sibling->right->red = false;
+                    }
+                    rotateLeft (x_parent, root);
+                    break;
+                }
+            } else {
+                TreeLinks* sibling = x_parent->left;
+                if (sibling->red) {
+                    sibling->red  = false;
+                    x_parent->red = true;
+                    rotateRight (x_parent, root);
+                    sibling = x_parent->left;
+                }
+                if (isBlack (sibling->right) && isBlack (sibling->left)) {
+                    sibling->red = true;
+                    x            = x_parent;
+                    x_parent     = x_parent->parent;
+                } else {
+                    if (isBlack (sibling->left)) {
+                        sibling->right->red = false;
+                        sibling->red        = true;
+                        rotateLeft (sibling, root);
+                        sibling = x_parent->left;
+                    }
+                    sibling->red  = x_parent->red;
+                    x_parent->red = false;
+                    if (sibling->left) {
+                        sibling->left->red = false;
+                    }
+                    rotateRight (x_parent, root);
+                    break;
+                }
+            }
+        }
+        if (x) {
+            x->red = false;
+        }
+    }
+}
+
+// The header of the tree a linked node is in, found through the parents.
+inline TreeLinks* headerOf (TreeLinks* node) {
+    while (!node->header) {
+        node = node->parent;
+    }
+    return node;
+}
+
+} // namespace intrusive
+
+template <HookMode Mode = HOOK_SAFE_UNLINK, typename Tag = void> class TreeHook : public TreeLinks {
+
+    public:
+    static constexpr HookMode MODE = Mode;
+
+    TreeHook () = default;
+
+    TreeHook (const TreeHook&) : TreeLinks () {
+    }
+    TreeHook& operator= (const TreeHook&) {
+        return *this;
+    }
+
+    ~TreeHook () {
+        if constexpr (Mode == HOOK_AUTO_UNLINK) {
+            unlink ();
+        } else if constexpr (Mode == HOOK_SAFE_UNLINK) {
+            assert (!isLinked () && "destroying an object that is still in an IntrusiveSet");
+        }
+    }
+
+    // Only meaningful in the safe and auto modes.
+    bool isLinked () const {
+        return parent != nullptr;
+    }
+
+    // O(log n), the tree is found by walking up to its header.
+    void unlink () {
+        if (isLinked ()) {
+            intrusive::eraseAndRebalance (this, *intrusive::headerOf (this));
+            parent = left = right = nullptr;
+        }
+    }
+};
+
+template <typename T, typename KeyOf, typename Hook = TreeHook<>> class IntrusiveSet {
+
+    private:
+    static_assert (std::is_base_of_v<Hook, T>, "T must inherit the Hook");
+
+    TreeLinks header; // parent = root, left = leftmost, right = rightmost
+    KeyOf key_of;
+
+    static T& object (TreeLinks* links) {
+        return static_cast<T&> (static_cast<Hook&> (*links));
+    }
+
+    public:
+    class iterator {
+        private:
+        TreeLinks* links;
+
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = T*;
+        using reference         = T&;
+
+        iterator () : links (nullptr) {
+        }
+        explicit iterator (TreeLinks* position) : links (position) {
+        }
+
+        T& operator* () const {
+            return object (links);
+        }
+        T* operator-> () const {
+            return &object (links);
+        }
+        iterator& operator++ () {
+            links = intrusive::next (links);
+            return *this;
+        }
+        iterator operator++ (int) {
+            iterator old = *this;
+            links        = intrusive::next (links);
+            return old;
+        }
+        bool operator== (const iterator& other) const {
+            return links == other.links;
+        }
+
+        friend class IntrusiveSet;
+    };
+
+    explicit IntrusiveSet (KeyOf key_function = KeyOf ()) : key_of (key_function) {
+        header.header = true;
+        header.left = header.right = &header;
+    }
+
+    ~IntrusiveSet () {
+        clear ();
+    }
+
+    IntrusiveSet (const IntrusiveSet&)            = delete;
+    IntrusiveSet& operator= (const IntrusiveSet&) = delete;
+
+    // Equal keys go after the ones already there.
+    iterator insert (T& value) {
+        Hook& hook = value;
+        assert ((Hook::MODE == HOOK_NORMAL || !hook.isLinked ()) && "object already in a set");
+        const auto& key   = key_of (value);
+        TreeLinks* parent = &header;
+        TreeLinks* node   = header.parent;
+        bool left         = true;
+        while (node) {
+            parent = node;
+            left   = key < key_of (object (node));
+            node   = left ? node->left : node->right;
+        }
+        intrusive::insertAndRebalance (left, &hook, parent, header);
+        return iterator (&hook);
+    }
+
+    // O(log n) rebalancing, no search.
+    void erase (T& value) {
+        Hook& hook = value;
+        assert ((Hook::MODE == HOOK_NORMAL || hook.isLinked ()) && "erasing an object that is in no set");
+        if (Hook::MODE != HOOK_NORMAL && !hook.isLinked ()) {
+            return;
+        }
+        intrusive::eraseAndRebalance (&hook, header);
+        if constexpr (Hook::MODE != HOOK_NORMAL) {
+            hook.parent = hook.left = hook.right = nullptr;
+        }
+    }
+
+    template <typename Key> iterator lowerBound (const Key& key) {
+        TreeLinks* result = &header;
+        TreeLinks* node   = header.parent;
+        while (node) {
+            if (key_of (object (node)) < key) {
+                node = node->right;
+            } else {
+                result = node;
+                node   = node->left;
+            }
+        }
+        return iterator (result);
+    }
+
+    template <typename Key> iterator find (const Key& key) {
+        iterator found = lowerBound (key);
+        return found == end () || key < key_of (*found) ? end () : found;
+    }
+
+    bool empty () const {
+        return header.parent == nullptr;
+    }
+
+    std::size_t size () {
+        std::size_t count = 0;
+        for (iterator it = begin (); it != end (); ++it) {
+            ++count;
+        }
+        return count;
+    }
+
+    // Unlinks everything, the objects stay alive.
+    void clear () {
+        if constexpr (Hook::MODE != HOOK_NORMAL) {
+            while (!empty ()) {
+                erase (*begin ());
+            }
+        }
+        header.parent = nullptr;
+        header.left = header.right = &header;
+    }
+
+    iterator begin () {
+        return iterator (header.left);
+    }
+
+    iterator end () {
+        return iterator (&header);
+    }
+};
@@ -64,6 +64,19 @@ These entries are pointers to the most derived function that the current object
 
 /*==# INCLUDES #==*/
 #include <iostream>
+#include <string>
+
+#include "arena.h"
+#include "arena_clone.h"
+#include "bench_metrics.h"
+#include "call_profile.h"
+#include "double_dispatch.h"
+#include "flat_format.h"
+#include "inheritance.h"
+#include "intrusive.h"
+#include "poly_collection.h"
+#include "poly_value.h"
+#include "sliced_columns.h"
 
 /*==# DEFINES #==*/
 
@@ -76,246 +89,300 @@ These entries are pointers to the most derived function that the current object
 
 /*==# GLOBAL FUNCTIONS #==*/
 
-/*==# CLASSES #==*/
-
-// 1. INTERFACE //
-/*
-
-C++ by itself has no real concept of interfaces so
-we can only achieve that using a purely abstract class.
-
-ConcreteClass implements the abstract class AbstractInterface
-and creates the fucntions.
-
-*/
-
-class AbstractInterface {
-
-    public:
-    virtual char returnChar ()  = 0;
-    virtual int returnNumber () = 0;
-};
-
-class ConcreteClass : AbstractInterface {
-
-    public:
-    char returnChar () {
-        return 'e';
-    }
-
-    int returnNumber () {
-        return 15;
+/*==# SCENARIOS #==*/
+/* Scenarios 1 to 5, one at a time, for main and --bench. */
+static void runScenario (int scenario) {
+    switch (scenario) {
+    case 1: {
+        /*==# SCENARIO 1 #==*/
+        // Testing the Interface inheritance
+
+        ConcreteClass InterfaceTest;
+
+        std::cout << std::endl << "## SCENARIO 1 ##" << std::endl;
+        std::cout << "ConcreteClass.returnChar = " << InterfaceTest.returnChar ()
+                  << " (expecting 'e')" << std::endl;
+        std::cout << "ConcreteClass.returnNumber = " << InterfaceTest.returnNumber ()
+                  << " (expecting '15')" << std::endl;
+
+        StaticConcreteClass StaticInterfaceTest;
+
+        std::cout << "StaticConcreteClass.returnChar = " << StaticInterfaceTest.returnChar ()
+                  << " (expecting 'e', no vtable)" << std::endl;
+        std::cout << "StaticConcreteClass.returnNumber = " << StaticInterfaceTest.returnNumber ()
+                  << " (expecting '15', no vtable)" << std::endl;
+        std::cout << "sizeof (ConcreteClass) = " << sizeof (ConcreteClass)
+                  << ", sizeof (StaticConcreteClass) = " << sizeof (StaticConcreteClass)
+                  << " (expecting the vptr to be gone)" << std::endl;
+
+        PolyValue<AbstractInterface> held{ ConcreteClass () };
+        PolyValue<AbstractInterface> held_copy = held;
+
+        std::cout << "PolyValue copy.returnNumber = " << held_copy.returnNumber ()
+                  << ", inline = " << held_copy.isInline ()
+                  << " (expecting '15' and 1, copied without slicing or new)" << std::endl;
+
+        // One virtual call for a whole run of ConcreteClass objects.
+        ConcreteClass batch[3];
+        AbstractInterface* batch_objects[3] = { &batch[0], &batch[1], &batch[2] };
+        int batch_numbers[3]                = {};
+        returnNumbers (batch_objects, batch_numbers);
+
+        std::cout << "returnNumbers (3 x ConcreteClass) = " << batch_numbers[0] << ", "
+                  << batch_numbers[1] << ", " << batch_numbers[2] << " (expecting '15' three times)"
+                  << std::endl;
+        break;
     }
-};
-
-// 2. VIRTUAL DESTRUCTOR //
-/*
+    case 2: {
+        /*==# SCENARIO 2 #==*/
+        // Testing virtual destructor
 
-A virtual destructor is a very helpful method of properly destroying the object.
-Making the base class destructor virtual guarantees that the object of derived class
-is destructed properly (both base class and derived class destructors are called)
+        VirtualDestructorClass* virtualdestructor = new VirtualDestructorClass ();
+        SubClass_VirtualDestructor* sub_virtualdestructor = new SubClass_VirtualDestructor ();
 
-*/
-
-class VirtualDestructorClass {
-    public:
-    virtual ~VirtualDestructorClass () {
-        std::cout << "VirtualDestructorClass destructor! I am the big boy." << std::endl;
-    }
-};
-
-class SubClass_VirtualDestructor : VirtualDestructorClass {
-    public:
-    ~SubClass_VirtualDestructor () {
+        std::cout << std::endl << "## SCENARIO 2 ##" << std::endl;
         std::cout
-        << "SubClass_VirtualDestructor destructor! I wish I was the big boy."
+        << "1. Destroying VirtualDestructorClass. Expecting only destructor." << std::endl
         << std::endl;
-    }
-};
-
-// 3. POLYMORPHISM AND OVERRIDING //
-/*
-
-Very simply put, overriding is just a form of polymorphism. All overriding really does is
-well... override an existing function from the parent class and replace it.
-
-The override keyword does just that, but allows us to override virtual functions.
-It also serves as a simple check if you are... in fact... overriding something.
-
-Pretty cool, right?
-
-*/
-
-class PolymorphicClass {
-    public:
-    virtual bool isFiveStar () {
-        return true;
-    }
-    void sayLine () {
-        std::cout << "I am the peak of function evolution." << std::endl;
-    }
-};
-
-class OverridingClass : PolymorphicClass {
-    public:
-    virtual bool isFiveStar () override {
-        return false;
-    }
+        delete virtualdestructor;
+        std::cout << std::endl;
+        std::cout << "2. Destroying SubClass_VirtualDestructor. Expecting this "
+                     "destructor and parent destructor."
+                  << std::endl
+                  << std::endl;
+        delete sub_virtualdestructor;
 
-    void sayLine () {
-        std::cout << "I'm not just like the rest of you. I'm stronger. I'm "
-                     "smarter. I'm better. I AM BETTER."
+        std::cout << std::endl;
+        std::cout << "3. Destroying both from an Arena in one pass. Expecting the "
+                     "subclass destructors first, newest object first."
+                  << std::endl
                   << std::endl;
+        {
+            Arena arena;
+            arena.create<VirtualDestructorClass> ();
+            arena.create<SubClass_VirtualDestructor> ();
+            arena.reset ();
+        }
+
+        std::cout << std::endl;
+        std::cout << "4. Deleting an object that is in an intrusive list. Expecting it "
+                     "to leave the list on its own."
+                  << std::endl
+                  << std::endl;
+        {
+            IntrusiveList<TrackedDestructorClass, ListHook<HOOK_AUTO_UNLINK>> tracked;
+            TrackedDestructorClass* first  = new TrackedDestructorClass ();
+            TrackedDestructorClass* second = new TrackedDestructorClass ();
+            tracked.push_back (*first);
+            tracked.push_back (*second);
+            delete first;
+            std::cout << "tracked.size = " << tracked.size () << " (expecting 1)" << std::endl;
+            delete second;
+            std::cout << "tracked.empty = " << tracked.empty () << " (expecting 1)" << std::endl;
+        }
+        break;
     }
-};
-
-// 4. DIAMOND INHERITANCE PROBLEM (a.k.a why I love C more) //
-/*
-
-OOP and inheritance can be helpful, sure. But then comes the scary topic of one class
-inheriting from multiple classes, which inherit from one base class (diamond shape yeah)
-
-
-*/
-
-class A {
-    public:
-    void whoisthatClass () {
-        std::cout << "It's A!" << std::endl;
+    case 3: {
+        /*==# SCENARIO 3 #==*/
+        // Polymorphism
+
+        PolymorphicClass polymorphism;
+        OverridingClass override;
+
+        std::cout << std::endl << "## SCENARIO 3 ##" << std::endl;
+        std::cout << "PolymorphicClass.isFiveStar = " << polymorphism.isFiveStar ()
+                  << " (expecting 1)" << std::endl;
+        std::cout << "PolymorphicClass.sayLine = ";
+        polymorphism.sayLine ();
+        std::cout << " (expecting gloating)" << std::endl;
+
+        std::cout << "OverridingClass.isFiveStar = " << override.isFiveStar ()
+                  << " (expecting 0)" << std::endl;
+        std::cout << "OverridingClass.sayLine = ";
+        override.sayLine ();
+        std::cout << " (expecting Homelander's breakdown)" << std::endl;
+
+        PolyCollection<PolymorphicClass> collection;
+        collection.insert (polymorphism);
+        collection.insert (override);
+        collection.insert (polymorphism);
+
+        int five_stars = 0;
+        collection.forEach<PolymorphicClass, OverridingClass> (
+        [&five_stars] (auto& object) { five_stars += object.isFiveStar (); });
+
+        std::cout << "PolyCollection buckets = " << collection.bucketCount ()
+                  << ", five stars = " << five_stars << " (expecting 2 and 2)" << std::endl;
+
+        // What happens when two of them meet depends on BOTH dynamic types.
+        DoubleDispatcher<PolymorphicClass, const char*> meet (
+        [] (PolymorphicClass&, PolymorphicClass&) { return "nothing happens"; });
+        meet.add<PolymorphicClass, OverridingClass> (
+        [] (PolymorphicClass&, OverridingClass&) { return "gloating"; });
+        meet.add<OverridingClass, OverridingClass> (
+        [] (OverridingClass&, OverridingClass&) { return "a breakdown"; });
+
+        PolymorphicClass& someone      = polymorphism;
+        PolymorphicClass& someone_else = override;
+        std::cout << "meet (PolymorphicClass, OverridingClass) = " << meet (someone, someone_else)
+                  << " (expecting gloating)" << std::endl;
+        std::cout << "meet (OverridingClass, PolymorphicClass) = " << meet (someone_else, someone)
+                  << " (expecting gloating, the handler is symmetric)" << std::endl;
+        std::cout << "meet (OverridingClass, OverridingClass) = " << meet (someone_else, someone_else)
+                  << " (expecting a breakdown)" << std::endl;
+        std::cout << "meet (PolymorphicClass, PolymorphicClass) = " << meet (someone, someone)
+                  << " (expecting nothing happens, the fallback)" << std::endl;
+        break;
     }
-};
-
-class B : virtual public A {
-    public:
-    void whoisthatClass () {
-        std::cout << "It's B!" << std::endl;
+    case 4: {
+        /*==# SCENARIO 4 #==*/
+        // Diamond inheritance problem
+
+        D inheritance;
+
+        std::cout << std::endl << "## SCENARIO 4 ##" << std::endl;
+        std::cout << "1. Calling B.whoisthisClass (inherited)" << std::endl;
+        inheritance.B::whoisthatClass ();
+        std::cout << "2. Calling C.whoisthisClass (inherited)" << std::endl;
+        inheritance.C::whoisthatClass ();
+
+        ComposedD composition;
+
+        std::cout << "3. Calling the B and C roles of ComposedD (one A, no virtual base)" << std::endl;
+        composition.BRole::whoisthatClass ();
+        composition.CRole::whoisthatClass ();
+        std::cout << "sizeof (D) = " << sizeof (D) << ", sizeof (ComposedD) = " << sizeof (ComposedD)
+                  << " (expecting the virtual base pointers to be gone)" << std::endl;
+        break;
     }
-};
-
-class C : virtual public A {
-    public:
-    void whoisthatClass () {
-        std::cout << "It's C!" << std::endl;
+    default: {
+        /*==# SCENARIO 5 #==*/
+        // Object slicing
+        std::cout << std::endl << "## SCENARIO 5 ##" << std::endl;
+
+        ClassToBeSliced sliced;
+        ParentSlicerClass slicer = sliced;
+
+        std::cout << "ParentSlicerClass.a = " << slicer.a << " (expecting 4)" << std::endl;
+        std::cout << "ParentSlicerClass.b = " << slicer.b << " (expecting 10)" << std::endl;
+
+        // UNCOMMENT TO TEST
+        // std::cout << "ParentSlicerClass.c = " << slicer.c;
+        // std::cout << "ParentSlicerClass.c = " << slicer.d;
+
+        // A polymorphic copy keeps what a plain copy slices off.
+        OverridingClass override;
+        Arena clone_arena;
+        PolymorphicClass& overriding_as_base = override;
+        PolymorphicClass* cloned             = cloneGraph (&overriding_as_base, clone_arena);
+
+        std::cout << "cloneGraph (OverridingClass as PolymorphicClass).isFiveStar = "
+                  << cloned->isFiveStar () << " (expecting 0, no slicing)" << std::endl;
+
+        // Column by column, nothing is sliced either, the parent's a and b are columns too.
+        ClassToBeSliced rows[3];
+        rows[2].c = 30;
+        ColumnTable<ClassToBeSliced> table{ std::span<const ClassToBeSliced> (rows) };
+
+        std::cout << "ColumnTable sum (c) = " << columns::sum (table.column (SLICED_C))
+                  << ", max (c) = " << columns::max (table.column (SLICED_C))
+                  << " (expecting 60 and 30)" << std::endl;
+        std::cout << "ColumnTable row (0).ParentSlicerClass::a = "
+                  << table.row (0).ParentSlicerClass::a << " (expecting 4)" << std::endl;
+
+        // Through the flat format, the tag keeps the type and the buffer keeps every field.
+        FlatBuilder builder;
+        builder.add (overriding_as_base);
+        builder.add (rows[2]);
+        const std::vector<std::byte> buffer = builder.finish ();
+        const FlatReader reader (buffer);
+
+        std::cout << "FlatReader (0) is OverridingClass = " << reader.is<OverridingClass> (0)
+                  << ", (1) as ParentSlicerClass a = " << reader.get<ParentSlicerClass> (1).field (0)
+                  << ", as ClassToBeSliced c = " << reader.get<ClassToBeSliced> (1).field (SLICED_C)
+                  << " (expecting 1, 4 and 30)" << std::endl;
+        break;
     }
-};
-
-// WHAT FUNCTION WILL IT BE? B OR C?
-/*
-
-Your interface or compiler will quickly warn you that it's impossible to tell.
-My VScode warned me with "Member 'whoisthatClass' found in multiple base classes
-of different typesclang(ambiguous_member_multiple_subobject_types)"
-
-There are two ways to fix this.
-
-1. Calling a function from the specific derived class ( B::whoisthatClass())
-2. Virtual inheritance    class B : virtual A
-
-In this chapter, I used the first one for the sake of convenience.
-
-*/
-
-class D : public B, public C {};
-
-// 5. OBJECT SLICING //
-/*
-
-No, we are not calling the enemy fed Yasuo to destroy our object.
-Object slicing is an unfortunate side effect of upcasting a child class
-to the parent class. This destroys the values of the child class (SLICES them off)
-
-*/
-
-// NOTE: Parent Slicer sounds like a cool horror movie name.
-
-class ParentSlicerClass {
-    public:
-    int a = 4;
-    int b = 10;
-};
-
-class ClassToBeSliced : public ParentSlicerClass {
-    public:
-    int a = 8;
-    int b = 20;
-    int c = 15;
-    int d = 21;
-};
-
-int main () {
-
-    /*==# SCENARIO 1 #==*/
-    // Testing the Interface inheritance
-
-    ConcreteClass InterfaceTest;
-
-    std::cout << std::endl << "## SCENARIO 1 ##" << std::endl;
-    std::cout << "ConcreteClass.returnChar = " << InterfaceTest.returnChar ()
-              << " (expecting 'e')" << std::endl;
-    std::cout << "ConcreteClass.returnNumber = " << InterfaceTest.returnNumber ()
-              << " (expecting '15')" << std::endl;
-
-    /*==# SCENARIO 2 #==*/
-    // Testing virtual destructor
-
-    VirtualDestructorClass* virtualdestructor = new VirtualDestructorClass ();
-    SubClass_VirtualDestructor* sub_virtualdestructor = new SubClass_VirtualDestructor ();
-
-    std::cout << std::endl << "## SCENARIO 2 ##" << std::endl;
-    std::cout
-    << "1. Destroying VirtualDestructorClass. Expecting only destructor." << std::endl
-    << std::endl;
-    delete virtualdestructor;
-    std::cout << std::endl;
-    std::cout << "2. Destroying SubClass_VirtualDestructor. Expecting this "
-                 "destructor and parent destructor."
-              << std::endl
-              << std::endl;
-    delete sub_virtualdestructor;
+    }
+}
 
-    /*==# SCENARIO 3 #==*/
-    // Polymorphism
+/*==# BENCH #==*/
+/* Run with --bench [--json] [operations] [--runs N] for the time, allocations and counters of every scenario. */
+/* cmake/bench_compare.cmake compares the --json output against a baseline, ./init.sh bench-check runs it. */
+BENCH_COUNT_ALLOCATIONS ();
+
+int benchScenarios (int argc, char** argv) {
+    bench::ScenarioBench bench ("Chapter_03", argc, argv);
+    bench::SilencedStream quiet (std::cout); // the scenarios log a lot
+
+    bench.add ("1. interface inheritance", [] () { runScenario (1); });
+    bench.add ("2. virtual destructor", [] () { runScenario (2); });
+    bench.add ("3. polymorphism", [] () { runScenario (3); });
+    bench.add ("4. diamond inheritance", [] () { runScenario (4); });
+    bench.add ("5. object slicing", [] () { runScenario (5); });
+
+    // The single operations the scenarios are made of
+    const PolyValue<AbstractInterface> held{ ConcreteClass () };
+    bench.add ("PolyValue copy", [&held] () {
+        PolyValue<AbstractInterface> held_copy = held;
+        bench::doNotOptimize (held_copy);
+    });
+    bench.add ("new + delete, virtual destructor", [] () {
+        VirtualDestructorClass* object = new SubClass_VirtualDestructor ();
+        bench::doNotOptimize (object);
+        delete object;
+    });
 
     PolymorphicClass polymorphism;
     OverridingClass override;
+    PolymorphicClass* someone[2] = { &polymorphism, &override };
+    std::size_t turn             = 0;
+    bench.add ("isFiveStar, virtual call", [&someone, &turn] () {
+        PolymorphicClass* object = someone[turn++ & 1];
+        bench::doNotOptimize (object);
+        bool five_star = object->isFiveStar ();
+        bench::doNotOptimize (five_star);
+    });
+
+    DoubleDispatcher<PolymorphicClass, const char*> meet (
+    [] (PolymorphicClass&, PolymorphicClass&) { return "nothing happens"; });
+    meet.add<PolymorphicClass, OverridingClass> (
+    [] (PolymorphicClass&, OverridingClass&) { return "gloating"; });
+    bench.add ("double dispatch", [&] () {
+        const char* outcome = meet (*someone[turn & 1], *someone[(turn + 1) & 1]);
+        ++turn;
+        bench::doNotOptimize (outcome);
+    });
+
+    Arena clone_arena;
+    bench.add ("cloneGraph into an Arena", [&] () {
+        PolymorphicClass* cloned = cloneGraph (someone[1], clone_arena);
+        bench::doNotOptimize (cloned);
+        clone_arena.reset ();
+    });
+
+    ClassToBeSliced row;
+    bench.add ("FlatBuilder, two objects", [&] () {
+        FlatBuilder builder;
+        builder.add (*someone[1]);
+        builder.add (row);
+        const std::vector<std::byte> buffer = builder.finish ();
+        bench::doNotOptimize (buffer.data ());
+    });
+    return bench.finish ();
+}
 
-    std::cout << std::endl << "## SCENARIO 3 ##" << std::endl;
-    std::cout << "PolymorphicClass.isFiveStar = " << polymorphism.isFiveStar ()
-              << " (expecting 1)" << std::endl;
-    std::cout << "PolymorphicClass.sayLine = ";
-    polymorphism.sayLine ();
-    std::cout << " (expecting gloating)" << std::endl;
-
-    std::cout << "OverridingClass.isFiveStar = " << override.isFiveStar ()
-              << " (expecting 0)" << std::endl;
-    std::cout << "OverridingClass.sayLine = ";
-    override.sayLine ();
-    std::cout << " (expecting Homelander's breakdown)" << std::endl;
-
-    /*==# SCENARIO 4 #==*/
-    // Diamond inheritance problem
-
-    D inheritance;
-
-    std::cout << std::endl << "## SCENARIO 4 ##" << std::endl;
-    std::cout << "1. Calling B.whoisthisClass (inherited)" << std::endl;
-    inheritance.B::whoisthatClass ();
-    std::cout << "2. Calling C.whoisthisClass (inherited)" << std::endl;
-    inheritance.C::whoisthatClass ();
-
-    /*==# SCENARIO 5 #==*/
-    // Object slicing
-    std::cout << std::endl << "## SCENARIO 5 ##" << std::endl;
-
-    ClassToBeSliced sliced;
-    ParentSlicerClass slicer = sliced;
+int main (int argc, char** argv) {
+    if (argc > 1 && std::string (argv[1]) == "--bench") {
+        return benchScenarios (argc, argv);
+    }
 
-    std::cout << "ParentSlicerClass.a = " << slicer.a << " (expecting 4)" << std::endl;
-    std::cout << "ParentSlicerClass.b = " << slicer.b << " (expecting 10)" << std::endl;
+    for (int scenario = 1; scenario <= 5; ++scenario) {
+        runScenario (scenario);
+    }
 
-    // UNCOMMENT TO TEST
-    // std::cout << "ParentSlicerClass.c = " << slicer.c;
-    // std::cout << "ParentSlicerClass.c = " << slicer.d;
+    // Only prints with -DCHAPTER_03_PROFILE_CALLS=ON
+    CALL_PROFILE_REPORT ();
 
     /*==# THE END #==*/
     return 0;
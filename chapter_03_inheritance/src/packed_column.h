@@ -0,0 +1,315 @@
+/*====# PACKED COLUMN #====*/
+/*
+
+The int columns of ClassToBeSliced hold small numbers (4, 10, 8, 20, 15, 21
+by default), 32 bits each is mostly zeros. PackedColumn compresses one column
+with frame of reference + bit packing:
+
+* the column is cut into blocks of 256 values
+* every block stores its minimum (the reference) and the bit width of the
+  largest value - reference
+* every value is stored as value - reference in exactly that many bits
+
+The bits are laid out for 8 lane SIMD: value i of a block goes to lane i % 8,
+each lane packs its 32 values into width words, and the words of the 8 lanes
+are interleaved. One AVX2 load then brings in the bits of 8 consecutive
+values, a shift and a mask per step decode them, no lane ever has to talk to
+another one.
+
+The aggregations run over the packed blocks, nothing is decoded into
+memory: sum and max decode 8 values at a time into a register. min is the
+smallest reference, it does not have to decode at all.
+Without COLUMN_HAS_AVX2 (not x86-64) the same layout is decoded one value at
+a time, the *Scalar versions.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "column_table.h"
+
+/*==# DEFINES #==*/
+
+#define PACKED_BLOCK 256
+#define PACKED_LANES 8
+#define PACKED_PER_LANE (PACKED_BLOCK / PACKED_LANES)
+
+/*==# CLASSES #==*/
+
+class PackedColumn {
+
+    private:
+    struct Block {
+        int reference;
+        std::uint32_t width;
+        std::size_t offset; // first word in words
+    };
+
+    std::vector<Block> blocks;
+    std::vector<std::uint32_t> words;
+    std::size_t count = 0;
+
+    static constexpr std::uint32_t maskOf (std::uint32_t width) {
+        return width == 32 ? ~0u : (1u << width) - 1u;
+    }
+
+    // The delta at position of one lane of a block.
+    static std::uint32_t unpackOne (const std::uint32_t* in, std::uint32_t width, std::size_t lane,
+    std::size_t position) {
+        if (width == 0) {
+            return 0;
+        }
+        std::size_t bit     = position * width;
+        std::size_t word    = bit / 32;
+        std::uint32_t shift = static_cast<std::uint32_t> (bit % 32);
+        std::uint32_t value = in[word * PACKED_LANES + lane] >> shift;
+        if (shift + width > 32) {
+            value |= in[(word + 1) * PACKED_LANES + lane] << (32 - shift);
+        }
+        return value & maskOf (width);
+    }
+
+#ifdef COLUMN_HAS_AVX2
+    // Calls sink (__m256i) with the deltas of 8 consecutive values, 32 times.
+    template <std::uint32_t Width, typename Sink>
+    COLUMN_AVX2 static void unpackBlockAvx2 (const std::uint32_t* in, Sink& sink) {
+        const __m256i mask = _mm256_set1_epi32 (static_cast<int> (maskOf (Width)));
+#pragma GCC unroll 32
+        for (std::size_t position = 0; position < PACKED_PER_LANE; ++position) {
+            if constexpr (Width == 0) {
+                sink (_mm256_setzero_si256 ());
+            } else {
+                const std::size_t bit  = position * Width;
+                const std::size_t word = bit / 32;
+                const int shift        = static_cast<int> (bit % 32);
+                const __m256i* low     = reinterpret_cast<const __m256i*> (in + word * PACKED_LANES);
+                __m256i values            = _mm256_srli_epi32 (_mm256_loadu_si256 (low), shift);
+                if (shift + static_cast<int> (Width) > 32) {
+                    const __m256i* high = reinterpret_cast<const __m256i*> (in + (word + 1) * PACKED_LANES);
+                    values = _mm256_or_si256 (values, _mm256_slli_epi32 (_mm256_loadu_si256 (high), 32 - shift));
+                }
+                sink (_mm256_and_si256 (values, mask));
+            }
+        }
+    }
+
+    // One unpacker per bit width, picked by the width of the block.
+    template <typename Sink> struct Unpackers {
+        using Function = void (*) (const std::uint32_t* in, Sink& sink);
+
+        template <std::size_t... Widths>
+        static constexpr std::array<Function, sizeof...(Widths)> make (std::index_sequence<Widths...>) {
+            return { &unpackBlockAvx2<static_cast<std::uint32_t> (Widths), Sink>... };
+        }
+
+        static constexpr std::array<Function, 33> table = make (std::make_index_sequence<33> ());
+    };
+
+    // Sinks are created inside the AVX2 functions, they must not touch AVX2 themselves.
+    struct SumSink {
+        __m256i total;
+
+        COLUMN_AVX2 void operator() (__m256i deltas) {
+            total = _mm256_add_epi64 (total, _mm256_cvtepu32_epi64 (_mm256_castsi256_si128 (deltas)));
+            total = _mm256_add_epi64 (total, _mm256_cvtepu32_epi64 (_mm256_extracti128_si256 (deltas, 1)));
+        }
+    };
+
+    struct MaxSink {
+        __m256i best;
+
+        COLUMN_AVX2 void operator() (__m256i deltas) {
+            best = _mm256_max_epu32 (best, deltas);
+        }
+    };
+
+    struct DecodeSink {
+        int* out;
+        __m256i reference;
+
+        COLUMN_AVX2 void operator() (__m256i deltas) {
+            _mm256_storeu_si256 (reinterpret_cast<__m256i*> (out), _mm256_add_epi32 (deltas, reference));
+            out += PACKED_LANES;
+        }
+    };
+
+#endif // COLUMN_HAS_AVX2
+
+    std::size_t blockSize (std::size_t block) const {
+        return std::min<std::size_t> (PACKED_BLOCK, count - block * PACKED_BLOCK);
+    }
+
+#ifdef COLUMN_HAS_AVX2
+    COLUMN_AVX2 std::int64_t sumAvx2 () const {
+        std::int64_t sum = 0;
+        for (std::size_t block = 0; block < blocks.size (); ++block) {
+            SumSink sink{ _mm256_setzero_si256 () };
+            Unpackers<SumSink>::table[blocks[block].width] (words.data () + blocks[block].offset, sink);
+            alignas (32) std::int64_t lanes[4];
+            _mm256_store_si256 (reinterpret_cast<__m256i*> (lanes), sink.total);
+            // Padding values have a delta of 0, they add nothing.
+            sum += lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+            static_cast<std::int64_t> (blocks[block].reference) * static_cast<std::int64_t> (blockSize (block));
+        }
+        return sum;
+    }
+
+    COLUMN_AVX2 int maxAvx2 () const {
+        int max = std::numeric_limits<int>::min ();
+        for (const Block& block : blocks) {
+            MaxSink sink{ _mm256_setzero_si256 () };
+            Unpackers<MaxSink>::table[block.width] (words.data () + block.offset, sink);
+            alignas (32) std::uint32_t lanes[PACKED_LANES];
+            _mm256_store_si256 (reinterpret_cast<__m256i*> (lanes), sink.best);
+            std::uint32_t delta = *std::max_element (lanes, lanes + PACKED_LANES);
+            max = std::max (max, static_cast<int> (static_cast<std::uint32_t> (block.reference) + delta));
+        }
+        return max;
+    }
+#endif // COLUMN_HAS_AVX2
+
+    public:
+    PackedColumn () = default;
+
+    explicit PackedColumn (std::span<const int> column) : count (column.size ()) {
+        blocks.reserve ((count + PACKED_BLOCK - 1) / PACKED_BLOCK);
+        for (std::size_t begin = 0; begin < count; begin += PACKED_BLOCK) {
+            std::span<const int> values = column.subspan (begin, std::min<std::size_t> (PACKED_BLOCK, count - begin));
+            const int reference         = *std::min_element (values.begin (), values.end ());
+            std::uint32_t largest       = 0;
+            for (int value : values) {
+                largest = std::max (largest, static_cast<std::uint32_t> (value) - static_cast<std::uint32_t> (reference));
+            }
+            const std::uint32_t width = static_cast<std::uint32_t> (std::bit_width (largest));
+
+            blocks.push_back (Block{ reference, width, words.size () });
+            words.resize (words.size () + width * PACKED_LANES, 0);
+            std::uint32_t* out = words.data () + blocks.back ().offset;
+            for (std::size_t i = 0; i < values.size () && width; ++i) {
+                const std::uint32_t delta =
+                static_cast<std::uint32_t> (values[i]) - static_cast<std::uint32_t> (reference);
+                const std::size_t lane     = i % PACKED_LANES;
+                const std::size_t bit      = (i / PACKED_LANES) * width;
+                const std::size_t word     = bit / 32;
+                const std::uint32_t shift  = static_cast<std::uint32_t> (bit % 32);
+                out[word * PACKED_LANES + lane] |= delta << shift;
+                if (shift + width > 32) {
+                    out[(word + 1) * PACKED_LANES + lane] |= delta >> (32 - shift);
+                }
+            }
+        }
+    }
+
+    std::size_t size () const {
+        return count;
+    }
+
+    // Compressed size, block headers as they would be stored (reference and a
+    // width byte, the offset follows from the widths).
+    std::size_t packedBytes () const {
+        return words.size () * sizeof (std::uint32_t) + blocks.size () * (sizeof (int) + 1);
+    }
+
+    double compressionRatio () const {
+        return packedBytes () ? static_cast<double> (count * sizeof (int)) / static_cast<double> (packedBytes ()) : 0.0;
+    }
+
+    int get (std::size_t index) const {
+        const Block& block = blocks[index / PACKED_BLOCK];
+        const std::size_t i = index % PACKED_BLOCK;
+        return static_cast<int> (static_cast<std::uint32_t> (block.reference) +
+        unpackOne (words.data () + block.offset, block.width, i % PACKED_LANES, i / PACKED_LANES));
+    }
+
+    /*==# AGGREGATIONS #==*/
+
+    std::int64_t sum () const {
+#ifdef COLUMN_HAS_AVX2
+        if (columns::hasAvx2 ()) {
+            return sumAvx2 ();
+        }
+#endif
+        return sumScalar ();
+    }
+
+    int max () const {
+#ifdef COLUMN_HAS_AVX2
+        if (columns::hasAvx2 ()) {
+            return maxAvx2 ();
+        }
+#endif
+        return maxScalar ();
+    }
+
+    // The reference of a block is its minimum.
+    int min () const {
+        int min = std::numeric_limits<int>::max ();
+        for (const Block& block : blocks) {
+            min = std::min (min, block.reference);
+        }
+        return min;
+    }
+
+    std::int64_t sumScalar () const {
+        std::int64_t sum = 0;
+        for (std::size_t block = 0; block < blocks.size (); ++block) {
+            const std::uint32_t* in = words.data () + blocks[block].offset;
+            std::uint64_t deltas    = 0;
+            for (std::size_t i = 0; i < PACKED_BLOCK; ++i) {
+                deltas += unpackOne (in, blocks[block].width, i % PACKED_LANES, i / PACKED_LANES);
+            }
+            sum += static_cast<std::int64_t> (deltas) +
+            static_cast<std::int64_t> (blocks[block].reference) * static_cast<std::int64_t> (blockSize (block));
+        }
+        return sum;
+    }
+
+    int maxScalar () const {
+        int max = std::numeric_limits<int>::min ();
+        for (const Block& block : blocks) {
+            const std::uint32_t* in = words.data () + block.offset;
+            std::uint32_t delta     = 0;
+            for (std::size_t i = 0; i < PACKED_BLOCK; ++i) {
+                delta = std::max (delta, unpackOne (in, block.width, i % PACKED_LANES, i / PACKED_LANES));
+            }
+            max = std::max (max, static_cast<int> (static_cast<std::uint32_t> (block.reference) + delta));
+        }
+        return max;
+    }
+
+    // Decompresses into out, which holds at least size () values.
+    void decode (std::span<int> out) const {
+        for (std::size_t block = 0; block < blocks.size (); ++block) {
+            const std::size_t values = blockSize (block);
+            int* destination         = out.data () + block * PACKED_BLOCK;
+#ifdef COLUMN_HAS_AVX2
+            if (values == PACKED_BLOCK && columns::hasAvx2 ()) {
+                decodeBlockAvx2 (block, destination);
+                continue;
+            }
+#endif
+            for (std::size_t i = 0; i < values; ++i) {
+                destination[i] = get (block * PACKED_BLOCK + i);
+            }
+        }
+    }
+
+#ifdef COLUMN_HAS_AVX2
+    private:
+    COLUMN_AVX2 void decodeBlockAvx2 (std::size_t block, int* destination) const {
+        DecodeSink sink{ destination, _mm256_set1_epi32 (blocks[block].reference) };
+        Unpackers<DecodeSink>::table[blocks[block].width] (words.data () + blocks[block].offset, sink);
+    }
+#endif
+};
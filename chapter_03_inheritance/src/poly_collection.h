@@ -0,0 +1,199 @@
+/*====# POLYMORPHIC COLLECTION #====*/
+/*
+
+A std::vector<PolymorphicClass*> full of mixed objects is the textbook way of
+storing a hierarchy, and also the slowest one to iterate:
+
+* every element is a pointer chase to wherever new put the object
+* every virtual call is an indirect branch whose target changes at random
+
+PolyCollection<Base> stores the objects BY VALUE, in one contiguous bucket per
+dynamic type. Iterating bucket by bucket means the memory is read linearly and
+the virtual call target only changes when we move on to the next bucket.
+
+forEach<Known...> goes one step further. For the listed types the function
+gets the object as its exact type, so the compiler can resolve and inline the
+calls and every bucket becomes one tight loop. Types that are not listed are
+still visited, just through a Base&.
+
+Things to keep in mind:
+* insert() copies the object as its static type T, so pass the real type
+  (inserting a Derived through a Base& would slice it, see scenario 5)
+* the order of insertion is not kept across types
+* like std::vector, growing a bucket invalidates references into it
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+/*==# CLASSES #==*/
+
+template <typename Base> class PolyCollection {
+
+    private:
+    // Type erased view of a bucket, enough to walk it as Base objects.
+    class BucketBase {
+        public:
+        virtual ~BucketBase ()                 = default;
+        virtual std::size_t size () const      = 0;
+        virtual char* bytes ()                 = 0;
+        virtual std::size_t stride () const    = 0;
+        virtual std::ptrdiff_t baseOffset () const = 0;
+        virtual void clear ()                  = 0;
+    };
+
+    template <typename T> class Bucket final : public BucketBase {
+        public:
+        std::vector<T> items;
+
+        std::size_t size () const override {
+            return items.size ();
+        }
+        char* bytes () override {
+            return reinterpret_cast<char*> (items.data ());
+        }
+        std::size_t stride () const override {
+            return sizeof (T);
+        }
+        std::ptrdiff_t baseOffset () const override {
+            // The Base subobject sits at the same offset in every T.
+            const T* first = items.data ();
+            return reinterpret_cast<const char*> (static_cast<const Base*> (first)) -
+            reinterpret_cast<const char*> (first);
+        }
+        void clear () override {
+            items.clear ();
+        }
+    };
+
+    struct Entry {
+        std::type_index type;
+        std::unique_ptr<BucketBase> bucket;
+    };
+
+    std::vector<Entry> entries;
+
+    BucketBase* find (const std::type_index& type) const {
+        for (const Entry& entry : entries) {
+            if (entry.type == type) {
+                return entry.bucket.get ();
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename T> Bucket<T>& bucketFor () {
+        if (BucketBase* found = find (std::type_index (typeid (T)))) {
+            return static_cast<Bucket<T>&> (*found);
+        }
+        entries.push_back (Entry{ std::type_index (typeid (T)), std::make_unique<Bucket<T>> () });
+        return static_cast<Bucket<T>&> (*entries.back ().bucket);
+    }
+
+    template <typename T, typename Function>
+    bool visitAs (const Entry& entry, Function& function) {
+        if (entry.type != std::type_index (typeid (T))) {
+            return false;
+        }
+        for (T& item : static_cast<Bucket<T>&> (*entry.bucket).items) {
+            function (item);
+        }
+        return true;
+    }
+
+    template <typename Function> static void visitAsBase (BucketBase& bucket, Function& function) {
+        const std::size_t count = bucket.size ();
+        if (count == 0) {
+            return;
+        }
+        const std::size_t stride   = bucket.stride ();
+        const std::ptrdiff_t offset = bucket.baseOffset ();
+        char* cursor                = bucket.bytes () + offset;
+        for (std::size_t i = 0; i < count; ++i, cursor += stride) {
+            function (*reinterpret_cast<Base*> (cursor));
+        }
+    }
+
+    public:
+    PolyCollection () = default;
+
+    PolyCollection (const PolyCollection&)            = delete;
+    PolyCollection& operator= (const PolyCollection&) = delete;
+    PolyCollection (PolyCollection&&) noexcept        = default;
+    PolyCollection& operator= (PolyCollection&&) noexcept = default;
+
+    /*==# INSERTION #==*/
+    /* T must be the dynamic type of the object, we store a T. */
+    template <typename T> T& insert (T value) {
+        static_assert (std::is_base_of_v<Base, T>, "PolyCollection only stores types derived from Base");
+        std::vector<T>& items = bucketFor<T> ().items;
+        items.push_back (std::move (value));
+        return items.back ();
+    }
+
+    template <typename T, typename... Args> T& emplace (Args&&... args) {
+        static_assert (std::is_base_of_v<Base, T>, "PolyCollection only stores types derived from Base");
+        return bucketFor<T> ().items.emplace_back (std::forward<Args> (args)...);
+    }
+
+    // Reserves room in the bucket of T, creating the bucket if needed.
+    template <typename T> void reserve (std::size_t count) {
+        bucketFor<T> ().items.reserve (count);
+    }
+
+    /*==# ITERATION #==*/
+    /* Known types are visited as themselves, everything else as Base&. */
+    template <typename... Known, typename Function> void forEach (Function&& function) {
+        for (const Entry& entry : entries) {
+            if (!(visitAs<Known> (entry, function) || ...)) {
+                visitAsBase (*entry.bucket, function);
+            }
+        }
+    }
+
+    // Visits only the bucket of T, as T.
+    template <typename T, typename Function> void forEachOf (Function&& function) {
+        if (BucketBase* found = find (std::type_index (typeid (T)))) {
+            for (T& item : static_cast<Bucket<T>&> (*found).items) {
+                function (item);
+            }
+        }
+    }
+
+    /*==# CAPACITY #==*/
+    std::size_t size () const {
+        std::size_t total = 0;
+        for (const Entry& entry : entries) {
+            total += entry.bucket->size ();
+        }
+        return total;
+    }
+
+    std::size_t bucketCount () const {
+        return entries.size ();
+    }
+
+    template <typename T> std::size_t sizeOf () const {
+        BucketBase* found = find (std::type_index (typeid (T)));
+        return found ? found->size () : 0;
+    }
+
+    bool empty () const {
+        return size () == 0;
+    }
+
+    void clear () {
+        for (Entry& entry : entries) {
+            entry.bucket->clear ();
+        }
+    }
+};
@@ -0,0 +1,235 @@
+/*====# POLYMORPHIC VALUE #====*/
+/*
+
+Holding an AbstractInterface today means new + a pointer, and copying the
+object by value slices it (scenario 5). PolyValue<Interface> is a value type
+that holds ANY implementer of the interface:
+
+* small implementers live inside the PolyValue itself (no heap allocation),
+  bigger ones (or ones that may throw while moving) fall back to the heap
+* copying a PolyValue copies the implementer as its real type, no slicing
+* moving is noexcept, so std::vector<PolyValue> moves instead of copying
+
+Dispatch does not go through the C++ vtable of the object. Every implementer
+gets one static table of our own, with the lifecycle functions and the
+interface methods. The methods are called qualified (T::returnChar), so the
+thunk in the table is a direct, inlinable call. The table pointer lives in
+the PolyValue, next to the object, so dispatching is one load from memory
+we already have in cache.
+
+The interface methods a PolyValue exposes are described by a specialisation
+of PolyDispatch<Interface>, see the one for AbstractInterface at the bottom.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "inheritance.h"
+
+/*==# DEFINES #==*/
+
+// Three pointers of inline storage plus our table pointer, half a cache line.
+#define POLYVALUE_DEFAULT_BUFFER (3 * sizeof (void*))
+#define POLYVALUE_BUFFER_ALIGN alignof (void*)
+
+/*==# CLASSES #==*/
+
+// Specialise for every interface a PolyValue should be able to hold.
+template <typename Interface> struct PolyDispatch;
+
+template <typename Interface, std::size_t BufferSize = POLYVALUE_DEFAULT_BUFFER>
+class PolyValue
+: public PolyDispatch<Interface>::template Facade<PolyValue<Interface, BufferSize>> {
+
+    private:
+    using Methods = typename PolyDispatch<Interface>::Table;
+
+    struct VTable {
+        bool on_heap;
+        void (*copy) (const PolyValue& source, PolyValue& destination);
+        void (*move) (PolyValue& source, PolyValue& destination) noexcept;
+        void (*destroy) (PolyValue& value) noexcept;
+        Interface* (*asInterface) (void* object);
+        Methods methods;
+    };
+
+    template <typename T>
+    static constexpr bool fits_inline = sizeof (T) <= BufferSize &&
+    POLYVALUE_BUFFER_ALIGN % alignof (T) == 0 && std::is_nothrow_move_constructible_v<T>;
+
+    template <typename T> static T* objectAs (const PolyValue& value) {
+        if constexpr (fits_inline<T>) {
+            return std::launder (reinterpret_cast<T*> (const_cast<unsigned char*> (value.buffer)));
+        } else {
+            return static_cast<T*> (value.heap);
+        }
+    }
+
+    template <typename T> static constexpr VTable vtable_for = {
+        !fits_inline<T>,
+        [] (const PolyValue& source, PolyValue& destination) {
+            if constexpr (fits_inline<T>) {
+                ::new (static_cast<void*> (destination.buffer)) T (*objectAs<T> (source));
+            } else {
+                destination.heap = new T (*objectAs<T> (source));
+            }
+        },
+        [] (PolyValue& source, PolyValue& destination) noexcept {
+            if constexpr (fits_inline<T>) {
+                T* object = objectAs<T> (source);
+                ::new (static_cast<void*> (destination.buffer)) T (std::move (*object));
+                object->~T ();
+            } else {
+                destination.heap = source.heap;
+                source.heap      = nullptr;
+            }
+        },
+        [] (PolyValue& value) noexcept {
+            if constexpr (fits_inline<T>) {
+                objectAs<T> (value)->~T ();
+            } else {
+                delete objectAs<T> (value);
+            }
+        },
+        [] (void* object) -> Interface* { return static_cast<T*> (object); },
+        PolyDispatch<Interface>::template table<T>,
+    };
+
+    union {
+        alignas (POLYVALUE_BUFFER_ALIGN) unsigned char buffer[BufferSize];
+        void* heap;
+    };
+    const VTable* vtable = nullptr;
+
+    void reset () noexcept {
+        if (vtable) {
+            vtable->destroy (*this);
+            vtable = nullptr;
+        }
+    }
+
+    public:
+    /*==# CONSTRUCTORS #==*/
+    PolyValue () noexcept {
+    }
+
+    // Stores a copy of value, as its static type T. Explicit: handing over a
+    // Derived& where a PolyValue is expected would quietly copy the object.
+    template <typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, PolyValue>>>
+    explicit PolyValue (T&& value) {
+        using Stored = std::decay_t<T>;
+        static_assert (std::is_base_of_v<Interface, Stored>, "PolyValue only holds implementers of Interface");
+        static_assert (std::is_copy_constructible_v<Stored>, "PolyValue is copyable, so the implementer must be too");
+        if constexpr (fits_inline<Stored>) {
+            ::new (static_cast<void*> (buffer)) Stored (std::forward<T> (value));
+        } else {
+            heap = new Stored (std::forward<T> (value));
+        }
+        vtable = &vtable_for<Stored>;
+    }
+
+    ~PolyValue () {
+        reset ();
+    }
+
+    /*==# COPY #==*/
+    /* A deep copy of the stored object, keeping its dynamic type. */
+    PolyValue (const PolyValue& source) {
+        if (source.vtable) {
+            source.vtable->copy (source, *this);
+            vtable = source.vtable;
+        }
+    }
+
+    PolyValue& operator= (const PolyValue& source) {
+        if (this != &source) {
+            PolyValue copy (source);
+            *this = std::move (copy);
+        }
+        return *this;
+    }
+
+    /*==# MOVE #==*/
+    /* Heap objects just hand over the pointer, inline ones are move constructed. */
+    PolyValue (PolyValue&& source) noexcept {
+        if (source.vtable) {
+            source.vtable->move (source, *this);
+            vtable        = source.vtable;
+            source.vtable = nullptr;
+        }
+    }
+
+    PolyValue& operator= (PolyValue&& source) noexcept {
+        if (this != &source) {
+            reset ();
+            if (source.vtable) {
+                source.vtable->move (source, *this);
+                vtable        = source.vtable;
+                source.vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    /*==# ACCESS #==*/
+    explicit operator bool () const noexcept {
+        return vtable != nullptr;
+    }
+
+    bool isInline () const noexcept {
+        return vtable && !vtable->on_heap;
+    }
+
+    // The object itself, as the interface. Calls through it use the C++ vtable.
+    Interface* get () const noexcept {
+        return vtable ? vtable->asInterface (object ()) : nullptr;
+    }
+
+    // Used by the Facade, dispatching through our own table.
+    void* object () const noexcept {
+        return vtable && vtable->on_heap ? heap : const_cast<unsigned char*> (buffer);
+    }
+
+    // Precondition: not empty (default constructed or moved from), like *unique_ptr.
+    const Methods& methods () const noexcept {
+        assert (vtable && "calling through an empty PolyValue");
+        return vtable->methods;
+    }
+};
+
+/*==# DISPATCH TABLES #==*/
+
+// AbstractInterface: returnChar and returnNumber
+template <> struct PolyDispatch<AbstractInterface> {
+
+    struct Table {
+        char (*returnChar) (void* object);
+        int (*returnNumber) (void* object);
+    };
+
+    template <typename T>
+    static constexpr Table table = {
+        [] (void* object) { return static_cast<T*> (object)->T::returnChar (); },
+        [] (void* object) { return static_cast<T*> (object)->T::returnNumber (); },
+    };
+
+    template <typename Self> class Facade {
+        public:
+        char returnChar () {
+            Self& self = static_cast<Self&> (*this);
+            return self.methods ().returnChar (self.object ());
+        }
+
+        int returnNumber () {
+            Self& self = static_cast<Self&> (*this);
+            return self.methods ().returnNumber (self.object ());
+        }
+    };
+};
@@ -0,0 +1,254 @@
+/*====# POOLED NEW #====*/
+/*
+
+A class can provide its own operator new and operator delete. They are
+static members, inherited like any other member, so when the base class of a
+hierarchy has them, `new SubClass_VirtualDestructor ()` uses them too,
+without changing a single call site.
+
+The interesting part is delete. With a virtual destructor, `delete base`
+runs the deleting destructor of the DYNAMIC type, and that one calls
+operator delete (void*, std::size_t) with sizeof of the dynamic type.
+So the pool knows the size of every block it gets back for free, no header
+in front of the block and no lookup.
+
+## The pools ##
+* requests are rounded up to a size class (16 ... 256 bytes), bigger ones go
+  straight to the global operator new
+* every size class has a global lock-free free list (a Treiber stack with a
+  tag in the upper pointer bits against ABA) filled from 64 KiB slabs
+* every thread keeps a small cache per size class and only talks to the
+  global list in batches, so the common new/delete never touches a shared
+  cache line
+* slabs are never returned to the system, the memory of a pool only grows
+
+Opting a class in: put POOLED_NEW_OPERATORS in its public section.
+The class MUST have a virtual destructor if it is deleted through a base
+pointer, otherwise the size passed to delete is the wrong one.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+/*==# DEFINES #==*/
+
+#define POOLED_SLAB_SIZE (64 * 1024)
+#define POOLED_CACHE_LIMIT 128
+#define POOLED_BATCH_SIZE 64
+
+// Over-aligned types (alignas above 16, the slab alignment) bypass the pools.
+#define POOLED_NEW_OPERATORS                                                                           \
+    static void* operator new (std::size_t size) {                                                     \
+        return pooled::allocate (size);                                                                \
+    }                                                                                                  \
+    static void operator delete (void* pointer, std::size_t size) noexcept {                           \
+        pooled::deallocate (pointer, size);                                                            \
+    }                                                                                                  \
+    static void* operator new (std::size_t size, std::align_val_t alignment) {                         \
+        return ::operator new (size, alignment);                                                       \
+    }                                                                                                  \
+    static void operator delete (void* pointer, std::size_t size, std::align_val_t alignment) noexcept { \
+        ::operator delete (pointer, size, alignment);                                                  \
+    }
+
+namespace pooled {
+
+/*==# SIZE CLASSES #==*/
+
+inline constexpr std::size_t size_classes[] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+inline constexpr int size_class_count = sizeof (size_classes) / sizeof (size_classes[0]);
+
+constexpr int sizeClassOf (std::size_t size) {
+    for (int i = 0; i < size_class_count; ++i) {
+        if (size <= size_classes[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*==# CLASSES #==*/
+
+// next is atomic: a thread that lost the race in GlobalFreeList::pop may still
+// read it while the winner already writes the object into the same bytes.
+struct FreeBlock {
+    std::atomic<FreeBlock*> next;
+
+    FreeBlock* following () const noexcept {
+        return next.load (std::memory_order_relaxed);
+    }
+
+    void link (FreeBlock* block) noexcept {
+        next.store (block, std::memory_order_relaxed);
+    }
+};
+
+// 1. GLOBAL FREE LIST //
+/*
+
+x86-64 user space pointers only use the low 48 bits, the upper 16 hold a tag
+that changes on every successful pop, so a stale head can never be mistaken
+for the current one (the ABA problem).
+Reading next of a block another thread already popped is harmless, the slab
+memory is never unmapped. next is a relaxed atomic for that read, whatever
+stale value it sees, the CAS fails and throws it away.
+
+*/
+
+class GlobalFreeList {
+
+    private:
+    static constexpr std::uint64_t pointer_mask = (std::uint64_t (1) << 48) - 1;
+
+    std::atomic<std::uint64_t> head{ 0 };
+
+    static FreeBlock* pointerOf (std::uint64_t tagged) {
+        return reinterpret_cast<FreeBlock*> (tagged & pointer_mask);
+    }
+
+    static std::uint64_t tag (FreeBlock* block, std::uint64_t previous) {
+        return reinterpret_cast<std::uint64_t> (block) | ((previous & ~pointer_mask) + (pointer_mask + 1));
+    }
+
+    public:
+    // Pushes the chain first..last in one CAS.
+    void pushChain (FreeBlock* first, FreeBlock* last) noexcept {
+        std::uint64_t old_head = head.load (std::memory_order_relaxed);
+        do {
+            last->link (pointerOf (old_head));
+        } while (!head.compare_exchange_weak (old_head, tag (first, old_head),
+        std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    FreeBlock* pop () noexcept {
+        std::uint64_t old_head = head.load (std::memory_order_acquire);
+        while (FreeBlock* block = pointerOf (old_head)) {
+            if (head.compare_exchange_weak (old_head, tag (block->following (), old_head),
+                std::memory_order_acquire, std::memory_order_acquire)) {
+                return block;
+            }
+        }
+        return nullptr;
+    }
+};
+
+inline GlobalFreeList global_lists[size_class_count];
+
+// 2. THREAD CACHE //
+/* Hands everything it still holds back to the global lists when the thread ends. */
+
+class ThreadCache {
+
+    private:
+    FreeBlock* lists[size_class_count] = {};
+    int counts[size_class_count]       = {};
+
+    void refill (int size_class) {
+        for (int i = 0; i < POOLED_BATCH_SIZE; ++i) {
+            FreeBlock* block = global_lists[size_class].pop ();
+            if (!block) {
+                break;
+            }
+            block->link (lists[size_class]);
+            lists[size_class] = block;
+            ++counts[size_class];
+        }
+        if (lists[size_class]) {
+            return;
+        }
+
+        // Nothing left globally, carve a new slab. Its memory is never freed.
+        const std::size_t block_size = size_classes[size_class];
+        char* slab = static_cast<char*> (std::malloc (POOLED_SLAB_SIZE));
+        if (!slab) {
+            throw std::bad_alloc ();
+        }
+        for (std::size_t offset = 0; offset + block_size <= POOLED_SLAB_SIZE; offset += block_size) {
+            FreeBlock* block = ::new (slab + offset) FreeBlock;
+            block->link (lists[size_class]);
+            lists[size_class] = block;
+            ++counts[size_class];
+        }
+    }
+
+    void flush (int size_class, int keep) noexcept {
+        if (counts[size_class] <= keep) {
+            return;
+        }
+        FreeBlock* first = lists[size_class];
+        FreeBlock* last  = first;
+        for (int i = 1; i < counts[size_class] - keep; ++i) {
+            last = last->following ();
+        }
+        lists[size_class]  = last->following ();
+        counts[size_class] = keep;
+        global_lists[size_class].pushChain (first, last);
+    }
+
+    public:
+    ThreadCache () = default;
+
+    ~ThreadCache () {
+        for (int i = 0; i < size_class_count; ++i) {
+            flush (i, 0);
+        }
+    }
+
+    ThreadCache (const ThreadCache&)            = delete;
+    ThreadCache& operator= (const ThreadCache&) = delete;
+
+    void* allocate (int size_class) {
+        if (!lists[size_class]) {
+            refill (size_class);
+        }
+        FreeBlock* block  = lists[size_class];
+        lists[size_class] = block->following ();
+        --counts[size_class];
+        return block;
+    }
+
+    void deallocate (void* pointer, int size_class) noexcept {
+        FreeBlock* block = ::new (pointer) FreeBlock;
+        block->link (lists[size_class]);
+        lists[size_class] = block;
+        if (++counts[size_class] > POOLED_CACHE_LIMIT) {
+            flush (size_class, POOLED_CACHE_LIMIT / 2);
+        }
+    }
+};
+
+inline ThreadCache& threadCache () {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+inline void* allocate (std::size_t size) {
+    const int size_class = sizeClassOf (size);
+    if (size_class < 0) {
+        return ::operator new (size);
+    }
+    return threadCache ().allocate (size_class);
+}
+
+inline void deallocate (void* pointer, std::size_t size) noexcept {
+    if (!pointer) {
+        return;
+    }
+    const int size_class = sizeClassOf (size);
+    if (size_class < 0) {
+        ::operator delete (pointer, size);
+        return;
+    }
+    threadCache ().deallocate (pointer, size_class);
+}
+
+} // namespace pooled
@@ -0,0 +1,48 @@
+/*====# SLICED COLUMNS #====*/
+/*
+
+ParentSlicerClass and ClassToBeSliced of inheritance.h (5. object slicing)
+stored column by column, see column_table.h. Kept out of inheritance.h so
+that the hierarchy does not drag the column kernels into every translation
+unit that only wants the classes.
+
+ClassToBeSliced has six columns, the shadowed a and b of the parent included,
+so converting back and forth loses nothing.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cstddef>
+
+#include "column_table.h"
+#include "inheritance.h"
+
+/*==# CLASSES #==*/
+
+template <> struct ColumnLayout<ParentSlicerClass> {
+    static constexpr std::size_t COUNT                   = 2;
+    static constexpr const char* names[COUNT]            = { "a", "b" };
+    static constexpr int ParentSlicerClass::*fields[COUNT] = { &ParentSlicerClass::a,
+        &ParentSlicerClass::b };
+};
+
+template <> struct ColumnLayout<ClassToBeSliced> {
+    static constexpr std::size_t COUNT = 6;
+    static constexpr const char* names[COUNT] = { "ParentSlicerClass::a", "ParentSlicerClass::b",
+        "a", "b", "c", "d" };
+    static constexpr int ClassToBeSliced::*fields[COUNT] = { &ParentSlicerClass::a,
+        &ParentSlicerClass::b, &ClassToBeSliced::a, &ClassToBeSliced::b, &ClassToBeSliced::c,
+        &ClassToBeSliced::d };
+};
+
+// Column indices of ColumnTable<ClassToBeSliced>.
+enum SlicedColumn {
+    SLICED_PARENT_A = 0,
+    SLICED_PARENT_B,
+    SLICED_A,
+    SLICED_B,
+    SLICED_C,
+    SLICED_D
+};
@@ -0,0 +1,522 @@
+/*====# WORK STEALING POOL #====*/
+/*
+
+A pool of worker threads for fork-join parallelism (recursive divide and
+conquer, parallel for loops), the way Cilk, TBB and Rayon do it.
+
+## Tasks ##
+A task is an object of the Task hierarchy, run through its virtual execute.
+Any class deriving from Task works, and any callable is wrapped into a
+FunctionTask. InlineTask holds one of them in a small buffer inside itself
+(type erasure without new, the trick of PolyValue), only a task bigger than
+the buffer goes to the heap. Forking puts the InlineTask on the stack of the
+forking function, so a fork allocates nothing.
+
+## Work stealing ##
+Every worker owns a Chase-Lev deque. The owner pushes and takes at the
+bottom (LIFO, the most recent and cache-hot task) without any locked
+instruction in the common case, idle workers steal from the top (the
+oldest, and in divide and conquer the biggest, piece of work). Threads that
+are not workers hand their tasks in through a small locked injection queue.
+
+## join (a, b) ##
+b is pushed to the deque, a runs right away, then b is taken back and run
+inline unless somebody stole it. If it was stolen, the joining worker does
+not block: it steals and runs other tasks until b has finished.
+
+C++ can not capture the rest of a function as a task, so what gets stolen is
+the forked child (child stealing), not the continuation after the fork as in
+Cilk. For join the difference is only the order in which work is found.
+
+## Sleeping ##
+Workers with nothing to do spin a little, then sleep on an event count:
+pushing a task only pays for a wake-up when somebody actually sleeps.
+
+Tasks must not throw.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*==# DEFINES #==*/
+
+#define WORK_STEALING_TASK_BUFFER 64
+#define WORK_STEALING_DEQUE_CAPACITY 1024
+#define WORK_STEALING_SPINS 64
+
+/*==# CLASSES #==*/
+
+// 1. TASKS //
+
+class Task {
+
+    private:
+    std::atomic<bool> finished{ false };
+
+    protected:
+    // A copy is a new task, it has not run yet.
+    Task () = default;
+    Task (const Task&) {
+    }
+    Task& operator= (const Task&) {
+        return *this;
+    }
+
+    public:
+    virtual ~Task () = default;
+    virtual void execute () = 0;
+
+    // Nothing may touch the task after this, its owner is free to destroy it.
+    void run () {
+        execute ();
+        finished.store (true, std::memory_order_release);
+    }
+
+    bool isFinished () const {
+        return finished.load (std::memory_order_acquire);
+    }
+};
+
+template <typename Function> class FunctionTask final : public Task {
+
+    private:
+    Function function;
+
+    public:
+    explicit FunctionTask (Function body) : function (std::move (body)) {
+    }
+
+    void execute () override {
+        function ();
+    }
+};
+
+// Runs a Task subclass or a callable in place.
+template <typename Work> void runInPlace (Work& work) {
+    if constexpr (std::is_base_of_v<Task, Work>) {
+        work.execute ();
+    } else {
+        work ();
+    }
+}
+
+// A Task subclass as it is, a callable wrapped into a FunctionTask.
+template <typename Work>
+using TaskFor = std::conditional_t<std::is_base_of_v<Task, std::decay_t<Work>>, std::decay_t<Work>,
+FunctionTask<std::decay_t<Work>>>;
+
+template <std::size_t BufferSize = WORK_STEALING_TASK_BUFFER> class InlineTask {
+
+    private:
+    alignas (std::max_align_t) unsigned char buffer[BufferSize];
+    Task* task;
+
+    public:
+    template <typename Work> explicit InlineTask (Work&& work) {
+        using Concrete = TaskFor<Work>;
+        if constexpr (sizeof (Concrete) <= BufferSize && alignof (Concrete) <= alignof (std::max_align_t)) {
+            task = ::new (static_cast<void*> (buffer)) Concrete (std::forward<Work> (work));
+        } else {
+            task = new Concrete (std::forward<Work> (work));
+        }
+    }
+
+    ~InlineTask () {
+        if (static_cast<void*> (task) == static_cast<void*> (buffer)) {
+            task->~Task ();
+        } else {
+            delete task;
+        }
+    }
+
+    InlineTask (const InlineTask&)            = delete;
+    InlineTask& operator= (const InlineTask&) = delete;
+
+    Task* get () {
+        return task;
+    }
+
+    bool isInline () const {
+        return static_cast<const void*> (task) == static_cast<const void*> (buffer);
+    }
+};
+
+// 2. CHASE-LEV DEQUE //
+/*
+
+"Dynamic Circular Work-Stealing Deque" (Chase, Lev 2005) with the C11 memory
+orders of "Correct and Efficient Work-Stealing for Weak Memory Models"
+(Le et al. 2013). Grows when full, old buffers stay alive until the deque
+dies because a thief may still be reading one. The slots are written with
+release and read with acquire, a bit more than the paper needs: free on x86
+and ThreadSanitizer, which does not understand fences, can follow it.
+
+*/
+
+class ChaseLevDeque {
+
+    private:
+    struct Buffer {
+        std::int64_t capacity;
+        std::unique_ptr<std::atomic<Task*>[]> slots;
+
+        explicit Buffer (std::int64_t size)
+        : capacity (size), slots (new std::atomic<Task*>[static_cast<std::size_t> (size)]) {
+        }
+
+        Task* get (std::int64_t index) const {
+            return slots[static_cast<std::size_t> (index & (capacity - 1))].load (std::memory_order_acquire);
+        }
+
+        void put (std::int64_t index, Task* task) {
+            slots[static_cast<std::size_t> (index & (capacity - 1))].store (task, std::memory_order_release);
+        }
+    };
+
+    alignas (64) std::atomic<std::int64_t> top{ 0 };
+    alignas (64) std::atomic<std::int64_t> bottom{ 0 };
+    alignas (64) std::atomic<Buffer*> buffer;
+    std::vector<std::unique_ptr<Buffer>> buffers; // every buffer ever used
+
+    Buffer* grow (Buffer* old, std::int64_t from, std::int64_t to) {
+        buffers.push_back (std::make_unique<Buffer> (old->capacity * 2));
+        Buffer* bigger = buffers.back ().get ();
+        for (std::int64_t i = from; i < to; ++i) {
+            bigger->put (i, old->get (i));
+        }
+        buffer.store (bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    public:
+    ChaseLevDeque () {
+        buffers.push_back (std::make_unique<Buffer> (WORK_STEALING_DEQUE_CAPACITY));
+        buffer.store (buffers.back ().get (), std::memory_order_relaxed);
+    }
+
+    ChaseLevDeque (const ChaseLevDeque&)            = delete;
+    ChaseLevDeque& operator= (const ChaseLevDeque&) = delete;
+
+    // Owner only.
+    void push (Task* task) {
+        const std::int64_t b = bottom.load (std::memory_order_relaxed);
+        const std::int64_t t = top.load (std::memory_order_acquire);
+        Buffer* current      = buffer.load (std::memory_order_relaxed);
+        if (b - t > current->capacity - 1) {
+            current = grow (current, t, b);
+        }
+        current->put (b, task);
+        std::atomic_thread_fence (std::memory_order_release);
+        bottom.store (b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only, the most recently pushed task or nullptr.
+    Task* take () {
+        const std::int64_t b = bottom.load (std::memory_order_relaxed) - 1;
+        Buffer* current      = buffer.load (std::memory_order_relaxed);
+        bottom.store (b, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        std::int64_t t = top.load (std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store (b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Task* task = current->get (b);
+        if (t == b) {
+            // The last task, race the thieves for it.
+            if (!top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom.store (b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Any thread, the oldest task or nullptr (also when it lost a race).
+    Task* steal () {
+        std::int64_t t = top.load (std::memory_order_acquire);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        const std::int64_t b = bottom.load (std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Buffer* current = buffer.load (std::memory_order_acquire);
+        Task* task      = current->get (t);
+        if (!top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+    bool empty () const {
+        return bottom.load (std::memory_order_relaxed) <= top.load (std::memory_order_relaxed);
+    }
+};
+
+// 3. POOL //
+
+class WorkStealingPool {
+
+    private:
+    struct Worker {
+        ChaseLevDeque deque;
+        std::thread thread;
+        std::uint64_t random;
+        std::atomic<std::uint64_t> executed{ 0 };
+        std::atomic<std::uint64_t> stolen{ 0 };
+    };
+
+    // Blocks a thread that is not a worker until its task has finished.
+    class RootTask final : public Task {
+        private:
+        Task* inner;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done = false;
+
+        public:
+        explicit RootTask (Task* work) : inner (work) {
+        }
+
+        void execute () override {
+            inner->run ();
+            std::lock_guard<std::mutex> lock (mutex);
+            done = true;
+            condition.notify_one ();
+        }
+
+        // run () still writes finished after execute () returns, the task
+        // may only go away once that happened.
+        void wait () {
+            {
+                std::unique_lock<std::mutex> lock (mutex);
+                condition.wait (lock, [this] () { return done; });
+            }
+            while (!isFinished ()) {
+                std::this_thread::yield ();
+            }
+        }
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex injection_mutex;
+    std::deque<Task*> injected;
+    std::atomic<bool> stopping{ false };
+    alignas (64) std::atomic<std::uint32_t> epoch{ 0 };
+    std::atomic<std::uint32_t> sleepers{ 0 };
+
+    static inline thread_local Worker* current_worker     = nullptr;
+    static inline thread_local WorkStealingPool* current_pool = nullptr;
+
+    Task* popInjected () {
+        std::lock_guard<std::mutex> lock (injection_mutex);
+        if (injected.empty ()) {
+            return nullptr;
+        }
+        Task* task = injected.front ();
+        injected.pop_front ();
+        return task;
+    }
+
+    // One round over the other workers, starting at a random one.
+    Task* stealOnce (Worker& self) {
+        self.random ^= self.random << 13;
+        self.random ^= self.random >> 7;
+        self.random ^= self.random << 17;
+        const std::size_t start = static_cast<std::size_t> (self.random % workers.size ());
+        for (std::size_t i = 0; i < workers.size (); ++i) {
+            Worker& victim = *workers[(start + i) % workers.size ()];
+            if (&victim == &self) {
+                continue;
+            }
+            if (Task* task = victim.deque.steal ()) {
+                self.stolen.fetch_add (1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        return popInjected ();
+    }
+
+    bool workAvailable () {
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            if (!worker->deque.empty ()) {
+                return true;
+            }
+        }
+        std::lock_guard<std::mutex> lock (injection_mutex);
+        return !injected.empty ();
+    }
+
+    void wakeOne () {
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        if (sleepers.load (std::memory_order_relaxed) > 0) {
+            epoch.fetch_add (1, std::memory_order_relaxed);
+            epoch.notify_one ();
+        }
+    }
+
+    void sleep () {
+        const std::uint32_t seen = epoch.load (std::memory_order_relaxed);
+        sleepers.fetch_add (1, std::memory_order_seq_cst);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        if (!workAvailable () && !stopping.load (std::memory_order_relaxed)) {
+            epoch.wait (seen, std::memory_order_relaxed);
+        }
+        sleepers.fetch_sub (1, std::memory_order_relaxed);
+    }
+
+    void workerLoop (Worker& self) {
+        current_worker = &self;
+        current_pool   = this;
+        int idle       = 0;
+        while (!stopping.load (std::memory_order_relaxed)) {
+            Task* task = self.deque.take ();
+            if (!task) {
+                task = stealOnce (self);
+            }
+            if (task) {
+                self.executed.fetch_add (1, std::memory_order_relaxed);
+                task->run ();
+                idle = 0;
+            } else if (++idle < WORK_STEALING_SPINS) {
+                std::this_thread::yield ();
+            } else {
+                sleep ();
+                idle = 0;
+            }
+        }
+    }
+
+    void push (Task* task) {
+        current_worker->deque.push (task);
+        wakeOne ();
+    }
+
+    // Runs other work until task has finished.
+    void helpUntil (const Task& task) {
+        Worker& self = *current_worker;
+        while (!task.isFinished ()) {
+            if (Task* other = stealOnce (self)) {
+                self.executed.fetch_add (1, std::memory_order_relaxed);
+                other->run ();
+            } else {
+                std::this_thread::yield ();
+            }
+        }
+    }
+
+    public:
+    explicit WorkStealingPool (std::size_t threads = std::thread::hardware_concurrency ()) {
+        threads = threads ? threads : 1;
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers.push_back (std::make_unique<Worker> ());
+            workers.back ()->random = 0x9e3779b97f4a7c15ull * (i + 1);
+        }
+        for (std::unique_ptr<Worker>& worker : workers) {
+            Worker* self   = worker.get ();
+            worker->thread = std::thread ([this, self] () { workerLoop (*self); });
+        }
+    }
+
+    ~WorkStealingPool () {
+        stopping.store (true, std::memory_order_seq_cst);
+        epoch.fetch_add (1, std::memory_order_relaxed);
+        epoch.notify_all ();
+        for (std::unique_ptr<Worker>& worker : workers) {
+            worker->thread.join ();
+        }
+    }
+
+    WorkStealingPool (const WorkStealingPool&)            = delete;
+    WorkStealingPool& operator= (const WorkStealingPool&) = delete;
+
+    std::size_t threadCount () const {
+        return workers.size ();
+    }
+
+    // Tasks the workers ran from their loops and stole, since the pool started.
+    std::uint64_t executedTasks () const {
+        std::uint64_t total = 0;
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            total += worker->executed.load (std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    std::uint64_t stolenTasks () const {
+        std::uint64_t total = 0;
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            total += worker->stolen.load (std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Runs work on the pool and returns when it is done. Entry point for
+    // threads that are not workers, a worker simply runs it.
+    template <typename Work> void run (Work&& work) {
+        InlineTask<> task (std::forward<Work> (work));
+        if (current_pool == this) {
+            task.get ()->run ();
+            return;
+        }
+        RootTask root (task.get ());
+        {
+            std::lock_guard<std::mutex> lock (injection_mutex);
+            injected.push_back (&root);
+        }
+        epoch.fetch_add (1, std::memory_order_relaxed);
+        epoch.notify_one ();
+        root.wait ();
+    }
+
+    // Runs a and b (Task subclasses or callables), possibly in parallel.
+    // Outside of a pool both run in turn.
+    template <typename WorkA, typename WorkB> static void join (WorkA&& a, WorkB&& b) {
+        WorkStealingPool* pool = current_pool;
+        if (!pool) {
+            runInPlace (a);
+            runInPlace (b);
+            return;
+        }
+        InlineTask<> forked (std::forward<WorkB> (b));
+        pool->push (forked.get ());
+        runInPlace (a);
+        // Thieves take the oldest task first: if b is gone, so is everything
+        // pushed before it, and what a pushed after it a has taken back.
+        Task* task = current_worker->deque.take ();
+        if (task == forked.get ()) {
+            task->run ();
+            return;
+        }
+        if (task) {
+            current_worker->deque.push (task);
+        }
+        pool->helpUntil (*forked.get ());
+    }
+
+    // body (begin, end) over [begin, end), split down to grain sized chunks.
+    template <typename Body>
+    static void parallelFor (std::size_t begin, std::size_t end, std::size_t grain, const Body& body) {
+        if (end - begin <= grain) {
+            body (begin, end);
+            return;
+        }
+        const std::size_t middle = begin + (end - begin) / 2;
+        join ([&] () { parallelFor (begin, middle, grain, body); },
+        [&] () { parallelFor (middle, end, grain, body); });
+    }
+};
@@ -0,0 +1,130 @@
+/*====# CHAPTER 03 LAYOUT REPORT #====*/
+/*
+
+Prints the memory layout of every class of this chapter, see
+include/layout_report.h for what the report contains.
+
+The static_asserts below are the regression guard: when a change makes one
+of these classes bigger, this target stops compiling and the report shows
+where the bytes went.
+
+*/
+
+/*==# INCLUDES #==*/
+#include <new>
+
+#include "inheritance.h"
+#include "layout_report.h"
+
+/*==# LAYOUT GUARDS #==*/
+/* Sizes on x86-64 with the Itanium C++ ABI (GCC, Clang). */
+
+static_assert (sizeof (ConcreteClass) == 8, "ConcreteClass: one vptr");
+static_assert (sizeof (StaticConcreteClass) == 1, "StaticConcreteClass: empty, no vptr");
+static_assert (sizeof (VirtualDestructorClass) == 8, "VirtualDestructorClass: one vptr");
+static_assert (sizeof (SubClass_VirtualDestructor) == 8, "SubClass_VirtualDestructor: shares the vptr");
+static_assert (sizeof (PolymorphicClass) == 8, "PolymorphicClass: one vptr");
+static_assert (sizeof (OverridingClass) == 8, "OverridingClass: shares the vptr");
+static_assert (sizeof (A) == 1, "A: empty");
+static_assert (sizeof (B) == 8, "B: one virtual base pointer");
+static_assert (sizeof (C) == 8, "C: one virtual base pointer");
+static_assert (sizeof (D) == 16, "D: two virtual base pointers");
+static_assert (sizeof (ComposedD) == 1, "ComposedD: no hidden pointers");
+static_assert (sizeof (ParentSlicerClass) == 8, "ParentSlicerClass: two ints");
+static_assert (sizeof (ClassToBeSliced) == 24, "ClassToBeSliced: six ints, two of them shadowed");
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// A constructed object that is never destroyed (some destructors print).
+template <typename T> static const T& specimen () {
+    alignas (T) static unsigned char storage[sizeof (T)];
+    static const T* object = ::new (static_cast<void*> (storage)) T ();
+    return *object;
+}
+
+int main () {
+    std::printf ("Chapter 03 object layouts\n");
+
+    {
+        const ConcreteClass& object = specimen<ConcreteClass> ();
+        layout::LayoutReport report = layout::reportFor<ConcreteClass> ("ConcreteClass");
+        LAYOUT_BASE (report, object, AbstractInterface);
+        report.print ();
+    }
+    {
+        const StaticConcreteClass& object = specimen<StaticConcreteClass> ();
+        layout::LayoutReport report = layout::reportFor<StaticConcreteClass> ("StaticConcreteClass");
+        LAYOUT_BASE (report, object, StaticInterface<StaticConcreteClass>);
+        report.print ();
+    }
+    {
+        layout::reportFor<VirtualDestructorClass> ("VirtualDestructorClass").print ();
+    }
+    {
+        const SubClass_VirtualDestructor& object = specimen<SubClass_VirtualDestructor> ();
+        layout::LayoutReport report =
+        layout::reportFor<SubClass_VirtualDestructor> ("SubClass_VirtualDestructor");
+        LAYOUT_BASE (report, object, VirtualDestructorClass);
+        report.print ();
+    }
+    {
+        layout::reportFor<PolymorphicClass> ("PolymorphicClass").print ();
+    }
+    {
+        const OverridingClass& object = specimen<OverridingClass> ();
+        layout::LayoutReport report = layout::reportFor<OverridingClass> ("OverridingClass");
+        LAYOUT_BASE (report, object, PolymorphicClass);
+        report.print ();
+    }
+    {
+        layout::reportFor<A> ("A").print ();
+    }
+    {
+        const B& object = specimen<B> ();
+        layout::LayoutReport report = layout::reportFor<B> ("B", true);
+        LAYOUT_BASE (report, object, A);
+        report.print ();
+    }
+    {
+        const C& object = specimen<C> ();
+        layout::LayoutReport report = layout::reportFor<C> ("C", true);
+        LAYOUT_BASE (report, object, A);
+        report.print ();
+    }
+    {
+        const D& object = specimen<D> ();
+        layout::LayoutReport report = layout::reportFor<D> ("D", true);
+        LAYOUT_BASE (report, object, B);
+        LAYOUT_BASE (report, object, C);
+        LAYOUT_BASE (report, object, A);
+        report.print ();
+    }
+    {
+        const ComposedD& object = specimen<ComposedD> ();
+        layout::LayoutReport report = layout::reportFor<ComposedD> ("ComposedD");
+        LAYOUT_MEMBER (report, object, ComposedD, a);
+        report.print ();
+    }
+    {
+        const ParentSlicerClass& object = specimen<ParentSlicerClass> ();
+        layout::LayoutReport report = layout::reportFor<ParentSlicerClass> ("ParentSlicerClass");
+        LAYOUT_MEMBER (report, object, ParentSlicerClass, a);
+        LAYOUT_MEMBER (report, object, ParentSlicerClass, b);
+        report.print ();
+    }
+    {
+        const ClassToBeSliced& object = specimen<ClassToBeSliced> ();
+        layout::LayoutReport report = layout::reportFor<ClassToBeSliced> ("ClassToBeSliced");
+        LAYOUT_BASE (report, object, ParentSlicerClass);
+        LAYOUT_MEMBER (report, object, ParentSlicerClass, a);
+        LAYOUT_MEMBER (report, object, ParentSlicerClass, b);
+        LAYOUT_MEMBER (report, object, ClassToBeSliced, a);
+        LAYOUT_MEMBER (report, object, ClassToBeSliced, b);
+        LAYOUT_MEMBER (report, object, ClassToBeSliced, c);
+        LAYOUT_MEMBER (report, object, ClassToBeSliced, d);
+        report.print ();
+    }
+
+    /*==# THE END #==*/
+    return 0;
+}
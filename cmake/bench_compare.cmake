@@ -0,0 +1,178 @@
+#====# BENCHMARK COMPARISON #====#
+#
+# Compares the --bench --json output of a chapter (include/bench_metrics.h)
+# against a stored baseline and fails when a metric got worse than allowed:
+#
+#   ns_per_op, <counter>_per_op    more than THRESHOLD percent, and by at
+#                                  least one whole unit (5.2 -> 5.9 ns is noise)
+#   allocations_per_op, bytes_per_op  any growth: they do not depend on the
+#                                  machine, a copy that allocates once more
+#                                  is a change of the code
+#
+# BASELINE and CURRENT may list several runs, every metric takes its best
+# (lowest) value on each side: a whole process can come out 30% slower than
+# the one before it (frequency, placement, neighbours on a VM), the best of a
+# few is far steadier than any single one.
+# A metric the current runs do not have (no hardware counters here) is
+# skipped, a scenario they do not have fails.
+#
+# Usage (./init.sh bench-check runs it for every chapter):
+#
+#   cmake -DBASELINE="bench_baseline/Chapter_01.1.json;..." -DCURRENT="run_1.json;run_2.json" -P cmake/bench_compare.cmake
+#
+#   BASELINE   one or more stored --bench --json outputs
+#   CURRENT    one or more --bench --json outputs to check
+#   THRESHOLD  percent a timing or counter may grow, default 10
+#
+
+cmake_minimum_required(VERSION 3.19)
+
+if(NOT BASELINE OR NOT CURRENT)
+    message(FATAL_ERROR "Usage: cmake -DBASELINE=<json>[;<json>...] -DCURRENT=<json>[;<json>...] [-DTHRESHOLD=10] -P cmake/bench_compare.cmake")
+endif()
+if(NOT DEFINED THRESHOLD)
+    set(THRESHOLD 10)
+endif()
+set(EXACT_METRICS allocations_per_op bytes_per_op)
+
+# "1055.2349999999999" -> 1055235, math () only knows integers
+function(toMilli value output_var)
+    if(NOT value MATCHES "^([0-9]+)(\\.([0-9]*))?$")
+        message(FATAL_ERROR "Not a metric value: ${value}")
+    endif()
+    set(whole "${CMAKE_MATCH_1}")
+    string(SUBSTRING "${CMAKE_MATCH_3}0000" 0 4 fraction)
+    string(SUBSTRING "${fraction}" 0 3 thousandths)
+    string(SUBSTRING "${fraction}" 3 1 rounding)
+    math(EXPR milli "${whole} * 1000 + 1${thousandths} - 1000")
+    if(rounding GREATER_EQUAL 5)
+        math(EXPR milli "${milli} + 1")
+    endif()
+    set(${output_var} ${milli} PARENT_SCOPE)
+endfunction()
+
+# 12345 -> "12.345"
+function(formatMilli value output_var)
+    math(EXPR whole "${value} / 1000")
+    math(EXPR fraction "${value} % 1000 + 1000")
+    string(SUBSTRING "${fraction}" 1 3 fraction)
+    set(${output_var} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+# The metrics object of the scenario called name in json, "" when there is none.
+function(scenarioMetrics json name output_var)
+    string(JSON count LENGTH "${json}" scenarios)
+    set(metrics "")
+    if(count GREATER 0)
+        math(EXPR last "${count} - 1")
+        foreach(index RANGE ${last})
+            string(JSON scenario GET "${json}" scenarios ${index} name)
+            if(scenario STREQUAL name)
+                string(JSON metrics GET "${json}" scenarios ${index} metrics)
+                break()
+            endif()
+        endforeach()
+    endif()
+    set(${output_var} "${metrics}" PARENT_SCOPE)
+endfunction()
+
+# The lowest value of metric for the scenario called name over the runs in files, unset when none has it.
+function(bestOf files name metric output_var)
+    unset(best)
+    foreach(path ${files})
+        file(READ "${path}" run)
+        scenarioMetrics("${run}" "${name}" metrics)
+        if(metrics STREQUAL "")
+            continue()
+        endif()
+        string(JSON value ERROR_VARIABLE missing GET "${metrics}" ${metric})
+        if(missing)
+            continue()
+        endif()
+        toMilli("${value}" current)
+        if(NOT DEFINED best OR current LESS best)
+            set(best ${current})
+        endif()
+    endforeach()
+    if(DEFINED best)
+        set(${output_var} ${best} PARENT_SCOPE)
+    else()
+        unset(${output_var} PARENT_SCOPE)
+    endif()
+endfunction()
+
+# The scenarios and metrics to check are those of the first baseline run
+list(GET BASELINE 0 first_baseline)
+file(READ "${first_baseline}" baseline)
+list(LENGTH BASELINE baseline_count)
+list(LENGTH CURRENT run_count)
+
+string(JSON chapter GET "${baseline}" chapter)
+message(STATUS "${chapter}: best of ${run_count} run(s) against the best of ${baseline_count} in ${first_baseline}, threshold ${THRESHOLD}%")
+
+set(regressions 0)
+string(JSON scenario_count LENGTH "${baseline}" scenarios)
+math(EXPR last_scenario "${scenario_count} - 1")
+foreach(scenario_index RANGE ${last_scenario})
+    string(JSON name GET "${baseline}" scenarios ${scenario_index} name)
+    string(JSON base_metrics GET "${baseline}" scenarios ${scenario_index} metrics)
+
+    foreach(path ${CURRENT})
+        file(READ "${path}" run)
+        scenarioMetrics("${run}" "${name}" metrics)
+        if(metrics STREQUAL "")
+            message(STATUS "  ${name}: missing from ${path}  REGRESSED")
+            math(EXPR regressions "${regressions} + 1")
+        endif()
+    endforeach()
+
+    string(JSON metric_count LENGTH "${base_metrics}")
+    math(EXPR last_metric "${metric_count} - 1")
+    foreach(metric_index RANGE ${last_metric})
+        string(JSON metric MEMBER "${base_metrics}" ${metric_index})
+        bestOf("${BASELINE}" "${name}" ${metric} base)
+        bestOf("${CURRENT}" "${name}" ${metric} best)
+        if(NOT DEFINED best)
+            message(STATUS "  ${name}, ${metric}: not measured, skipped")
+            continue()
+        endif()
+        if(metric IN_LIST EXACT_METRICS)
+            set(limit ${base})
+        else()
+            math(EXPR limit "${base} * (100 + ${THRESHOLD}) / 100")
+            math(EXPR floor "${base} + 1000")
+            if(limit LESS floor)
+                set(limit ${floor})
+            endif()
+        endif()
+
+        formatMilli(${base} base_text)
+        formatMilli(${best} best_text)
+        if(base GREATER 0)
+            math(EXPR permille "(${best} - ${base}) * 1000 / ${base}")
+            if(permille LESS 0)
+                math(EXPR permille "0 - ${permille}")
+                set(sign "-")
+            else()
+                set(sign "+")
+            endif()
+            math(EXPR percent "${permille} / 10")
+            math(EXPR tenth "${permille} % 10")
+            set(change "${sign}${percent}.${tenth}%")
+        else()
+            set(change "new")
+        endif()
+        if(best GREATER limit)
+            set(verdict "  REGRESSED")
+            math(EXPR regressions "${regressions} + 1")
+        else()
+            set(verdict "")
+        endif()
+        message(STATUS "  ${name}, ${metric}: ${base_text} -> ${best_text} (${change})${verdict}")
+    endforeach()
+endforeach()
+
+if(regressions GREATER 0)
+    message(FATAL_ERROR "${chapter}: ${regressions} regression(s) against ${first_baseline}")
+endif()
+message(STATUS "${chapter}: no regressions")
@@ -0,0 +1,69 @@
+#====# OPTIMIZATION FLAGS #====#
+#
+# Profile guided and link time optimization for every chapter target,
+# driven by two cache variables. cmake/optimize.cmake runs the whole
+# pipeline (instrument, train, rebuild, compare), these are its building
+# blocks:
+#
+#   SANDBOX_PGO  OFF       no profile (default)
+#                GENERATE  instrumented build, every run adds to the profile
+#                USE       optimized with the profile of the GENERATE runs
+#   SANDBOX_LTO  ON        link time optimization with whole program
+#                          devirtualization of the chapter 03 virtual calls
+#
+# GCC writes the profile next to the object files, so GENERATE and USE
+# must be the same build directory. Clang writes raw profiles to
+# SANDBOX_PROFILE_DIR, they are merged into sandbox.profdata before USE.
+#
+# GCC has no ThinLTO and no -fwhole-program-vtables: -flto=auto is its
+# partitioned (parallel) LTO, and for an executable the linker plugin
+# tells it that no vtable can be seen from outside, so the IPA
+# devirtualization works on the whole program. -fprofile-use adds value
+# profiling: a virtual call that mostly hits one type becomes a type check
+# and a direct, inlinable call.
+#
+
+set(SANDBOX_PGO "OFF" CACHE STRING "Profile guided optimization: OFF, GENERATE or USE")
+set_property(CACHE SANDBOX_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(SANDBOX_PROFILE_DIR "${CMAKE_BINARY_DIR}/profile" CACHE PATH "Where Clang writes and reads the profile")
+option(SANDBOX_LTO "Link time optimization with whole program devirtualization" OFF)
+
+if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    set(SANDBOX_PGO_GENERATE -fprofile-generate=${SANDBOX_PROFILE_DIR})
+    set(SANDBOX_PGO_USE -fprofile-use=${SANDBOX_PROFILE_DIR}/sandbox.profdata -Wno-error=profile-instr-unprofiled
+        -Wno-error=profile-instr-out-of-date)
+    # Hidden visibility gives the classes hidden LTO visibility, which -fwhole-program-vtables needs
+    set(SANDBOX_LTO_COMPILE -flto=thin -fwhole-program-vtables -fvisibility=hidden)
+    set(SANDBOX_LTO_LINK -flto=thin -fwhole-program-vtables -fuse-ld=lld)
+elseif(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+    # atomic: the seqlock and work stealing benchmarks train with several threads
+    set(SANDBOX_PGO_GENERATE -fprofile-generate -fprofile-update=atomic)
+    # Code the training did not reach is optimized as usual, not for size
+    set(SANDBOX_PGO_USE -fprofile-use -fprofile-correction -fprofile-partial-training -Wno-error=missing-profile)
+    set(SANDBOX_LTO_COMPILE -flto=auto -fdevirtualize-at-ltrans)
+    set(SANDBOX_LTO_LINK -flto=auto -fdevirtualize-at-ltrans -fuse-linker-plugin)
+elseif(NOT SANDBOX_PGO STREQUAL "OFF" OR SANDBOX_LTO)
+    message(FATAL_ERROR "SANDBOX_PGO / SANDBOX_LTO: no flags for ${CMAKE_CXX_COMPILER_ID}")
+endif()
+
+if(SANDBOX_PGO STREQUAL "GENERATE")
+    add_compile_options(${SANDBOX_PGO_GENERATE})
+    add_link_options(${SANDBOX_PGO_GENERATE})
+elseif(SANDBOX_PGO STREQUAL "USE")
+    add_compile_options(${SANDBOX_PGO_USE})
+    add_link_options(${SANDBOX_PGO_USE})
+elseif(NOT SANDBOX_PGO STREQUAL "OFF")
+    message(FATAL_ERROR "SANDBOX_PGO must be OFF, GENERATE or USE, not ${SANDBOX_PGO}")
+endif()
+
+if(SANDBOX_LTO)
+    add_compile_options(${SANDBOX_LTO_COMPILE})
+    add_link_options(${SANDBOX_LTO_LINK})
+    # Static libraries (sandbox_bench) hold LTO objects, only the plugin aware ar can index them
+    if(CMAKE_CXX_COMPILER_AR AND CMAKE_CXX_COMPILER_RANLIB)
+        set(CMAKE_AR ${CMAKE_CXX_COMPILER_AR})
+        set(CMAKE_RANLIB ${CMAKE_CXX_COMPILER_RANLIB})
+    endif()
+endif()
+
+message(STATUS "Optimization: PGO ${SANDBOX_PGO}, LTO ${SANDBOX_LTO}")
@@ -0,0 +1,295 @@
+#====# OPTIMIZATION PIPELINE #====#
+#
+# Builds the chapters twice and tells how much the second one gained:
+#
+#   release    plain Release build, the baseline
+#   optimized  1. instrumented build (SANDBOX_PGO=GENERATE)
+#              2. training: the chapter scenarios and the benchmarks,
+#                 with smaller counts, fill the profile
+#              3. rebuilt in place with SANDBOX_PGO=USE and SANDBOX_LTO=ON
+#
+# Then every benchmark runs against both builds, in turns, REPEAT times,
+# and report.md gets the best ns/op of each strategy, release next to
+# optimized, and the size of every executable.
+#
+# Usage (from the repository root, or ./init.sh optimize):
+#
+#   cmake -P cmake/optimize.cmake
+#   cmake -DBUILD_ROOT=/tmp/opt -DREPEAT=5 -DREPORT_ONLY=ON -P cmake/optimize.cmake
+#
+#   BUILD_ROOT   where release/ and optimized/ go, default build_optimized
+#   REPEAT       runs per benchmark and build for the report, default 3
+#   REPORT_ONLY  skip the builds, compare what is already there
+#
+# Training and report use the same counts (BENCH_ARGUMENTS below), chosen
+# so a run takes well under a second on a Release build. The benchmarks
+# themselves come from the BENCHMARKS list of every chapter's CMakeLists.txt,
+# one without a count stops the pipeline before anything is built.
+#
+
+# file(SIZE) needs 3.14
+cmake_minimum_required(VERSION 3.14)
+
+get_filename_component(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+if(NOT BUILD_ROOT)
+    set(BUILD_ROOT "${SOURCE_DIR}/build_optimized")
+endif()
+if(NOT REPEAT)
+    set(REPEAT 3)
+endif()
+set(RELEASE_DIR "${BUILD_ROOT}/release")
+set(OPTIMIZED_DIR "${BUILD_ROOT}/optimized")
+set(REPORT "${BUILD_ROOT}/report.md")
+cmake_host_system_information(RESULT JOBS QUERY NUMBER_OF_LOGICAL_CORES)
+
+# "executable, relative to the build directory|arguments" - the scenarios, the benchmarks get appended
+set(TRAINING_RUNS
+    "chapter_00/Chapter_00|"
+    "chapter_01_rule_of_five/Chapter_01|"
+    "chapter_02_templates_name_mangling/Chapter_02|"
+    "chapter_03_inheritance/Chapter_03|"
+    "chapter_03_inheritance/Chapter_03_layout|"
+)
+
+# "benchmark executable|arguments"
+set(BENCH_ARGUMENTS
+    "Chapter_01_bench_mapped_store|1000000"
+    "Chapter_01_bench_seqlock|200000"
+    "Chapter_01_bench_shm_ring|100000"
+    "Chapter_01_bench_storage|100000 --rounds 5 --warmup-ms 200"
+    "Chapter_03_bench_arena|200000"
+    "Chapter_03_bench_arena_clone|200000"
+    "Chapter_03_bench_batch_virtual|1000000"
+    "Chapter_03_bench_columns|5000000"
+    "Chapter_03_bench_devirtualization|1000000"
+    "Chapter_03_bench_diamond|1000000"
+    "Chapter_03_bench_double_dispatch|1000000"
+    "Chapter_03_bench_flat_format|500000"
+    "Chapter_03_bench_intrusive|200000"
+    "Chapter_03_bench_packed_column|5000000"
+    "Chapter_03_bench_poly_collection|1000000"
+    "Chapter_03_bench_poly_value|1000000"
+    "Chapter_03_bench_pooled_new|1000000"
+    "Chapter_03_bench_work_stealing|24"
+)
+
+# Every chapter's BENCHMARKS, with their arguments, go after the scenarios
+foreach(entry ${BENCH_ARGUMENTS})
+    string(REGEX MATCH "^[^|]+" name "${entry}")
+    set(arguments_${name} "${entry}")
+endforeach()
+file(GLOB chapter_lists RELATIVE ${SOURCE_DIR} "${SOURCE_DIR}/chapter_*/CMakeLists.txt")
+set(benchmarks "")
+set(missing "")
+foreach(chapter_list ${chapter_lists})
+    get_filename_component(chapter "${chapter_list}" DIRECTORY)
+    file(READ "${SOURCE_DIR}/${chapter_list}" content)
+    if(NOT content MATCHES "set\\(APPNAME \"([^\"]+)\"\\)")
+        continue()
+    endif()
+    set(appname "${CMAKE_MATCH_1}")
+    if(NOT content MATCHES "set\\(BENCHMARKS([^)]*)\\)")
+        continue()
+    endif()
+    string(REGEX MATCHALL "[^ \t\n]+\\.cpp" sources "${CMAKE_MATCH_1}")
+    foreach(source ${sources})
+        get_filename_component(bench "${source}" NAME_WE)
+        set(name "${appname}_bench_${bench}")
+        list(APPEND benchmarks ${name})
+        if(DEFINED arguments_${name})
+            list(APPEND TRAINING_RUNS "${chapter}/${arguments_${name}}")
+        else()
+            list(APPEND missing ${name})
+        endif()
+    endforeach()
+endforeach()
+if(missing)
+    string(REPLACE ";" ", " missing "${missing}")
+    message(FATAL_ERROR "No BENCH_ARGUMENTS in cmake/optimize.cmake for: ${missing}")
+endif()
+foreach(entry ${BENCH_ARGUMENTS})
+    string(REGEX MATCH "^[^|]+" name "${entry}")
+    if(NOT name IN_LIST benchmarks)
+        message(FATAL_ERROR "BENCH_ARGUMENTS in cmake/optimize.cmake names ${name}, no chapter builds it")
+    endif()
+endforeach()
+
+function(say)
+    message(STATUS "#====[ Optimize ]===# ${ARGN}")
+endfunction()
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Failed (${result}): ${ARGN}")
+    endif()
+endfunction()
+
+function(configureAndBuild directory)
+    run(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${directory} -DCMAKE_BUILD_TYPE=Release ${ARGN})
+    run(${CMAKE_COMMAND} --build ${directory} -j ${JOBS})
+endfunction()
+
+# Splits "path|arguments" into the executable in directory and its argument list.
+function(parseRun entry directory executable_var arguments_var)
+    string(REPLACE "|" ";" parts "${entry}")
+    list(GET parts 0 path)
+    list(LENGTH parts length)
+    set(arguments "")
+    if(length GREATER 1)
+        list(GET parts 1 arguments)
+        separate_arguments(arguments UNIX_COMMAND "${arguments}")
+    endif()
+    set(${executable_var} "${directory}/${path}" PARENT_SCOPE)
+    set(${arguments_var} "${arguments}" PARENT_SCOPE)
+endfunction()
+
+# Runs entry from the build in directory, its output (with [ ] and ; made list safe) goes to output_var.
+function(runEntry entry directory output_var)
+    parseRun("${entry}" "${directory}" executable arguments)
+    get_filename_component(working_directory "${executable}" DIRECTORY)
+    execute_process(COMMAND ${executable} ${arguments} WORKING_DIRECTORY ${working_directory}
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Failed (${result}): ${executable} ${arguments}\n${output}${errors}")
+    endif()
+    string(REPLACE ";" "," output "${output}")
+    string(REPLACE "[" "(" output "${output}")
+    string(REPLACE "]" ")" output "${output}")
+    set(${output_var} "${output}" PARENT_SCOPE)
+endfunction()
+
+# 1. BUILDS #
+
+if(NOT REPORT_ONLY)
+    say("Release build in ${RELEASE_DIR}")
+    configureAndBuild(${RELEASE_DIR} -DSANDBOX_PGO=OFF -DSANDBOX_LTO=OFF)
+
+    say("Instrumented build in ${OPTIMIZED_DIR}")
+    configureAndBuild(${OPTIMIZED_DIR} -DSANDBOX_PGO=GENERATE -DSANDBOX_LTO=OFF)
+    file(GLOB_RECURSE old_profiles "${OPTIMIZED_DIR}/*.gcda" "${OPTIMIZED_DIR}/profile/*")
+    if(old_profiles)
+        file(REMOVE ${old_profiles})
+    endif()
+
+    foreach(entry ${TRAINING_RUNS})
+        say("Training: ${entry}")
+        runEntry("${entry}" ${OPTIMIZED_DIR} output)
+    endforeach()
+
+    # Clang leaves raw profiles, GCC its .gcda files next to the objects
+    file(GLOB raw_profiles "${OPTIMIZED_DIR}/profile/*.profraw")
+    if(raw_profiles)
+        find_program(LLVM_PROFDATA NAMES llvm-profdata REQUIRED)
+        run(${LLVM_PROFDATA} merge -output=${OPTIMIZED_DIR}/profile/sandbox.profdata ${raw_profiles})
+    endif()
+
+    say("PGO + LTO build in ${OPTIMIZED_DIR}")
+    configureAndBuild(${OPTIMIZED_DIR} -DSANDBOX_PGO=USE -DSANDBOX_LTO=ON)
+endif()
+
+# 2. COMPARISON #
+#
+# A result line of bench_util.h: strategy (may hold spaces), ns/op with
+# three decimals, br-miss/op, IPC. ns/op is kept in picoseconds, math ()
+# only knows integers.
+
+set(RESULT_LINE "^(.*[^ ]) +([0-9]+)\\.([0-9][0-9][0-9]) +([0-9.]+|n/a) +([0-9.]+|n/a)$")
+
+# 12345 -> "12.345"
+function(formatMilli value output_var)
+    math(EXPR whole "${value} / 1000")
+    math(EXPR fraction "${value} % 1000 + 1000")
+    string(SUBSTRING "${fraction}" 1 3 fraction)
+    set(${output_var} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+set(keys "")
+foreach(round RANGE 1 ${REPEAT})
+    foreach(entry ${TRAINING_RUNS})
+        parseRun("${entry}" "" path arguments)
+        get_filename_component(name "${path}" NAME)
+        if(NOT name MATCHES "_bench_")
+            continue()
+        endif()
+        say("Comparing (${round}/${REPEAT}): ${name}")
+        foreach(build release optimized)
+            if(build STREQUAL "release")
+                runEntry("${entry}" ${RELEASE_DIR} output)
+            else()
+                runEntry("${entry}" ${OPTIMIZED_DIR} output)
+            endif()
+            string(REPLACE "\n" ";" lines "${output}")
+            set(section "")
+            foreach(line ${lines})
+                if(line MATCHES "^## (.*) ##$")
+                    set(section "${CMAKE_MATCH_1}")
+                elseif(line MATCHES "${RESULT_LINE}" AND NOT CMAKE_MATCH_1 STREQUAL "strategy")
+                    set(key "${name}|${section}|${CMAKE_MATCH_1}")
+                    string(MD5 id "${key}")
+                    math(EXPR picoseconds "${CMAKE_MATCH_2} * 1000 + 1${CMAKE_MATCH_3} - 1000")
+                    if(NOT DEFINED best_${build}_${id} OR picoseconds LESS best_${build}_${id})
+                        set(best_${build}_${id} ${picoseconds})
+                    endif()
+                    if(NOT key IN_LIST keys)
+                        list(APPEND keys "${key}")
+                    endif()
+                endif()
+            endforeach()
+        endforeach()
+    endforeach()
+endforeach()
+
+string(TIMESTAMP now "%Y-%m-%d %H:%M")
+set(text "# Optimized build report\n\n${now}, best of ${REPEAT} runs per build.\n\n")
+string(APPEND text "* release: `-DCMAKE_BUILD_TYPE=Release`\n")
+string(APPEND text "* optimized: the same with `-DSANDBOX_PGO=USE -DSANDBOX_LTO=ON`, trained on the scenarios and benchmarks\n\n")
+string(APPEND text "## Benchmarks\n\n")
+string(APPEND text "| benchmark | section | strategy | release ns/op | optimized ns/op | speedup |\n")
+string(APPEND text "|---|---|---|---:|---:|---:|\n")
+set(faster 0)
+set(slower 0)
+set(compared 0)
+foreach(key ${keys})
+    string(MD5 id "${key}")
+    string(REPLACE "|" ";" fields "${key}")
+    list(GET fields 0 name)
+    list(GET fields 1 section)
+    list(GET fields 2 strategy)
+    string(REGEX REPLACE "^Chapter_0._bench_" "" name "${name}")
+    if(NOT DEFINED best_release_${id} OR NOT DEFINED best_optimized_${id})
+        string(APPEND text "| ${name} | ${section} | ${strategy} | | | missing |\n")
+        continue()
+    endif()
+    formatMilli(${best_release_${id}} release)
+    formatMilli(${best_optimized_${id}} optimized)
+    if(best_optimized_${id} GREATER 0)
+        math(EXPR ratio "${best_release_${id}} * 1000 / ${best_optimized_${id}}")
+        formatMilli(${ratio} speedup)
+        set(speedup "${speedup}x")
+        math(EXPR compared "${compared} + 1")
+        # 3% either way counts as noise
+        if(ratio GREATER 1030)
+            math(EXPR faster "${faster} + 1")
+        elseif(ratio LESS 970)
+            math(EXPR slower "${slower} + 1")
+        endif()
+    else()
+        set(speedup "-")
+    endif()
+    string(APPEND text "| ${name} | ${section} | ${strategy} | ${release} | ${optimized} | ${speedup} |\n")
+endforeach()
+string(APPEND text "\n${compared} strategies compared: ${faster} faster, ${slower} slower by more than 3%.\n")
+
+string(APPEND text "\n## Executable size\n\n| executable | release bytes | optimized bytes |\n|---|---:|---:|\n")
+foreach(entry ${TRAINING_RUNS})
+    parseRun("${entry}" "" path arguments)
+    get_filename_component(name "${path}" NAME)
+    file(SIZE "${RELEASE_DIR}/${path}" release_size)
+    file(SIZE "${OPTIMIZED_DIR}/${path}" optimized_size)
+    string(APPEND text "| ${name} | ${release_size} | ${optimized_size} |\n")
+endforeach()
+
+file(WRITE ${REPORT} "${text}")
+say("${compared} strategies compared: ${faster} faster, ${slower} slower by more than 3%")
+say("Report: ${REPORT}")
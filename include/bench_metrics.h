@@ -0,0 +1,294 @@
+/*====# SCENARIO METRICS #====*/
+/*
+
+The chapter scenarios, measured and written out for a machine to read, so a
+regression (a TestClass copy that suddenly allocates twice) fails a check
+instead of waiting for someone to notice it in the output.
+
+    Chapter_01 --bench [--json] [operations, default 100000] [--runs N]
+
+Every scenario runs `operations` times per run, untimed once to warm up, then
+N times (default 5). The fastest run is reported, per operation:
+
+* ns_per_op           - wall clock time
+* allocations_per_op  - malloc, calloc and realloc calls (operator new ends
+  bytes_per_op          in malloc), with BENCH_COUNT_ALLOCATIONS () in the
+                        executable, left out without it. Only the timed
+                        runs count, the rest of the program pays one
+                        relaxed load per malloc.
+* <counter>_per_op    - the hardware counters of bench_util.h the machine
+                        has, left out when it has none
+
+    bench::ScenarioBench bench ("Chapter_01", argc, argv);
+    bench::SilencedStream quiet (std::cout); // the scenarios log a lot
+    bench.add ("copy constructor", [&] () { TestClass copy = original; });
+    return bench.finish ();
+
+--json prints one object per chapter, cmake/bench_compare.cmake compares it
+against a stored baseline:
+
+    { "chapter": "Chapter_01", "operations": 100000, "runs": 5, "scenarios": [
+        { "name": "copy constructor", "metrics": { "ns_per_op": 61.250, "allocations_per_op": 2.000, ... } } ] }
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+
+/*==# DEFINES #==*/
+
+#define BENCH_METRICS_DEFAULT_OPERATIONS 100000
+#define BENCH_METRICS_DEFAULT_RUNS 5
+
+// The allocator underneath malloc, glibc exports it for exactly this.
+extern "C" void* __libc_malloc (std::size_t size) noexcept;
+extern "C" void* __libc_calloc (std::size_t count, std::size_t size) noexcept;
+extern "C" void* __libc_realloc (void* pointer, std::size_t size) noexcept;
+
+// Once, at namespace scope, in the executable: its malloc, calloc and realloc
+// interpose the ones of libc for the whole process (libstdc++ included),
+// count while a scenario is measured and forward. memalign and friends are
+// not counted.
+#define BENCH_COUNT_ALLOCATIONS()                                                  \
+    extern "C" void* malloc (std::size_t size) noexcept {                          \
+        bench::countAllocation (size);                                             \
+        return __libc_malloc (size);                                               \
+    }                                                                              \
+    extern "C" void* calloc (std::size_t count, std::size_t size) noexcept {       \
+        bench::countAllocation (count * size);                                     \
+        return __libc_calloc (count, size);                                        \
+    }                                                                              \
+    extern "C" void* realloc (void* pointer, std::size_t size) noexcept {          \
+        bench::countAllocation (size);                                             \
+        return __libc_realloc (pointer, size);                                     \
+    }                                                                              \
+    static const bool bench_allocations_counted = bench::allocation_counting = true; \
+    extern "C" void* malloc (std::size_t size) noexcept
+
+namespace bench {
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// 1. ALLOCATION COUNTS //
+
+struct Allocations {
+    std::uint64_t count = 0;
+    std::uint64_t bytes = 0;
+};
+
+inline std::atomic<std::uint64_t> allocation_count{ 0 };
+inline std::atomic<std::uint64_t> allocated_bytes{ 0 };
+inline bool allocation_counting = false; // BENCH_COUNT_ALLOCATIONS () is in the executable
+inline std::atomic<bool> counting_active{ false }; // a ScenarioBench run is being measured
+
+// Outside a measurement a relaxed load and a branch, the scenarios run
+// normally and --profile does not see the counters.
+inline void countAllocation (std::size_t size) {
+    if (!counting_active.load (std::memory_order_relaxed)) {
+        return;
+    }
+    allocation_count.fetch_add (1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add (size, std::memory_order_relaxed);
+}
+
+inline Allocations allocationsSoFar () {
+    return { allocation_count.load (std::memory_order_relaxed), allocated_bytes.load (std::memory_order_relaxed) };
+}
+
+/*==# CLASSES #==*/
+
+// 2. SILENCED STREAM //
+
+// Swallows everything, through a buffer like the console's: the formatting
+// still costs what it costs, only the terminal is gone.
+class NullBuffer : public std::streambuf {
+
+    private:
+    char buffer[256];
+
+    public:
+    NullBuffer () {
+        setp (buffer, buffer + sizeof (buffer));
+    }
+
+    protected:
+    int overflow (int character) override {
+        setp (buffer, buffer + sizeof (buffer));
+        return character;
+    }
+};
+
+// stream writes into a NullBuffer until this goes out of scope.
+class SilencedStream {
+
+    private:
+    std::ostream& stream;
+    NullBuffer nowhere;
+    std::streambuf* original;
+
+    public:
+    explicit SilencedStream (std::ostream& silenced)
+    : stream (silenced), original (silenced.rdbuf (&nowhere)) {
+    }
+
+    ~SilencedStream () {
+        stream.rdbuf (original);
+    }
+
+    SilencedStream (const SilencedStream&)            = delete;
+    SilencedStream& operator= (const SilencedStream&) = delete;
+};
+
+// 3. SCENARIO BENCH //
+
+struct ScenarioResult {
+    Result timing; // the fastest run
+    Allocations allocations;
+};
+
+class ScenarioBench {
+
+    private:
+    std::string chapter;
+    bool json              = false;
+    std::size_t operations = BENCH_METRICS_DEFAULT_OPERATIONS;
+    int runs               = BENCH_METRICS_DEFAULT_RUNS;
+    std::vector<ScenarioResult> results;
+
+    // "L1D-misses" -> "L1D_misses_per_op"
+    static std::string metricName (const char* counter) {
+        std::string name = counter;
+        for (char& character : name) {
+            character = character == '-' ? '_' : character;
+        }
+        return name + "_per_op";
+    }
+
+    static std::string quoted (const std::string& text) {
+        std::string escaped = "\"";
+        for (char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped += '\\';
+            }
+            escaped += character;
+        }
+        return escaped + "\"";
+    }
+
+    double perOp (std::uint64_t value) const {
+        return static_cast<double> (value) / static_cast<double> (operations);
+    }
+
+    void printTable () const {
+        std::printf ("%s scenarios, %zu operations, fastest of %d runs\n", chapter.c_str (), operations, runs);
+        std::printf ("%-34s %10s %10s %10s %14s %8s\n", "scenario", "ns/op", "allocs/op", "bytes/op", "br-miss/op", "IPC");
+        for (const ScenarioResult& result : results) {
+            std::printf ("%-34s %10.3f ", result.timing.name.c_str (), result.timing.nsPerOp ());
+            if (allocation_counting) {
+                std::printf ("%10.3f %10.3f ", perOp (result.allocations.count), perOp (result.allocations.bytes));
+            } else {
+                std::printf ("%10s %10s ", "n/a", "n/a");
+            }
+            const CounterSample& counters = result.timing.counters;
+            if (counters.valid[COUNTER_BRANCH_MISSES]) {
+                std::printf ("%14.4f ", result.timing.perOp (COUNTER_BRANCH_MISSES));
+            } else {
+                std::printf ("%14s ", "n/a");
+            }
+            if (counters.valid[COUNTER_CYCLES] && counters.valid[COUNTER_INSTRUCTIONS]) {
+                std::printf ("%8.2f\n", counters.ipc ());
+            } else {
+                std::printf ("%8s\n", "n/a");
+            }
+        }
+    }
+
+    void printJson () const {
+        std::printf ("{\n  \"chapter\": %s,\n  \"operations\": %zu,\n  \"runs\": %d,\n  \"scenarios\": [",
+        quoted (chapter).c_str (), operations, runs);
+        for (std::size_t i = 0; i < results.size (); ++i) {
+            const ScenarioResult& result = results[i];
+            std::printf ("%s\n    { \"name\": %s, \"metrics\": { \"ns_per_op\": %.3f", i ? "," : "",
+            quoted (result.timing.name).c_str (), result.timing.nsPerOp ());
+            if (allocation_counting) {
+                std::printf (", \"allocations_per_op\": %.3f, \"bytes_per_op\": %.3f",
+                perOp (result.allocations.count), perOp (result.allocations.bytes));
+            }
+            for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+                if (result.timing.counters.valid[counter]) {
+                    std::printf (", \"%s\": %.3f", metricName (counter_configs[counter].name).c_str (),
+                    result.timing.perOp (static_cast<Counter> (counter)));
+                }
+            }
+            std::printf (" } }");
+        }
+        std::printf ("\n  ]\n}\n");
+    }
+
+    public:
+    // argv[1] is --bench, the rest: --json, --runs N and the operation count.
+    ScenarioBench (const char* chapter_name, int argc, char** argv) : chapter (chapter_name) {
+        for (int i = 2; i < argc; ++i) {
+            const std::string argument = argv[i];
+            if (argument == "--json") {
+                json = true;
+            } else if (argument == "--runs" && i + 1 < argc) {
+                runs = std::max (1, std::atoi (argv[++i]));
+            } else if (std::strtoull (argv[i], nullptr, 10) > 0) {
+                operations = static_cast<std::size_t> (std::strtoull (argv[i], nullptr, 10));
+            }
+        }
+    }
+
+    // operation () is one execution of the scenario.
+    template <typename Operation> void add (const std::string& name, Operation&& operation) {
+        auto body = [&] () {
+            for (std::size_t i = 0; i < operations; ++i) {
+                operation ();
+            }
+        };
+        body ();
+        ScenarioResult fastest;
+        for (int run = 0; run < runs; ++run) {
+            Allocations before;
+            Allocations after;
+            Result timing = measure (name, operations, [&] () {
+                counting_active.store (true, std::memory_order_relaxed);
+                before = allocationsSoFar ();
+                body ();
+                after = allocationsSoFar ();
+                counting_active.store (false, std::memory_order_relaxed);
+            });
+            if (run == 0 || timing.nanoseconds < fastest.timing.nanoseconds) {
+                fastest.timing      = timing;
+                fastest.allocations = { after.count - before.count, after.bytes - before.bytes };
+            }
+        }
+        results.push_back (fastest);
+    }
+
+    // Prints the results, the exit code of the --bench mode.
+    int finish () const {
+        if (json) {
+            printJson ();
+        } else {
+            printTable ();
+        }
+        return 0;
+    }
+};
+
+} // namespace bench
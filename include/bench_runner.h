@@ -0,0 +1,422 @@
+/*====# BENCHMARK RUNNER #====*/
+/*
+
+measure () (bench_util.h) runs a body once. That is enough to see a 3x
+difference, not a 3% one: one run catches whatever the machine was doing at
+that moment. Runner compares variants of the same operation properly:
+
+* pinned      - the process moves to one CPU, an isolated one
+                (isolcpus=, /sys/devices/system/cpu/isolated) when there is
+                one, so caches and the frequency belong to the benchmark
+* warmed up   - every variant runs until its timings stop drifting
+                (caches, page faults, frequency), or the warmup time is up
+* interleaved - every round runs each variant once, in a shuffled order,
+                so a slow minute of the machine hits all variants alike
+* robust      - the report is the median of the rounds with a bootstrap 95%
+                confidence interval, and the speedup over the first variant
+                (the baseline) with its own interval. Only an interval that
+                excludes 1.0 is called faster or slower.
+* honest      - a variant whose rounds scatter too much (MAD / median), a
+                warmup that never settled, involuntary context switches and
+                CPU migrations during the rounds are all reported as noise
+
+    bench::RunnerOptions options = bench::prepareRunner (argc, argv);
+    bench::Runner runner (options);
+    runner.add ("baseline", count, [&] () { ... });
+    runner.add ("candidate", count, [&] () { ... });
+    runner.run ("TITLE");
+
+Options anywhere on the command line: --rounds N, --cpu N, --warmup-ms N.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+
+/*==# DEFINES #==*/
+
+#define BENCH_RUNNER_ROUNDS 21
+#define BENCH_RUNNER_BOOTSTRAP 2000
+#define BENCH_RUNNER_WARMUP_WINDOW 5
+#define BENCH_RUNNER_WARMUP_DRIFT 0.02 // between the medians of two windows
+#define BENCH_RUNNER_WARMUP_MS 2000
+#define BENCH_RUNNER_NOISY_CV 0.03 // 1.4826 * MAD / median
+#define BENCH_RUNNER_SEED 0x5eed
+
+namespace bench {
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// 1. STATISTICS //
+
+inline double median (std::vector<double> values) {
+    if (values.empty ()) {
+        return 0.0;
+    }
+    const std::size_t middle = values.size () / 2;
+    std::nth_element (values.begin (), values.begin () + static_cast<std::ptrdiff_t> (middle), values.end ());
+    double result = values[middle];
+    if (values.size () % 2 == 0) {
+        result = (result + *std::max_element (values.begin (), values.begin () + static_cast<std::ptrdiff_t> (middle))) / 2;
+    }
+    return result;
+}
+
+// The spread of values relative to their median, a coefficient of variation
+// that one outlier cannot blow up. 1.4826 makes the MAD a standard deviation
+// for normal data.
+inline double robustVariation (const std::vector<double>& values) {
+    const double center = median (values);
+    if (center == 0.0) {
+        return 0.0;
+    }
+    std::vector<double> deviations;
+    deviations.reserve (values.size ());
+    for (double value : values) {
+        deviations.push_back (std::fabs (value - center));
+    }
+    return 1.4826 * median (deviations) / center;
+}
+
+struct Interval {
+    double low  = 0.0;
+    double high = 0.0;
+};
+
+// 2.5% and 97.5% percentiles of statistic () over resamples draws.
+template <typename Statistic> Interval bootstrap (std::size_t resamples, Statistic&& statistic) {
+    std::vector<double> estimates;
+    estimates.reserve (resamples);
+    for (std::size_t i = 0; i < resamples; ++i) {
+        estimates.push_back (statistic ());
+    }
+    std::sort (estimates.begin (), estimates.end ());
+    const std::size_t last = estimates.size () - 1;
+    return { estimates[static_cast<std::size_t> (0.025 * static_cast<double> (last))],
+        estimates[static_cast<std::size_t> (0.975 * static_cast<double> (last))] };
+}
+
+// The median of values drawn from samples with replacement.
+inline double resampledMedian (const std::vector<double>& samples, std::mt19937_64& generator) {
+    std::uniform_int_distribution<std::size_t> pick (0, samples.size () - 1);
+    std::vector<double> draw (samples.size ());
+    for (double& value : draw) {
+        value = samples[pick (generator)];
+    }
+    return median (std::move (draw));
+}
+
+// 2. ENVIRONMENT //
+
+// "0-3,6" -> 0 1 2 3 6, the format of the /sys cpu lists.
+inline std::vector<int> parseCpuList (const std::string& list) {
+    std::vector<int> cpus;
+    std::size_t at = 0;
+    while (at < list.size ()) {
+        char* end       = nullptr;
+        const long low  = std::strtol (list.c_str () + at, &end, 10);
+        long high       = low;
+        std::size_t pos = static_cast<std::size_t> (end - list.c_str ());
+        if (pos == at) {
+            break;
+        }
+        if (pos < list.size () && list[pos] == '-') {
+            high = std::strtol (list.c_str () + pos + 1, &end, 10);
+            pos  = static_cast<std::size_t> (end - list.c_str ());
+        }
+        for (long cpu = low; cpu <= high; ++cpu) {
+            cpus.push_back (static_cast<int> (cpu));
+        }
+        at = pos + 1; // past the comma
+    }
+    return cpus;
+}
+
+inline std::string readLine (const char* path) {
+    std::ifstream in (path);
+    std::string line;
+    std::getline (in, line);
+    return line;
+}
+
+struct Pinning {
+    int cpu       = -1; // -1: not pinned
+    bool isolated = false;
+};
+
+// Pins the calling thread (and the threads it starts later) to requested,
+// or to an isolated CPU we may run on, or to the last CPU we may run on
+// (CPU 0 takes most of the interrupts).
+inline Pinning pinToQuietCpu (int requested = -1) {
+    Pinning pinning;
+    cpu_set_t allowed;
+    CPU_ZERO (&allowed);
+    if (sched_getaffinity (0, sizeof (allowed), &allowed) != 0) {
+        return pinning;
+    }
+    const std::vector<int> isolated = parseCpuList (readLine ("/sys/devices/system/cpu/isolated"));
+    int cpu = requested;
+    if (cpu < 0) {
+        for (int candidate : isolated) {
+            if (candidate < CPU_SETSIZE && CPU_ISSET (static_cast<std::size_t> (candidate), &allowed)) {
+                cpu = candidate;
+                break;
+            }
+        }
+    }
+    if (cpu < 0) {
+        for (int candidate = CPU_SETSIZE - 1; candidate >= 0; --candidate) {
+            if (CPU_ISSET (static_cast<std::size_t> (candidate), &allowed)) {
+                cpu = candidate;
+                break;
+            }
+        }
+    }
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return pinning;
+    }
+    cpu_set_t one;
+    CPU_ZERO (&one);
+    CPU_SET (static_cast<std::size_t> (cpu), &one);
+    if (sched_setaffinity (0, sizeof (one), &one) != 0) {
+        return pinning;
+    }
+    pinning.cpu      = cpu;
+    pinning.isolated = std::find (isolated.begin (), isolated.end (), cpu) != isolated.end ();
+    return pinning;
+}
+
+inline long involuntarySwitches () {
+    rusage usage;
+    getrusage (RUSAGE_THREAD, &usage);
+    return usage.ru_nivcsw;
+}
+
+/*==# CLASSES #==*/
+
+// 3. RUNNER //
+
+struct RunnerOptions {
+    std::size_t rounds    = BENCH_RUNNER_ROUNDS;
+    int cpu               = -1;
+    long warmup_ms        = BENCH_RUNNER_WARMUP_MS;
+    std::size_t resamples = BENCH_RUNNER_BOOTSTRAP;
+
+    static RunnerOptions fromArgs (int argc, char** argv) {
+        RunnerOptions options;
+        for (int i = 1; i + 1 < argc; ++i) {
+            if (std::strcmp (argv[i], "--rounds") == 0) {
+                options.rounds = std::max<std::size_t> (3, std::strtoull (argv[i + 1], nullptr, 10));
+            } else if (std::strcmp (argv[i], "--cpu") == 0) {
+                options.cpu = std::atoi (argv[i + 1]);
+            } else if (std::strcmp (argv[i], "--warmup-ms") == 0) {
+                options.warmup_ms = std::atol (argv[i + 1]);
+            }
+        }
+        return options;
+    }
+};
+
+class Runner {
+
+    private:
+    struct Variant {
+        std::string name;
+        std::size_t operations;
+        std::function<void ()> body;
+        std::vector<double> samples; // ns/op, one per round
+        bool settled = false;
+    };
+
+    RunnerOptions options;
+    std::vector<Variant> variants;
+    std::mt19937_64 generator;
+
+    static double timeOnce (Variant& variant) {
+        const auto begin = std::chrono::steady_clock::now ();
+        variant.body ();
+        const auto end = std::chrono::steady_clock::now ();
+        const double nanoseconds =
+        static_cast<double> (std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ());
+        return nanoseconds / static_cast<double> (variant.operations ? variant.operations : 1);
+    }
+
+    // Round robin until every variant stops drifting: the median of its last
+    // WINDOW timings is within WARMUP_DRIFT of the WINDOW before. Jitter
+    // around a steady level is fine here, the cv of the rounds reports it.
+    // Returns the warmup rounds, or 0 when the time ran out first.
+    std::size_t warmUp () {
+        const auto deadline = std::chrono::steady_clock::now () + std::chrono::milliseconds (options.warmup_ms);
+        std::vector<std::vector<double>> recent (variants.size ());
+        for (std::size_t round = 1;; ++round) {
+            bool all_settled = true;
+            for (std::size_t i = 0; i < variants.size (); ++i) {
+                std::vector<double>& timings = recent[i];
+                timings.push_back (timeOnce (variants[i]));
+                if (timings.size () > 2 * BENCH_RUNNER_WARMUP_WINDOW) {
+                    timings.erase (timings.begin ());
+                }
+                variants[i].settled = false;
+                if (timings.size () == 2 * BENCH_RUNNER_WARMUP_WINDOW) {
+                    const auto middle     = timings.begin () + BENCH_RUNNER_WARMUP_WINDOW;
+                    const double before   = median (std::vector<double> (timings.begin (), middle));
+                    const double now      = median (std::vector<double> (middle, timings.end ()));
+                    variants[i].settled = now == 0.0 || std::fabs (now - before) / now <= BENCH_RUNNER_WARMUP_DRIFT;
+                }
+                all_settled = all_settled && variants[i].settled;
+            }
+            if (all_settled) {
+                return round;
+            }
+            if (std::chrono::steady_clock::now () > deadline) {
+                return 0;
+            }
+        }
+    }
+
+    Interval medianInterval (const Variant& variant) {
+        return bootstrap (options.resamples, [&] () { return resampledMedian (variant.samples, generator); });
+    }
+
+    // baseline / variant: above 1 the variant is faster.
+    Interval speedupInterval (const Variant& baseline, const Variant& variant) {
+        return bootstrap (options.resamples, [&] () {
+            const double mine = resampledMedian (variant.samples, generator);
+            return mine > 0.0 ? resampledMedian (baseline.samples, generator) / mine : 0.0;
+        });
+    }
+
+    public:
+    explicit Runner (const RunnerOptions& runner_options)
+    : options (runner_options), generator (BENCH_RUNNER_SEED) {
+    }
+
+    // The first variant added is the baseline the others are compared to.
+    void add (const std::string& name, std::size_t operations, std::function<void ()> body) {
+        variants.push_back ({ name, operations, std::move (body), {}, false });
+    }
+
+    void run (const char* title) {
+        if (variants.empty ()) {
+            return;
+        }
+        const std::size_t warmup = warmUp ();
+
+        long switches   = involuntarySwitches ();
+        int migrations  = 0;
+        int last_cpu    = sched_getcpu ();
+        std::vector<std::size_t> order (variants.size ());
+        for (std::size_t i = 0; i < order.size (); ++i) {
+            order[i] = i;
+        }
+        for (Variant& variant : variants) {
+            variant.samples.clear ();
+        }
+        for (std::size_t round = 0; round < options.rounds; ++round) {
+            std::shuffle (order.begin (), order.end (), generator);
+            for (std::size_t index : order) {
+                variants[index].samples.push_back (timeOnce (variants[index]));
+                const int cpu = sched_getcpu ();
+                migrations += cpu != last_cpu;
+                last_cpu = cpu;
+            }
+        }
+        switches = involuntarySwitches () - switches;
+
+        std::printf ("\n## %s ##\n", title);
+        std::printf ("%-30s %10s %24s %6s %9s %18s  %s\n", "variant", "median", "95% CI ns/op", "cv",
+        "speedup", "95% CI", "verdict");
+        std::vector<std::string> noisy;
+        for (std::size_t i = 0; i < variants.size (); ++i) {
+            const Variant& variant = variants[i];
+            const double center    = median (variant.samples);
+            const Interval range   = medianInterval (variant);
+            const double variation = robustVariation (variant.samples);
+            std::printf ("%-30s %10.3f [%10.3f, %10.3f] %5.1f%% ", variant.name.c_str (), center, range.low,
+            range.high, 100.0 * variation);
+            if (i == 0) {
+                std::printf ("%9s %18s  %s", "1.000x", "", "baseline");
+            } else {
+                const double speedup  = center > 0.0 ? median (variants[0].samples) / center : 0.0;
+                const Interval spread = speedupInterval (variants[0], variant);
+                const char* verdict   = spread.low > 1.0 ? "faster" : spread.high < 1.0 ? "slower" : "within noise";
+                std::printf ("%8.3fx [%7.3f, %7.3f]  %s", speedup, spread.low, spread.high, verdict);
+            }
+            std::printf ("\n");
+            if (variation > BENCH_RUNNER_NOISY_CV || !variant.settled) {
+                noisy.push_back (variant.name + (variant.settled ? "" : " (warmup did not settle)"));
+            }
+        }
+
+        std::printf ("%zu interleaved rounds after ", options.rounds);
+        if (warmup) {
+            std::printf ("%zu warmup rounds", warmup);
+        } else {
+            std::printf ("%ld ms of warmup that did not settle", options.warmup_ms);
+        }
+        std::printf (", %ld involuntary context switches, %d CPU migrations\n", switches, migrations);
+        if (!noisy.empty () || migrations > 0) {
+            std::printf ("NOISY:");
+            for (const std::string& name : noisy) {
+                std::printf (" %s;", name.c_str ());
+            }
+            if (migrations > 0) {
+                std::printf (" the process moved between CPUs;");
+            }
+            std::printf (" more --rounds, an idle or isolated CPU would help\n");
+        }
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// Parses the options, pins the process and says where it runs and what
+// on the machine could make the numbers noisy.
+inline RunnerOptions prepareRunner (int argc, char** argv) {
+    const RunnerOptions options = RunnerOptions::fromArgs (argc, argv);
+    const Pinning pinning       = pinToQuietCpu (options.cpu);
+    if (pinning.cpu >= 0) {
+        std::printf ("Runner: pinned to CPU %d%s", pinning.cpu, pinning.isolated ? " (isolated)" : "");
+    } else {
+        std::printf ("Runner: not pinned");
+    }
+    std::printf (", %zu rounds", options.rounds);
+    if (pinning.cpu >= 0 && !pinning.isolated) {
+        std::printf (", no isolated CPU (isolcpus=)");
+    }
+    if (pinning.cpu >= 0) {
+        const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string (pinning.cpu) + "/cpufreq/scaling_governor";
+        const std::string governor = readLine (path.c_str ());
+        if (!governor.empty () && governor != "performance") {
+            std::printf (", governor %s (performance is steadier)", governor.c_str ());
+        }
+    }
+    double load = 0.0;
+    if (getloadavg (&load, 1) == 1 && load > 0.5 * static_cast<double> (sysconf (_SC_NPROCESSORS_ONLN))) {
+        std::printf (", load %.2f", load);
+    }
+    std::printf ("\n");
+    return options;
+}
+
+} // namespace bench
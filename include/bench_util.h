@@ -0,0 +1,302 @@
+/*====# BENCHMARK UTILITIES #====*/
+/*
+
+Small helpers shared by the chapter benchmarks.
+
+* A wall clock timer reporting nanoseconds per operation.
+* perf_event_open counters (cycles, instructions, branch, L1D, LLC and dTLB
+  misses), so we can see WHY one dispatch strategy beats another, not only
+  THAT it does.
+* doNotOptimize(), which stops the compiler from throwing away the results.
+
+If the kernel or the machine does not give us hardware counters
+(containers, VMs, perf_event_paranoid), the counters simply report n/a.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bench {
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+template <typename T> inline void doNotOptimize (T const& value) {
+    asm volatile ("" : : "r,m"(value) : "memory");
+}
+
+inline void clobberMemory () {
+    asm volatile ("" : : : "memory");
+}
+
+// Reads the element count from argv[1], falling back to the given default.
+inline std::size_t countFromArgs (int argc, char** argv, std::size_t fallback) {
+    if (argc > 1) {
+        unsigned long long parsed = std::strtoull (argv[1], nullptr, 10);
+        if (parsed > 0) {
+            return static_cast<std::size_t> (parsed);
+        }
+    }
+    return fallback;
+}
+
+/*==# CLASSES #==*/
+
+// 1. HARDWARE COUNTERS //
+/*
+
+Two counter groups, each opened with its first counter as the leader, so the
+kernel schedules a group as a whole and the ratios inside it (IPC) are taken
+over the same window:
+
+* core   - cycles, instructions, branch misses
+* memory - L1D read misses, LLC read misses, dTLB read misses
+
+Split in two because six events rarely fit the PMU at once. When the kernel
+has to multiplex the groups, the values are scaled by enabled / running time.
+A group (or a single counter) the machine does not have is reported invalid,
+the rest still works.
+
+*/
+
+enum Counter {
+    COUNTER_CYCLES = 0,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTER_COUNT
+};
+
+#define BENCH_CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+struct CounterConfig {
+    const char* name;
+    std::uint32_t type;
+    std::uint64_t config;
+    Counter leader;
+};
+
+inline constexpr CounterConfig counter_configs[COUNTER_COUNT] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, COUNTER_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, COUNTER_CYCLES },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, COUNTER_CYCLES },
+    { "L1D-misses", PERF_TYPE_HW_CACHE, BENCH_CACHE_READ_MISS (PERF_COUNT_HW_CACHE_L1D), COUNTER_L1D_MISSES },
+    { "LLC-misses", PERF_TYPE_HW_CACHE, BENCH_CACHE_READ_MISS (PERF_COUNT_HW_CACHE_LL), COUNTER_L1D_MISSES },
+    { "dTLB-misses", PERF_TYPE_HW_CACHE, BENCH_CACHE_READ_MISS (PERF_COUNT_HW_CACHE_DTLB), COUNTER_L1D_MISSES },
+};
+
+struct CounterSample {
+    bool valid[COUNTER_COUNT]          = {};
+    std::uint64_t value[COUNTER_COUNT] = {};
+
+    bool any () const {
+        for (bool counter_valid : valid) {
+            if (counter_valid) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    double ipc () const {
+        if (!valid[COUNTER_CYCLES] || !valid[COUNTER_INSTRUCTIONS] ||
+        value[COUNTER_CYCLES] == 0) {
+            return 0.0;
+        }
+        return static_cast<double> (value[COUNTER_INSTRUCTIONS]) /
+        static_cast<double> (value[COUNTER_CYCLES]);
+    }
+
+    CounterSample& operator+= (const CounterSample& other) {
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            valid[i] = valid[i] || other.valid[i];
+            value[i] += other.value[i];
+        }
+        return *this;
+    }
+};
+
+class PerfCounters {
+
+    private:
+    int fds[COUNTER_COUNT];
+
+    static int openCounter (const CounterConfig& counter, int group_fd) {
+        perf_event_attr attr;
+        __builtin_memset (&attr, 0, sizeof (attr));
+        attr.size           = sizeof (attr);
+        attr.type           = counter.type;
+        attr.config         = counter.config;
+        attr.disabled       = group_fd == -1 ? 1u : 0u;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int> (
+        syscall (SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+    }
+
+    bool isLeader (int counter) const {
+        return counter_configs[counter].leader == counter && fds[counter] != -1;
+    }
+
+    // Reads the group of leader into sample, scaled when it was multiplexed.
+    void readGroup (int leader, CounterSample& sample) const {
+        // Layout: nr, time_enabled, time_running, { value, id }[nr]
+        std::uint64_t buffer[3 + 2 * COUNTER_COUNT] = {};
+        if (read (fds[leader], buffer, sizeof (buffer)) <= 0 || buffer[2] == 0) {
+            return; // never got on the PMU
+        }
+        const double scale = static_cast<double> (buffer[1]) / static_cast<double> (buffer[2]);
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            std::uint64_t id = 0;
+            if (fds[i] == -1 || counter_configs[i].leader != leader || ioctl (fds[i], PERF_EVENT_IOC_ID, &id) != 0) {
+                continue;
+            }
+            for (std::uint64_t n = 0; n < buffer[0] && n < COUNTER_COUNT; ++n) {
+                if (buffer[4 + 2 * n] == id) {
+                    sample.valid[i] = true;
+                    sample.value[i] = static_cast<std::uint64_t> (
+                    static_cast<double> (buffer[3 + 2 * n]) * scale);
+                }
+            }
+        }
+    }
+
+    public:
+    PerfCounters () {
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            const int leader = counter_configs[i].leader;
+            if (leader == i) {
+                fds[i] = openCounter (counter_configs[i], -1);
+            } else {
+                fds[i] = fds[leader] == -1 ? -1 : openCounter (counter_configs[i], fds[leader]);
+            }
+        }
+    }
+
+    ~PerfCounters () {
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            if (fds[i] != -1) {
+                close (fds[i]);
+            }
+        }
+    }
+
+    PerfCounters (const PerfCounters&)            = delete;
+    PerfCounters& operator= (const PerfCounters&) = delete;
+
+    // At least one group could be opened.
+    bool available () const {
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            if (isLeader (i)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start () {
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            if (isLeader (i)) {
+                ioctl (fds[i], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl (fds[i], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+    }
+
+    CounterSample stop () {
+        CounterSample sample;
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            if (isLeader (i)) {
+                ioctl (fds[i], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            if (isLeader (i)) {
+                readGroup (i, sample);
+            }
+        }
+        return sample;
+    }
+};
+
+// 2. MEASUREMENT //
+/*
+
+measure() runs the body once, timing it and counting hardware events.
+The body is expected to perform `operations` operations, the results are
+normalised per operation.
+
+*/
+
+struct Result {
+    std::string name;
+    std::size_t operations = 0;
+    double nanoseconds     = 0.0;
+    CounterSample counters;
+
+    double nsPerOp () const {
+        return operations ? nanoseconds / static_cast<double> (operations) : 0.0;
+    }
+
+    double perOp (Counter counter) const {
+        return operations ? static_cast<double> (counters.value[counter]) /
+        static_cast<double> (operations) :
+                            0.0;
+    }
+};
+
+template <typename Body>
+Result measure (const std::string& name, std::size_t operations, Body&& body) {
+    PerfCounters counters;
+    Result result;
+    result.name       = name;
+    result.operations = operations;
+
+    auto begin = std::chrono::steady_clock::now ();
+    counters.start ();
+    body ();
+    result.counters = counters.stop ();
+    auto end        = std::chrono::steady_clock::now ();
+
+    result.nanoseconds = static_cast<double> (
+    std::chrono::duration_cast<std::chrono::nanoseconds> (end - begin).count ());
+    return result;
+}
+
+inline void printHeader (const char* title) {
+    std::printf ("\n## %s ##\n", title);
+    std::printf ("%-34s %10s %14s %8s\n", "strategy", "ns/op", "br-miss/op", "IPC");
+}
+
+inline void printResult (const Result& result) {
+    std::printf ("%-34s %10.3f ", result.name.c_str (), result.nsPerOp ());
+    if (result.counters.valid[COUNTER_BRANCH_MISSES]) {
+        std::printf ("%14.4f ", result.perOp (COUNTER_BRANCH_MISSES));
+    } else {
+        std::printf ("%14s ", "n/a");
+    }
+    if (result.counters.valid[COUNTER_CYCLES] && result.counters.valid[COUNTER_INSTRUCTIONS]) {
+        std::printf ("%8.2f\n", result.counters.ipc ());
+    } else {
+        std::printf ("%8s\n", "n/a");
+    }
+}
+
+} // namespace bench
@@ -0,0 +1,247 @@
+/*====# OBJECT LAYOUT REPORT #====*/
+/*
+
+What does a class look like in memory? sizeof only tells half of the story.
+A LayoutReport lists, for one class:
+
+* sizeof and alignof
+* every member with its offset and size (inherited ones too, so the
+  shadowed a and b of ClassToBeSliced show up twice)
+* base class subobjects and where they start
+* the bytes no member covers: in a class with virtual functions or virtual
+  bases, pointer sized holes are the vptr / virtual base pointers, the rest
+  is padding
+* how the members fall onto 64 byte cache lines when the class sits in an
+  array: how many objects of a period straddle a line and which members do
+
+The description is written by hand next to the class (LAYOUT_MEMBER,
+LAYOUT_BASE), the offsets are measured on a real object, so they work for
+classes that are not standard layout too (where offsetof does not).
+Pair it with static_asserts on sizeof to turn a layout regression into a
+compile error.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*==# DEFINES #==*/
+
+#define LAYOUT_CACHE_LINE 64
+
+// Adds object.Class::member, named Class::member.
+#define LAYOUT_MEMBER(report, object, Class, member) \
+    (report).field (#Class "::" #member, (object), (object).Class::member)
+
+// Adds the Base subobject of object.
+#define LAYOUT_BASE(report, object, Base) \
+    (report).base<Base> (#Base, (object), static_cast<const Base&> (object))
+
+namespace layout {
+
+/*==# CLASSES #==*/
+
+class LayoutReport {
+
+    private:
+    struct Entry {
+        std::string name;
+        std::size_t offset;
+        std::size_t size;
+        bool is_base;
+        bool polymorphic_base;
+    };
+
+    std::string class_name;
+    std::size_t class_size;
+    std::size_t class_align;
+    bool has_vtable;
+    std::vector<Entry> entries;
+
+    static std::size_t offsetOf (const void* object, const void* part) {
+        return static_cast<std::size_t> (
+        static_cast<const char*> (part) - static_cast<const char*> (object));
+    }
+
+    // Which bytes of one object are covered by a member.
+    std::vector<bool> coverage () const {
+        std::vector<bool> covered (class_size, false);
+        for (const Entry& entry : entries) {
+            if (entry.is_base) {
+                continue;
+            }
+            for (std::size_t i = entry.offset; i < entry.offset + entry.size && i < class_size; ++i) {
+                covered[i] = true;
+            }
+        }
+        return covered;
+    }
+
+    std::string describeHole (std::size_t offset, std::size_t size) const {
+        if (!has_vtable || offset % sizeof (void*) != 0 || size < sizeof (void*)) {
+            return "padding";
+        }
+        for (const Entry& entry : entries) {
+            if (entry.is_base && entry.polymorphic_base && entry.offset == offset) {
+                return "vptr of " + entry.name;
+            }
+        }
+        return offset == 0 ? "vptr" : "vptr / virtual base pointer";
+    }
+
+    public:
+    LayoutReport (const char* name, std::size_t size, std::size_t align, bool vtable)
+    : class_name (name), class_size (size), class_align (align), has_vtable (vtable) {
+    }
+
+    template <typename Object, typename Member>
+    LayoutReport& field (const char* name, const Object& object, const Member& part) {
+        entries.push_back (Entry{ name, offsetOf (&object, &part), sizeof (Member), false, false });
+        return *this;
+    }
+
+    template <typename Base, typename Object>
+    LayoutReport& base (const char* name, const Object& object, const Base& part) {
+        // An empty base takes no room, however big sizeof says it is.
+        std::size_t size = std::is_empty_v<Base> ? 0 : sizeof (Base);
+        // With virtual bases around, every base that starts a subobject has a pointer too.
+        bool dynamic = std::is_polymorphic_v<Base> || (has_vtable && !std::is_empty_v<Base>);
+        entries.push_back (Entry{ name, offsetOf (&object, &part), size, true, dynamic });
+        return *this;
+    }
+
+    /*==# NUMBERS #==*/
+    std::size_t size () const {
+        return class_size;
+    }
+
+    std::size_t memberBytes () const {
+        std::size_t total = 0;
+        for (bool covered : coverage ()) {
+            total += covered;
+        }
+        return total;
+    }
+
+    // Members hidden by a member of the same name further down the hierarchy.
+    std::size_t shadowedBytes () const {
+        std::size_t total = 0;
+        for (const Entry& entry : entries) {
+            std::string name = entry.name.substr (entry.name.rfind (':') + 1);
+            for (const Entry& other : entries) {
+                if (!entry.is_base && !other.is_base && other.offset > entry.offset &&
+                other.name.substr (other.name.rfind (':') + 1) == name) {
+                    total += entry.size;
+                    break;
+                }
+            }
+        }
+        return total;
+    }
+
+    // Objects out of a period of an array that cross a cache line boundary.
+    std::size_t straddlingObjects (std::size_t* period_out = nullptr) const {
+        std::size_t period = 1;
+        while ((period * class_size) % LAYOUT_CACHE_LINE != 0) {
+            ++period;
+        }
+        std::size_t straddling = 0;
+        for (std::size_t i = 0; i < period; ++i) {
+            std::size_t begin = i * class_size;
+            std::size_t end   = begin + class_size - 1;
+            straddling += (begin / LAYOUT_CACHE_LINE) != (end / LAYOUT_CACHE_LINE);
+        }
+        if (period_out) {
+            *period_out = period;
+        }
+        return straddling;
+    }
+
+    /*==# OUTPUT #==*/
+    void print () const {
+        std::printf ("\n## %s ##\n", class_name.c_str ());
+        std::printf ("sizeof = %zu, alignof = %zu, members = %zu B, hidden + padding = %zu B\n",
+        class_size, class_align, memberBytes (), class_size - memberBytes ());
+        if (shadowedBytes ()) {
+            std::printf ("%zu B of the members are shadowed by a member of the same name\n",
+            shadowedBytes ());
+        }
+
+        std::vector<Entry> sorted = entries;
+        for (std::size_t i = 1; i < sorted.size (); ++i) {
+            for (std::size_t j = i; j > 0 && sorted[j].offset < sorted[j - 1].offset; --j) {
+                std::swap (sorted[j], sorted[j - 1]);
+            }
+        }
+        for (const Entry& entry : sorted) {
+            if (entry.is_base) {
+                std::printf ("  %4zu  [base %s, %zu B]\n", entry.offset, entry.name.c_str (), entry.size);
+            }
+        }
+
+        std::vector<bool> covered = coverage ();
+        std::size_t offset = 0;
+        while (offset < class_size) {
+            bool printed_member = false;
+            for (const Entry& entry : sorted) {
+                if (!entry.is_base && entry.offset == offset) {
+                    std::printf ("  %4zu  %-32s %3zu B\n", entry.offset, entry.name.c_str (), entry.size);
+                    offset += entry.size ? entry.size : 1;
+                    printed_member = true;
+                    break;
+                }
+            }
+            if (printed_member) {
+                continue;
+            }
+            std::size_t hole_end = offset;
+            while (hole_end < class_size && !covered[hole_end]) {
+                ++hole_end;
+            }
+            if (hole_end == offset) {
+                ++offset;
+                continue;
+            }
+            if (has_vtable && offset % sizeof (void*) == 0 && hole_end - offset > sizeof (void*)) {
+                hole_end = offset + sizeof (void*); // one hidden pointer at a time
+            }
+            // appended, "<" + string trips a GCC 12 -Wrestrict false positive at -O3
+            std::string hole = "<";
+            hole += describeHole (offset, hole_end - offset);
+            hole += '>';
+            std::printf ("  %4zu  %-32s %3zu B\n", offset, hole.c_str (), hole_end - offset);
+            offset = hole_end;
+        }
+
+        std::size_t period     = 0;
+        std::size_t straddling = straddlingObjects (&period);
+        std::printf ("in an array: %zu of every %zu objects straddle a %d B cache line",
+        straddling, period, LAYOUT_CACHE_LINE);
+        std::size_t split_members = 0;
+        for (std::size_t i = 0; i < period; ++i) {
+            for (const Entry& entry : entries) {
+                if (entry.is_base || entry.size == 0) {
+                    continue;
+                }
+                std::size_t begin = i * class_size + entry.offset;
+                split_members += (begin / LAYOUT_CACHE_LINE) != ((begin + entry.size - 1) / LAYOUT_CACHE_LINE);
+            }
+        }
+        std::printf (", %zu split member%s\n", split_members, split_members == 1 ? "" : "s");
+    }
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// Type traits can not see virtual bases, say so when the class has them.
+template <typename T> LayoutReport reportFor (const char* name, bool virtual_bases = false) {
+    return LayoutReport (name, sizeof (T), alignof (T), std::is_polymorphic_v<T> || virtual_bases);
+}
+
+} // namespace layout
@@ -0,0 +1,480 @@
+/*====# SAMPLING PROFILER #====*/
+/*
+
+Where does the time of a scenario go? perf would tell, when it is installed
+and allowed (containers, perf_event_paranoid). This answers it from inside
+the process, with nothing to set up:
+
+* SIGPROF    - setitimer (ITIMER_PROF) interrupts whichever thread of the
+               process is on a CPU, every 1 / hz seconds of CPU time
+* unwinding  - the handler walks the frame pointer chain from the
+               interrupted rbp, with the same sanity checks as gperftools
+               (every frame above the last, at most 100 kB apart, aligned),
+               so a function without a frame pointer cuts the stack short
+               instead of crashing us
+* aggregated - the stacks go into a fixed, preallocated hash table with
+               lock free inserts: claim an empty slot with a CAS, or bump
+               the count of the same stack. Nothing in the handler
+               allocates or locks.
+* folded     - "main;scenario;TestClass::TestClass(TestClass&&) 42" lines,
+               the input of flamegraph.pl, speedscope, inferno
+
+    profile::Profiler profiler;
+    profiler.run ([&] () { scenario (); });
+    profiler.writeFolded ("scenario.folded");
+
+Names come from dladdr and, for the functions it does not know (static
+ones, lambdas, all of an executable without -rdynamic), from the .symtab of the
+module on disk. Stripped code shows as module+offset.
+
+A stack that ran into code without frame pointers (libstdc++, libc) before
+reaching main hangs under a "[truncated]" root: the samples count, but the
+callers are unknown. Optimized code of our own needs
+-fno-omit-frame-pointer for full stacks (SANDBOX_FRAME_POINTERS), a Debug
+build has frame pointers anyway.
+
+The timer ticks with the kernel, so the real rate is at most CONFIG_HZ
+(often 250 per second) whatever hz asks for. One profiler runs at a time.
+
+The unwinding reads x86-64 registers and the symbols ELF files: on anything
+but x86-64 Linux PROFILER_AVAILABLE stays undefined and the header declares
+nothing, callers compile their profiling out.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define PROFILER_AVAILABLE
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+/*==# DEFINES #==*/
+
+#define PROFILER_DEFAULT_HZ 997 // prime, does not run in lockstep with periodic work
+#define PROFILER_MAX_DEPTH 64
+#define PROFILER_TABLE_SIZE 4096 // distinct stacks, a power of two
+#define PROFILER_MAX_FRAME_BYTES 100000
+#define PROFILER_TRUNCATED 1 // a frame address: the unwinding stopped before the root
+
+namespace profile {
+
+/*==# CLASSES #==*/
+
+// 1. STACK TABLE //
+/*
+
+Open addressing, linear probing. A slot goes EMPTY -> WRITING (the CAS
+winner fills in the frames) -> READY. A handler that meets a slot still
+WRITING probes on rather than wait for it, so the same stack can end up in
+two slots, folded () adds them up again.
+
+*/
+
+class StackTable {
+
+    private:
+    enum State : std::uint32_t { SLOT_EMPTY = 0, SLOT_WRITING, SLOT_READY };
+
+    struct Slot {
+        std::atomic<std::uint32_t> state{ SLOT_EMPTY };
+        std::atomic<std::uint64_t> count{ 0 };
+        std::uint64_t hash = 0;
+        std::uint32_t depth = 0;
+        std::uintptr_t frames[PROFILER_MAX_DEPTH];
+    };
+
+    Slot slots[PROFILER_TABLE_SIZE];
+    std::atomic<std::uint64_t> recorded{ 0 };
+    std::atomic<std::uint64_t> dropped{ 0 };
+
+    static std::uint64_t hashOf (const std::uintptr_t* frames, std::uint32_t depth) {
+        std::uint64_t hash = 0xcbf29ce484222325ull; // FNV-1a over the addresses
+        for (std::uint32_t i = 0; i < depth; ++i) {
+            hash = (hash ^ frames[i]) * 0x100000001b3ull;
+        }
+        return hash ? hash : 1;
+    }
+
+    static bool same (const Slot& slot, std::uint64_t hash, const std::uintptr_t* frames, std::uint32_t depth) {
+        if (slot.hash != hash || slot.depth != depth) {
+            return false;
+        }
+        for (std::uint32_t i = 0; i < depth; ++i) {
+            if (slot.frames[i] != frames[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    public:
+    // Async signal safe: atomics and plain stores only.
+    void record (const std::uintptr_t* frames, std::uint32_t depth) {
+        const std::uint64_t hash = hashOf (frames, depth);
+        for (std::size_t probe = 0; probe < PROFILER_TABLE_SIZE; ++probe) {
+            Slot& slot = slots[(hash + probe) & (PROFILER_TABLE_SIZE - 1)];
+            std::uint32_t state = slot.state.load (std::memory_order_acquire);
+            if (state == SLOT_READY && same (slot, hash, frames, depth)) {
+                slot.count.fetch_add (1, std::memory_order_relaxed);
+                recorded.fetch_add (1, std::memory_order_relaxed);
+                return;
+            }
+            if (state == SLOT_EMPTY && slot.state.compare_exchange_strong (state, SLOT_WRITING, std::memory_order_acquire)) {
+                slot.hash  = hash;
+                slot.depth = depth;
+                for (std::uint32_t i = 0; i < depth; ++i) {
+                    slot.frames[i] = frames[i];
+                }
+                slot.count.store (1, std::memory_order_relaxed);
+                slot.state.store (SLOT_READY, std::memory_order_release);
+                recorded.fetch_add (1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        dropped.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    // function (frames, depth, count) for every stack, frames[0] is the leaf.
+    template <typename Function> void forEach (Function&& function) const {
+        for (const Slot& slot : slots) {
+            if (slot.state.load (std::memory_order_acquire) == SLOT_READY) {
+                function (slot.frames, slot.depth, slot.count.load (std::memory_order_relaxed));
+            }
+        }
+    }
+
+    std::uint64_t samples () const {
+        return recorded.load (std::memory_order_relaxed);
+    }
+
+    std::uint64_t lost () const {
+        return dropped.load (std::memory_order_relaxed);
+    }
+};
+
+// 2. SYMBOLS //
+
+// The function symbols of one ELF file, from its .symtab: the local ones
+// dladdr cannot see. Empty for a stripped or unreadable file.
+class ElfSymbols {
+
+    private:
+    struct Symbol {
+        std::uintptr_t start;
+        std::uintptr_t end;
+        std::string name;
+    };
+
+    std::vector<Symbol> symbols;
+    bool position_dependent = false; // ET_EXEC: the symbols hold absolute addresses
+
+    template <typename T> static bool readAt (std::ifstream& file, std::uint64_t offset, T* into, std::size_t count = 1) {
+        file.seekg (static_cast<std::streamoff> (offset));
+        file.read (reinterpret_cast<char*> (into), static_cast<std::streamsize> (count * sizeof (T)));
+        return static_cast<bool> (file);
+    }
+
+    public:
+    explicit ElfSymbols (const std::string& path) {
+        std::ifstream file (path, std::ios::binary);
+        Elf64_Ehdr header;
+        if (!readAt (file, 0, &header) || std::memcmp (header.e_ident, ELFMAG, SELFMAG) != 0 ||
+        header.e_ident[EI_CLASS] != ELFCLASS64 || header.e_shentsize != sizeof (Elf64_Shdr)) {
+            return;
+        }
+        position_dependent = header.e_type == ET_EXEC;
+        std::vector<Elf64_Shdr> sections (header.e_shnum);
+        if (sections.empty () || !readAt (file, header.e_shoff, sections.data (), sections.size ())) {
+            return;
+        }
+        for (const Elf64_Shdr& section : sections) {
+            if (section.sh_type != SHT_SYMTAB || section.sh_link >= sections.size ()) {
+                continue;
+            }
+            const Elf64_Shdr& strings = sections[section.sh_link];
+            std::vector<Elf64_Sym> entries (section.sh_size / sizeof (Elf64_Sym));
+            std::string names (strings.sh_size, '\0');
+            if (!readAt (file, section.sh_offset, entries.data (), entries.size ()) ||
+            !readAt (file, strings.sh_offset, names.data (), names.size ())) {
+                return;
+            }
+            for (const Elf64_Sym& entry : entries) {
+                if (ELF64_ST_TYPE (entry.st_info) == STT_FUNC && entry.st_value && entry.st_size && entry.st_name < names.size ()) {
+                    symbols.push_back ({ entry.st_value, entry.st_value + entry.st_size, names.c_str () + entry.st_name });
+                }
+            }
+        }
+        std::sort (symbols.begin (), symbols.end (), [] (const Symbol& a, const Symbol& b) { return a.start < b.start; });
+    }
+
+    // The mangled name of the function address lies in, module loaded at base.
+    const std::string* find (std::uintptr_t address, std::uintptr_t base) const {
+        const std::uintptr_t key = position_dependent ? address : address - base;
+        auto after = std::upper_bound (symbols.begin (), symbols.end (), key,
+        [] (std::uintptr_t value, const Symbol& symbol) { return value < symbol.start; });
+        if (after == symbols.begin () || key >= std::prev (after)->end) {
+            return nullptr;
+        }
+        return &std::prev (after)->name;
+    }
+};
+
+// 3. PROFILER //
+
+class Profiler {
+
+    private:
+    static inline std::atomic<StackTable*> active{ nullptr }; // what the handler records into
+    static inline std::atomic<int> handlers_running{ 0 };
+
+    std::unique_ptr<StackTable> table;
+    int hz;
+    struct sigaction previous;
+
+    // The interrupted pc, then the return addresses up the frame pointer chain.
+    static std::uint32_t unwind (const ucontext_t* context, std::uintptr_t* frames) {
+        const greg_t* registers = context->uc_mcontext.gregs;
+        const std::uintptr_t sp = static_cast<std::uintptr_t> (registers[REG_RSP]);
+        std::uintptr_t fp       = static_cast<std::uintptr_t> (registers[REG_RBP]);
+        std::uint32_t depth     = 0;
+        frames[depth++]         = static_cast<std::uintptr_t> (registers[REG_RIP]);
+        if (fp < sp || fp - sp > PROFILER_MAX_FRAME_BYTES) {
+            frames[depth++] = PROFILER_TRUNCATED; // rbp is not a frame pointer here
+            return depth;
+        }
+        while (depth < PROFILER_MAX_DEPTH - 1 && fp % sizeof (std::uintptr_t) == 0) {
+            const std::uintptr_t* frame = reinterpret_cast<const std::uintptr_t*> (fp);
+            const std::uintptr_t next   = frame[0];
+            const std::uintptr_t ret    = frame[1];
+            if (ret == 0) {
+                break;
+            }
+            frames[depth++] = ret;
+            if (next == 0) {
+                return depth; // the outermost frame
+            }
+            if (next <= fp || next - fp > PROFILER_MAX_FRAME_BYTES) {
+                break;
+            }
+            fp = next;
+        }
+        frames[depth++] = PROFILER_TRUNCATED;
+        return depth;
+    }
+
+    // Announce, then look: with stop () storing active, then reading
+    // handlers_running, this is Dekker's pattern. Only seq_cst on both sides
+    // keeps each store from passing the load after it, so that either the
+    // handler sees nullptr or stop () sees the handler.
+    static void onSignal (int, siginfo_t*, void* context) {
+        const int saved_errno = errno;
+        handlers_running.fetch_add (1, std::memory_order_seq_cst);
+        if (StackTable* target = active.load (std::memory_order_seq_cst)) {
+            std::uintptr_t frames[PROFILER_MAX_DEPTH];
+            const std::uint32_t depth = unwind (static_cast<const ucontext_t*> (context), frames);
+            target->record (frames, depth);
+        }
+        handlers_running.fetch_sub (1, std::memory_order_release);
+        errno = saved_errno;
+    }
+
+    static void fail (const char* what) {
+        throw std::system_error (errno, std::generic_category (), what);
+    }
+
+    // "function" for a symbol, "module+0xoffset" without one. A return
+    // address is the instruction after the call, address - 1 is in it.
+    static std::string symbolize (std::uintptr_t address, bool return_address,
+    std::map<std::string, ElfSymbols>& modules) {
+        if (address == PROFILER_TRUNCATED) {
+            return "[truncated]";
+        }
+        const std::uintptr_t lookup = return_address ? address - 1 : address;
+        Dl_info info;
+        if (!dladdr (reinterpret_cast<void*> (lookup), &info)) {
+            char text[32];
+            std::snprintf (text, sizeof (text), "0x%lx", static_cast<unsigned long> (address));
+            return text;
+        }
+        const std::string module   = info.dli_fname ? info.dli_fname : "??";
+        const std::uintptr_t base  = reinterpret_cast<std::uintptr_t> (info.dli_fbase);
+        const std::string* mangled = nullptr;
+        std::string exported;
+        if (info.dli_sname) {
+            exported = info.dli_sname;
+            mangled  = &exported;
+        } else {
+            mangled = modules.try_emplace (module, module).first->second.find (lookup, base);
+        }
+        std::string name;
+        if (mangled) {
+            int status      = 0;
+            char* demangled = abi::__cxa_demangle (mangled->c_str (), nullptr, nullptr, &status);
+            name            = status == 0 && demangled ? demangled : *mangled;
+            std::free (demangled);
+        } else {
+            char offset[32];
+            std::snprintf (offset, sizeof (offset), "+0x%lx", static_cast<unsigned long> (lookup - base));
+            name = module.substr (module.find_last_of ('/') + 1) + offset;
+        }
+        std::replace (name.begin (), name.end (), ';', ':'); // the folded separator
+        return name;
+    }
+
+    public:
+    explicit Profiler (int samples_per_second = PROFILER_DEFAULT_HZ)
+    : table (std::make_unique<StackTable> ()), hz (samples_per_second > 0 ? samples_per_second : PROFILER_DEFAULT_HZ),
+      previous () {
+    }
+
+    Profiler (const Profiler&)            = delete;
+    Profiler& operator= (const Profiler&) = delete;
+
+    ~Profiler () {
+        if (active.load () == table.get ()) {
+            stop ();
+        }
+    }
+
+    void start () {
+        StackTable* expected = nullptr;
+        if (!active.compare_exchange_strong (expected, table.get ())) {
+            throw std::runtime_error ("Profiler: another profiler is running");
+        }
+        struct sigaction action;
+        sigemptyset (&action.sa_mask);
+        action.sa_sigaction = onSignal;
+        action.sa_flags     = SA_SIGINFO | SA_RESTART;
+        if (sigaction (SIGPROF, &action, &previous) != 0) {
+            active.store (nullptr);
+            fail ("sigaction");
+        }
+        // tv_usec must stay below a second, and a zero period would disarm the timer.
+        const long period         = std::max (1L, 1000000L / hz);
+        itimerval timer;
+        timer.it_interval.tv_sec  = period / 1000000;
+        timer.it_interval.tv_usec = period % 1000000;
+        timer.it_value            = timer.it_interval;
+        if (setitimer (ITIMER_PROF, &timer, nullptr) != 0) {
+            sigaction (SIGPROF, &previous, nullptr);
+            active.store (nullptr);
+            fail ("setitimer");
+        }
+    }
+
+    // Returns once no handler uses the table any more.
+    void stop () {
+        itimerval timer{};
+        setitimer (ITIMER_PROF, &timer, nullptr);
+        active.store (nullptr, std::memory_order_seq_cst);
+        while (handlers_running.load (std::memory_order_seq_cst) != 0) {
+        }
+        sigaction (SIGPROF, &previous, nullptr);
+    }
+
+    template <typename Function> void run (Function&& function) {
+        start ();
+        try {
+            function ();
+        } catch (...) {
+            stop ();
+            throw;
+        }
+        stop ();
+    }
+
+    std::uint64_t samples () const {
+        return table->samples ();
+    }
+
+    // Samples that found the table full.
+    std::uint64_t dropped () const {
+        return table->lost ();
+    }
+
+    // Folded stacks, root first, with their sample counts.
+    std::map<std::string, std::uint64_t> folded () const {
+        std::map<std::string, ElfSymbols> modules;
+        std::map<std::uintptr_t, std::string> names[2]; // [return address]
+        auto nameOf = [&] (std::uintptr_t address, bool return_address) -> const std::string& {
+            auto [it, inserted] = names[return_address].try_emplace (address);
+            if (inserted) {
+                it->second = symbolize (address, return_address, modules);
+            }
+            return it->second;
+        };
+        std::map<std::string, std::uint64_t> stacks;
+        table->forEach ([&] (const std::uintptr_t* frames, std::uint32_t depth, std::uint64_t count) {
+            // Outermost first, from main on: the frames above it are the C
+            // runtime, whose missing frame pointers would mark the stack truncated
+            std::uint32_t root = depth;
+            for (std::uint32_t i = 0; i < depth; ++i) {
+                if (nameOf (frames[i], i > 0) == "main") {
+                    root = i + 1;
+                    break;
+                }
+            }
+            std::string line;
+            for (std::uint32_t i = root; i-- > 0;) {
+                line += nameOf (frames[i], i > 0);
+                if (i > 0) {
+                    line += ';';
+                }
+            }
+            stacks[line] += count;
+        });
+        return stacks;
+    }
+
+    // The functions the samples were taken in (the leaves), hottest first.
+    std::vector<std::pair<std::string, std::uint64_t>> hottest (std::size_t count) const {
+        std::map<std::string, std::uint64_t> self;
+        for (const auto& [line, samples_in_stack] : folded ()) {
+            const std::size_t last = line.find_last_of (';');
+            self[last == std::string::npos ? line : line.substr (last + 1)] += samples_in_stack;
+        }
+        std::vector<std::pair<std::string, std::uint64_t>> sorted (self.begin (), self.end ());
+        std::sort (sorted.begin (), sorted.end (), [] (const auto& a, const auto& b) { return a.second > b.second; });
+        sorted.resize (std::min (count, sorted.size ()));
+        return sorted;
+    }
+
+    void writeFolded (const std::string& path) const {
+        std::FILE* out = std::fopen (path.c_str (), "w");
+        if (!out) {
+            fail ("fopen");
+        }
+        for (const auto& [line, count] : folded ()) {
+            std::fprintf (out, "%s %llu\n", line.c_str (), static_cast<unsigned long long> (count));
+        }
+        std::fclose (out);
+    }
+};
+
+} // namespace profile
+
+#endif // PROFILER_AVAILABLE
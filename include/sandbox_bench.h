@@ -0,0 +1,83 @@
+/*====# SANDBOX BENCH #====*/
+/*
+
+Google Benchmark with the hardware counters of bench_util.h, for chapter
+benchmarks that want repetitions, argument ranges and statistics instead of
+one printed run. Link the sandbox_bench library (sandbox_bench/).
+
+    static void isFiveStar (benchmark::State& state) {
+        std::vector<PolymorphicClass*> objects = makeObjects (state.range (0));
+        bench::StateCounters counters (state, objects.size ()); // counts from here on
+        for (auto _ : state) {
+            ...
+        }
+    }
+    BENCHMARK (isFiveStar)->Arg (1 << 20);
+
+    SANDBOX_BENCHMARK_MAIN ();
+
+Every counter the machine has (cycles, instructions, IPC, branch-misses,
+L1D-misses, LLC-misses, dTLB-misses) becomes a column of the report, per
+iteration, or per operation when StateCounters is told how many operations
+one iteration does. Without counters (containers, VMs, perf_event_paranoid) the
+columns are left out and the report context says why, the timings are the
+same either way.
+
+*/
+
+#pragma once
+
+/*==# INCLUDES #==*/
+#include <cstddef>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_util.h"
+
+/*==# DEFINES #==*/
+
+#define SANDBOX_BENCHMARK_MAIN()                 \
+    int main (int argc, char** argv) {           \
+        return bench::runBenchmarks (argc, argv); \
+    }                                            \
+    int main (int, char**)
+
+namespace bench {
+
+/*==# CLASSES #==*/
+
+// Counts from construction to destruction (minus pauses) on the calling
+// thread and reports the counters to state, per iteration divided by
+// operations. Build it right before the benchmark loop, the setup before it
+// is not counted.
+class StateCounters {
+
+    private:
+    benchmark::State& state;
+    PerfCounters counters;
+    CounterSample total;
+    std::size_t operations;
+    bool running;
+
+    public:
+    explicit StateCounters (benchmark::State& benchmark_state, std::size_t operations_per_iteration = 1);
+    ~StateCounters ();
+
+    StateCounters (const StateCounters&)            = delete;
+    StateCounters& operator= (const StateCounters&) = delete;
+
+    // Together with state.PauseTiming () / ResumeTiming ().
+    void pause ();
+    void resume ();
+};
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+// Whether this process can open hardware counters, the reason when not.
+bool countersAvailable (std::string* reason = nullptr);
+
+// benchmark::Initialize, the counter context, RunSpecifiedBenchmarks.
+int runBenchmarks (int argc, char** argv);
+
+} // namespace bench
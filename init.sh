@@ -3,6 +3,52 @@
 build_dir="build"
 prefix='#====[ Linux C++ Sandbox ]===# '
 
+# ./init.sh optimize - Release vs PGO + LTO build, see cmake/optimize.cmake
+if [ "$1" == "optimize" ]; then
+    echo $prefix "Optimized build (PGO + LTO)."
+    cmake -P cmake/optimize.cmake || exit 1
+    echo $prefix "Done, see build_optimized/report.md"
+    exit 0
+fi
+
+# ./init.sh bench-baseline - store the --bench --json metrics of a Release build in bench_baseline/
+# ./init.sh bench-check    - run them again, fail on a regression, see cmake/bench_compare.cmake
+#                            (BENCH_THRESHOLD=25 ./init.sh bench-check on a noisy machine, default 10 percent)
+if [ "$1" == "bench-baseline" ] || [ "$1" == "bench-check" ]; then
+    bench_dir="build_bench"
+    bench_chapters="chapter_01_rule_of_five/Chapter_01 chapter_02_templates_name_mangling/Chapter_02 chapter_03_inheritance/Chapter_03"
+    echo $prefix "Release build in $bench_dir."
+    cmake -S . -B $bench_dir -DCMAKE_BUILD_TYPE=Release > /dev/null || exit 1
+    cmake --build $bench_dir -j 16 || exit 1
+    mkdir -p bench_baseline
+    failed=0
+    for chapter in $bench_chapters; do
+        name=$(basename $chapter)
+        # The best of three processes on both sides, one process alone is too noisy
+        if [ "$1" == "bench-baseline" ]; then
+            runs_dir="bench_baseline"
+        else
+            runs_dir="$bench_dir"
+        fi
+        for run in 1 2 3; do
+            ./$bench_dir/$chapter --bench --json > $runs_dir/$name.$run.json || exit 1
+        done
+        if [ "$1" == "bench-baseline" ]; then
+            echo $prefix "Baseline: bench_baseline/$name.{1,2,3}.json"
+        else
+            cmake -DBASELINE="bench_baseline/$name.1.json;bench_baseline/$name.2.json;bench_baseline/$name.3.json" \
+                -DCURRENT="$bench_dir/$name.1.json;$bench_dir/$name.2.json;$bench_dir/$name.3.json" \
+                -DTHRESHOLD=${BENCH_THRESHOLD:-10} -P cmake/bench_compare.cmake || failed=1
+        fi
+    done
+    if [ $failed -ne 0 ]; then
+        echo $prefix "Regressions against bench_baseline/, see above."
+        exit 1
+    fi
+    echo $prefix "Done."
+    exit 0
+fi
+
 echo $prefix "Initializing repository."
 
 rm -rf $build_dir
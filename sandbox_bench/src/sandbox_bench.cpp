@@ -0,0 +1,84 @@
+/*====# SANDBOX BENCH #====*/
+/*
+
+The out of line half of sandbox_bench.h.
+
+*/
+
+/*==# INCLUDES #==*/
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include "sandbox_bench.h"
+
+namespace bench {
+
+/*==# CLASSES #==*/
+
+StateCounters::StateCounters (benchmark::State& benchmark_state, std::size_t operations_per_iteration)
+: state (benchmark_state), operations (operations_per_iteration ? operations_per_iteration : 1), running (false) {
+    resume ();
+}
+
+StateCounters::~StateCounters () {
+    pause ();
+    if (!total.any ()) {
+        return;
+    }
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (total.valid[i]) {
+            state.counters[counter_configs[i].name] =
+            benchmark::Counter (static_cast<double> (total.value[i]) / static_cast<double> (operations),
+            benchmark::Counter::kAvgIterations);
+        }
+    }
+    if (total.valid[COUNTER_CYCLES] && total.valid[COUNTER_INSTRUCTIONS]) {
+        // Every thread reports its own, the average of the threads is the IPC
+        state.counters["IPC"] = benchmark::Counter (total.ipc (), benchmark::Counter::kAvgThreads);
+    }
+}
+
+void StateCounters::pause () {
+    if (running) {
+        total += counters.stop ();
+        running = false;
+    }
+}
+
+void StateCounters::resume () {
+    if (!running && counters.available ()) {
+        counters.start ();
+        running = true;
+    }
+}
+
+/*==# GLOBAL FUNCTIONS #==*/
+
+bool countersAvailable (std::string* reason) {
+    const PerfCounters probe;
+    if (probe.available ()) {
+        return true;
+    }
+    if (reason) {
+        const int error = errno; // of the last perf_event_open
+        *reason = std::string ("n/a, perf_event_open: ") + std::strerror (error) +
+        (error == EACCES || error == EPERM ? " (see /proc/sys/kernel/perf_event_paranoid)" :
+                                             " (no PMU for these events, a VM?)");
+    }
+    return false;
+}
+
+int runBenchmarks (int argc, char** argv) {
+    benchmark::Initialize (&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments (argc, argv)) {
+        return 1;
+    }
+    std::string reason;
+    benchmark::AddCustomContext ("hardware counters", countersAvailable (&reason) ? "per iteration" : reason);
+    benchmark::RunSpecifiedBenchmarks ();
+    benchmark::Shutdown ();
+    return 0;
+}
+
+} // namespace bench